@@ -1,19 +1,42 @@
 use std::{
-    collections::BTreeMap,
-    env, fs,
+    alloc::{GlobalAlloc, Layout, System},
+    collections::{BTreeMap, HashMap, HashSet},
+    env,
+    fmt::Write as _,
+    fs,
+    hint::black_box,
+    io::{self, Write},
+    mem,
+    os::raw::c_void,
     path::{Path, PathBuf},
-    str,
-    time::Instant,
+    process, ptr, str,
+    sync::{
+        atomic::{AtomicUsize, Ordering},
+        Mutex, Once,
+    },
+    time::{Duration, Instant},
     usize,
 };
 
 use anyhow::Context;
 use lazy_static::lazy_static;
-use tree_sitter::{Language, Parser, Query};
+use serde::{Deserialize, Serialize};
+use tree_sitter::{Language, Parser, Query, QueryCursor, Tree};
+use tree_sitter_cli::parse::{perform_edit, Edit};
+use tree_sitter_highlight::{
+    HighlightConfiguration, HighlightEvent, Highlighter, HtmlRenderer, HtmlWriter,
+};
 use tree_sitter_loader::{CompileConfig, Loader};
+use tree_sitter_tags::{TagsConfiguration, TagsContext};
 
 include!("../src/tests/helpers/dirs.rs");
 
+mod random {
+    include!("../src/tests/helpers/random.rs");
+}
+
+use random::Rand;
+
 lazy_static! {
     static ref LANGUAGE_FILTER: Option<String> =
         env::var("TREE_SITTER_BENCHMARK_LANGUAGE_FILTER").ok();
@@ -22,6 +45,23 @@ lazy_static! {
     static ref REPETITION_COUNT: usize = env::var("TREE_SITTER_BENCHMARK_REPETITION_COUNT")
         .map(|s| s.parse::<usize>().unwrap())
         .unwrap_or(5);
+    static ref EDIT_COUNT: usize = env::var("TREE_SITTER_BENCHMARK_EDIT_COUNT")
+        .map(|s| s.parse::<usize>().unwrap())
+        .unwrap_or(100);
+    static ref EDIT_TRACE_DIR: Option<PathBuf> = env::var("TREE_SITTER_BENCHMARK_EDIT_TRACE_DIR")
+        .ok()
+        .map(PathBuf::from);
+    static ref EDIT_TRACE_OUTPUT_DIR: Option<PathBuf> =
+        env::var("TREE_SITTER_BENCHMARK_EDIT_TRACE_OUTPUT_DIR")
+            .ok()
+            .map(PathBuf::from);
+    static ref OUTPUT_PATH: Option<PathBuf> = env::var("TREE_SITTER_BENCHMARK_OUTPUT")
+        .ok()
+        .map(PathBuf::from);
+    static ref BASELINE_PATH: Option<PathBuf> = env::var("TREE_SITTER_BENCHMARK_BASELINE")
+        .ok()
+        .map(PathBuf::from);
+    static ref RESULTS: Mutex<Vec<BenchmarkResult>> = Mutex::new(Vec::new());
     static ref TEST_LOADER: Loader = Loader::with_parser_lib_path(SCRATCH_DIR.clone());
     static ref EXAMPLE_AND_QUERY_PATHS_BY_LANGUAGE_DIR: BTreeMap<PathBuf, (Vec<PathBuf>, Vec<PathBuf>)> = {
         fn process_dir(result: &mut BTreeMap<PathBuf, (Vec<PathBuf>, Vec<PathBuf>)>, dir: &Path) {
@@ -68,6 +108,31 @@ lazy_static! {
 }
 
 fn main() {
+    // `cargo bench` passes a `--bench` flag to the benchmark.
+    let args = env::args()
+        .skip(1)
+        .filter(|arg| !arg.starts_with("--"))
+        .collect::<Vec<_>>();
+    if let [command, baseline_path, path] = args.as_slice() {
+        if command == "compare" {
+            let baseline = read_results(Path::new(baseline_path));
+            let results = read_results(Path::new(path));
+            if compare_results(&baseline, &results) {
+                process::exit(1);
+            }
+            return;
+        }
+    }
+
+    unsafe {
+        tree_sitter::set_allocator(
+            Some(ts_counting_malloc),
+            Some(ts_counting_calloc),
+            Some(ts_counting_realloc),
+            Some(ts_counting_free),
+        );
+    }
+
     let max_path_length = EXAMPLE_AND_QUERY_PATHS_BY_LANGUAGE_DIR
         .values()
         .flat_map(|(e, q)| {
@@ -107,13 +172,36 @@ fn main() {
                 }
             }
 
-            parse(path, max_path_length, |source| {
+            parse(language_name, "query", path, max_path_length, |source| {
                 Query::new(&language, str::from_utf8(source).unwrap())
                     .with_context(|| format!("Query file path: {path:?}"))
                     .expect("Failed to parse query");
             });
         }
 
+        eprintln!("  Executing Queries (matches, captures):");
+        let examples = example_paths
+            .iter()
+            .filter(|path| {
+                EXAMPLE_FILTER.as_ref().map_or(true, |filter| {
+                    path.to_str().unwrap().contains(filter.as_str())
+                })
+            })
+            .map(|path| {
+                let source_code = fs::read(path)
+                    .with_context(|| format!("Failed to read {path:?}"))
+                    .unwrap();
+                let tree = parser.parse(&source_code, None).expect("Failed to parse");
+                (source_code, tree)
+            })
+            .collect::<Vec<_>>();
+        if !examples.is_empty() {
+            for path in query_paths {
+                execute_query(&language, language_name, path, &examples, max_path_length);
+            }
+        }
+        drop(examples);
+
         eprintln!("  Parsing Valid Code:");
         let mut normal_speeds = Vec::new();
         for example_path in example_paths {
@@ -123,9 +211,15 @@ fn main() {
                 }
             }
 
-            normal_speeds.push(parse(example_path, max_path_length, |code| {
-                parser.parse(code, None).expect("Failed to parse");
-            }));
+            normal_speeds.push(parse(
+                language_name,
+                "parse",
+                example_path,
+                max_path_length,
+                |code| {
+                    parser.parse(code, None).expect("Failed to parse");
+                },
+            ));
         }
 
         eprintln!("  Parsing Invalid Code (mismatched languages):");
@@ -141,10 +235,75 @@ fn main() {
                         }
                     }
 
-                    error_speeds.push(parse(example_path, max_path_length, |code| {
-                        parser.parse(code, None).expect("Failed to parse");
-                    }));
+                    error_speeds.push(parse(
+                        language_name,
+                        "parse (errors)",
+                        example_path,
+                        max_path_length,
+                        |code| {
+                            parser.parse(code, None).expect("Failed to parse");
+                        },
+                    ));
+                }
+            }
+        }
+
+        eprintln!("  Replaying Edits (reparse, changed ranges):");
+        let mut all_reparse_times = Vec::new();
+        let mut all_changed_ranges_times = Vec::new();
+        for example_path in example_paths {
+            if let Some(filter) = EXAMPLE_FILTER.as_ref() {
+                if !example_path.to_str().unwrap().contains(filter.as_str()) {
+                    continue;
+                }
+            }
+
+            let (reparse_times, changed_ranges_times) =
+                replay_edits(&mut parser, language_name, example_path, max_path_length);
+            all_reparse_times.extend(reparse_times);
+            all_changed_ranges_times.extend(changed_ranges_times);
+        }
+
+        if language_name == "json" && EXAMPLE_FILTER.is_none() {
+            eprintln!("  Indexed Child Access ({LARGE_ARRAY_LENGTH}-element array):");
+            child_access(&mut parser, language_name);
+        }
+
+        let highlight_config = get_highlight_config(&language, language_name, query_paths);
+        if let Some(config) = &highlight_config {
+            eprintln!("  Highlighting:");
+            for example_path in example_paths {
+                if let Some(filter) = EXAMPLE_FILTER.as_ref() {
+                    if !example_path.to_str().unwrap().contains(filter.as_str()) {
+                        continue;
+                    }
+                }
+
+                highlight(config, language_name, example_path, max_path_length);
+            }
+
+            eprintln!("  Rendering Highlighted HTML (HtmlRenderer, HtmlWriter):");
+            for example_path in example_paths {
+                if let Some(filter) = EXAMPLE_FILTER.as_ref() {
+                    if !example_path.to_str().unwrap().contains(filter.as_str()) {
+                        continue;
+                    }
                 }
+
+                render_html(config, language_name, example_path, max_path_length);
+            }
+
+            if language_name == "javascript" && EXAMPLE_FILTER.is_none() {
+                eprintln!(
+                    "  Resolving Locals ({LARGE_FUNCTION_LOCAL_COUNT} locals in one function):"
+                );
+                large_function_locals(
+                    &language,
+                    language_name,
+                    config,
+                    query_paths,
+                    max_path_length,
+                );
             }
         }
 
@@ -158,6 +317,14 @@ fn main() {
             eprintln!("  Worst Speed (errors):   {worst_error} bytes/ms");
         }
 
+        if let Some((p50, p99)) = percentiles(&mut all_reparse_times) {
+            eprintln!("  Reparse Latency:        p50 {p50:>8.1} µs\tp99 {p99:>8.1} µs");
+        }
+
+        if let Some((p50, p99)) = percentiles(&mut all_changed_ranges_times) {
+            eprintln!("  Changed Ranges Latency: p50 {p50:>8.1} µs\tp99 {p99:>8.1} µs");
+        }
+
         all_normal_speeds.extend(normal_speeds);
         all_error_speeds.extend(error_speeds);
     }
@@ -173,6 +340,22 @@ fn main() {
         eprintln!("  Worst Speed (errors):   {worst_error} bytes/ms");
     }
     eprintln!();
+
+    let results = BenchmarkResults {
+        version: env!("CARGO_PKG_VERSION").to_string(),
+        repetition_count: *REPETITION_COUNT,
+        results: mem::take(&mut *RESULTS.lock().unwrap()),
+    };
+    if let Some(path) = OUTPUT_PATH.as_ref() {
+        fs::write(path, serde_json::to_string_pretty(&results).unwrap())
+            .with_context(|| format!("Failed to write {path:?}"))
+            .unwrap();
+    }
+    if let Some(path) = BASELINE_PATH.as_ref() {
+        if compare_results(&read_results(path), &results) {
+            process::exit(1);
+        }
+    }
 }
 
 fn aggregate(speeds: &[usize]) -> Option<(usize, usize)> {
@@ -190,7 +373,272 @@ fn aggregate(speeds: &[usize]) -> Option<(usize, usize)> {
     Some((total / speeds.len(), max))
 }
 
-fn parse(path: &Path, max_path_length: usize, mut action: impl FnMut(&[u8])) -> usize {
+/// Identifies one set of samples in the benchmark results.
+#[derive(Clone, Copy)]
+struct ResultKey<'a> {
+    language: &'a str,
+    benchmark: &'a str,
+    example: &'a str,
+}
+
+#[derive(Serialize, Deserialize)]
+struct BenchmarkResults {
+    version: String,
+    repetition_count: usize,
+    results: Vec<BenchmarkResult>,
+}
+
+/// The timings of one benchmark, in nanoseconds. The confidence interval is a
+/// distribution-free 95% interval for the median.
+#[derive(Serialize, Deserialize)]
+struct BenchmarkResult {
+    language: String,
+    benchmark: String,
+    example: String,
+    samples: Vec<u64>,
+    median: f64,
+    median_absolute_deviation: f64,
+    confidence_interval: (f64, f64),
+}
+
+impl BenchmarkResult {
+    fn new(key: ResultKey, samples: &[Duration]) -> Self {
+        let samples = samples
+            .iter()
+            .map(|sample| sample.as_nanos() as u64)
+            .collect::<Vec<_>>();
+        let mut sorted_samples = samples.iter().map(|s| *s as f64).collect::<Vec<_>>();
+        sorted_samples.sort_unstable_by(f64::total_cmp);
+        let median = median_of_sorted(&sorted_samples);
+        let mut deviations = sorted_samples
+            .iter()
+            .map(|sample| (sample - median).abs())
+            .collect::<Vec<_>>();
+        deviations.sort_unstable_by(f64::total_cmp);
+
+        let (lower_rank, upper_rank) = confidence_interval_ranks(samples.len());
+        if has_too_few_samples(samples.len()) {
+            static FEW_SAMPLES_WARNING: Once = Once::new();
+            FEW_SAMPLES_WARNING.call_once(|| {
+                eprintln!(
+                    "Warning: some benchmarks have only {} samples. With fewer than {} samples, \
+                     the confidence interval of the median spans all of the samples, so \
+                     comparisons only detect changes larger than the samples' whole range. \
+                     Increase the repetition count to get a meaningful interval.",
+                    samples.len(),
+                    minimum_sample_count(),
+                );
+            });
+        }
+
+        Self {
+            language: key.language.to_string(),
+            benchmark: key.benchmark.to_string(),
+            example: key.example.to_string(),
+            median,
+            median_absolute_deviation: median_of_sorted(&deviations),
+            confidence_interval: (sorted_samples[lower_rank], sorted_samples[upper_rank]),
+            samples,
+        }
+    }
+}
+
+// The ranks of the bounds of the confidence interval of the median of the given number of
+// sorted samples. They follow from the normal approximation of the binomial distribution
+// of the number of samples below the median.
+fn confidence_interval_ranks(count: usize) -> (usize, usize) {
+    let half_width = 1.96 * (count as f64).sqrt() / 2.0;
+    let lower_rank = (count as f64 / 2.0 - half_width).floor().max(0.0) as usize;
+    let upper_rank =
+        ((count as f64 / 2.0 + half_width).ceil() as usize).min(count.saturating_sub(1));
+    (lower_rank, upper_rank)
+}
+
+// Whether the confidence interval of the median of the given number of samples includes
+// the smallest or the largest sample, so that it says nothing about the median.
+fn has_too_few_samples(count: usize) -> bool {
+    let (lower_rank, upper_rank) = confidence_interval_ranks(count);
+    lower_rank == 0 || upper_rank + 1 >= count
+}
+
+fn minimum_sample_count() -> usize {
+    (1..).find(|count| !has_too_few_samples(*count)).unwrap()
+}
+
+fn median_of_sorted(sorted_values: &[f64]) -> f64 {
+    let middle = sorted_values.len() / 2;
+    if sorted_values.len() % 2 == 0 {
+        (sorted_values[middle - 1] + sorted_values[middle]) / 2.0
+    } else {
+        sorted_values[middle]
+    }
+}
+
+fn record_samples(key: ResultKey, samples: &[Duration]) {
+    if !samples.is_empty() {
+        RESULTS
+            .lock()
+            .unwrap()
+            .push(BenchmarkResult::new(key, samples));
+    }
+}
+
+fn read_results(path: &Path) -> BenchmarkResults {
+    let json = fs::read_to_string(path)
+        .with_context(|| format!("Failed to read {path:?}"))
+        .unwrap();
+    serde_json::from_str(&json)
+        .with_context(|| format!("Invalid benchmark results in {path:?}"))
+        .unwrap()
+}
+
+// Changes smaller than this fraction of the baseline's median are not reported, even
+// when they are statistically significant.
+const MINIMUM_REPORTED_CHANGE: f64 = 0.02;
+
+// Report the benchmarks whose median changed significantly, meaning that the confidence
+// intervals of the two medians don't overlap, along with the benchmarks that only appear
+// in one of the two sets of results. Returns whether any of them regressed.
+fn compare_results(baseline: &BenchmarkResults, results: &BenchmarkResults) -> bool {
+    let baseline_results = baseline
+        .results
+        .iter()
+        .map(|result| {
+            let key = (&result.language, &result.benchmark, &result.example);
+            (key, result)
+        })
+        .collect::<HashMap<_, _>>();
+
+    eprintln!(
+        "Comparing against baseline (version {}, {} repetitions)",
+        baseline.version, baseline.repetition_count
+    );
+    let few_samples_count = baseline
+        .results
+        .iter()
+        .chain(&results.results)
+        .filter(|result| has_too_few_samples(result.samples.len()))
+        .count();
+    if few_samples_count > 0 {
+        eprintln!(
+            "Warning: {few_samples_count} of these results have fewer than {} samples, so \
+             their confidence intervals span all of their samples, and only changes larger \
+             than the samples' whole range are reported.",
+            minimum_sample_count(),
+        );
+    }
+    let mut compared_count = 0;
+    let mut regression_count = 0;
+    let mut improvement_count = 0;
+    let mut current_language = None;
+    for result in &results.results {
+        let key = (&result.language, &result.benchmark, &result.example);
+        let Some(baseline_result) = baseline_results.get(&key) else {
+            continue;
+        };
+        compared_count += 1;
+
+        let change = result.median / baseline_result.median.max(1.0) - 1.0;
+        let status = if result.confidence_interval.0 > baseline_result.confidence_interval.1
+            && change >= MINIMUM_REPORTED_CHANGE
+        {
+            regression_count += 1;
+            "regressed"
+        } else if result.confidence_interval.1 < baseline_result.confidence_interval.0
+            && change <= -MINIMUM_REPORTED_CHANGE
+        {
+            improvement_count += 1;
+            "improved"
+        } else {
+            continue;
+        };
+
+        if current_language != Some(&result.language) {
+            eprintln!("\nLanguage: {}", result.language);
+            current_language = Some(&result.language);
+        }
+        eprintln!(
+            "  {status:9} {:28} {}\n            median {:>10.3} ms -> {:>10.3} ms ({:+.1}%)",
+            result.benchmark,
+            result.example,
+            baseline_result.median / 1e6,
+            result.median / 1e6,
+            change * 100.0,
+        );
+    }
+
+    let result_keys = results
+        .results
+        .iter()
+        .map(|result| (&result.language, &result.benchmark, &result.example))
+        .collect::<HashSet<_>>();
+    let missing_results = baseline
+        .results
+        .iter()
+        .filter(|result| {
+            !result_keys.contains(&(&result.language, &result.benchmark, &result.example))
+        })
+        .collect::<Vec<_>>();
+    let new_results = results
+        .results
+        .iter()
+        .filter(|result| {
+            !baseline_results.contains_key(&(&result.language, &result.benchmark, &result.example))
+        })
+        .collect::<Vec<_>>();
+    for (heading, unmatched_results) in [
+        ("Missing from the results", &missing_results),
+        ("Not in the baseline", &new_results),
+    ] {
+        if !unmatched_results.is_empty() {
+            eprintln!("\n{heading}:");
+            for result in unmatched_results {
+                eprintln!(
+                    "  {:12} {:28} {}",
+                    result.language, result.benchmark, result.example
+                );
+            }
+        }
+    }
+
+    eprintln!(
+        "\n{regression_count} regressions and {improvement_count} improvements \
+         in {compared_count} benchmarks ({} missing, {} new)\n",
+        missing_results.len(),
+        new_results.len(),
+    );
+    regression_count > 0
+}
+
+// Run the action once for each repetition, timing each run separately.
+fn time_samples(mut action: impl FnMut()) -> Vec<Duration> {
+    (0..*REPETITION_COUNT)
+        .map(|_| {
+            let time = Instant::now();
+            action();
+            time.elapsed()
+        })
+        .collect()
+}
+
+fn mean(samples: &[Duration]) -> Duration {
+    samples.iter().sum::<Duration>() / (samples.len() as u32)
+}
+
+fn example_name(path: &Path) -> String {
+    path.strip_prefix(GRAMMARS_DIR.as_path())
+        .unwrap_or(path)
+        .to_string_lossy()
+        .into_owned()
+}
+
+fn parse(
+    language: &str,
+    benchmark: &str,
+    path: &Path,
+    max_path_length: usize,
+    mut action: impl FnMut(&[u8]),
+) -> usize {
     eprint!(
         "    {:width$}\t",
         path.file_name().unwrap().to_str().unwrap(),
@@ -200,12 +648,14 @@ fn parse(path: &Path, max_path_length: usize, mut action: impl FnMut(&[u8])) ->
     let source_code = fs::read(path)
         .with_context(|| format!("Failed to read {path:?}"))
         .unwrap();
-    let time = Instant::now();
-    for _ in 0..*REPETITION_COUNT {
-        action(&source_code);
-    }
-    let duration = time.elapsed() / (*REPETITION_COUNT as u32);
-    let duration_ns = duration.as_nanos();
+    let samples = time_samples(|| action(&source_code));
+    let key = ResultKey {
+        language,
+        benchmark,
+        example: &example_name(path),
+    };
+    record_samples(key, &samples);
+    let duration_ns = mean(&samples).as_nanos();
     let speed = ((source_code.len() as u128) * 1_000_000) / duration_ns;
     eprintln!(
         "time {:>7.2} ms\t\tspeed {speed:>6} bytes/ms",
@@ -214,6 +664,563 @@ fn parse(path: &Path, max_path_length: usize, mut action: impl FnMut(&[u8])) ->
     speed as usize
 }
 
+// Apply each edit of the example's trace in turn, timing the incremental reparse and
+// the comparison of the old and new trees separately.
+fn replay_edits(
+    parser: &mut Parser,
+    language_name: &str,
+    path: &Path,
+    max_path_length: usize,
+) -> (Vec<Duration>, Vec<Duration>) {
+    let file_name = path.file_name().unwrap().to_str().unwrap();
+    eprint!("    {file_name:max_path_length$}\t");
+
+    let source_code = fs::read(path)
+        .with_context(|| format!("Failed to read {path:?}"))
+        .unwrap();
+    let edits = EDIT_TRACE_DIR
+        .as_ref()
+        .map(|dir| dir.join(language_name).join(format!("{file_name}.jsonl")))
+        .filter(|trace_path| trace_path.exists())
+        .map_or_else(
+            || synthesize_edits(&source_code),
+            |trace_path| read_edit_trace(&trace_path),
+        );
+    if let Some(dir) = EDIT_TRACE_OUTPUT_DIR.as_ref() {
+        let trace_path = dir.join(language_name).join(format!("{file_name}.jsonl"));
+        write_edit_trace(&trace_path, &edits);
+    }
+
+    let mut reparse_times = Vec::with_capacity(edits.len() * *REPETITION_COUNT);
+    let mut changed_ranges_times = Vec::with_capacity(edits.len() * *REPETITION_COUNT);
+    for _ in 0..*REPETITION_COUNT {
+        let mut input = source_code.clone();
+        let mut tree = parser.parse(&input, None).expect("Failed to parse");
+        for edit in &edits {
+            perform_edit(&mut tree, &mut input, edit)
+                .with_context(|| format!("Invalid edit in trace for {path:?}"))
+                .unwrap();
+
+            let time = Instant::now();
+            let new_tree = parser.parse(&input, Some(&tree)).expect("Failed to parse");
+            reparse_times.push(time.elapsed());
+
+            let time = Instant::now();
+            black_box(tree.changed_ranges(&new_tree).len());
+            changed_ranges_times.push(time.elapsed());
+
+            tree = new_tree;
+        }
+    }
+
+    let example = example_name(path);
+    let key = |benchmark| ResultKey {
+        language: language_name,
+        benchmark,
+        example: &example,
+    };
+    record_samples(key("reparse"), &reparse_times);
+    record_samples(key("changed ranges"), &changed_ranges_times);
+
+    let (reparse_p50, reparse_p99) = percentiles(&mut reparse_times).unwrap_or_default();
+    let (changed_ranges_p50, changed_ranges_p99) =
+        percentiles(&mut changed_ranges_times).unwrap_or_default();
+    eprintln!(
+        "{:>4} edits\treparse p50 {reparse_p50:>8.1} µs  p99 {reparse_p99:>8.1} µs\t\
+         changed ranges p50 {changed_ranges_p50:>6.1} µs  p99 {changed_ranges_p99:>6.1} µs",
+        edits.len(),
+    );
+    (reparse_times, changed_ranges_times)
+}
+
+/// An edit recorded from an editor session. Trace files contain one JSON object per line,
+/// and are looked up at `$TREE_SITTER_BENCHMARK_EDIT_TRACE_DIR/<language>/<example>.jsonl`.
+/// The edits that were replayed are written in the same format to
+/// `$TREE_SITTER_BENCHMARK_EDIT_TRACE_OUTPUT_DIR`, along with a `.edits` file that
+/// contains the same edits in a format that other tools can read without a JSON parser.
+#[derive(Serialize, Deserialize)]
+struct RecordedEdit {
+    position: usize,
+    deleted_length: usize,
+    inserted_text: String,
+}
+
+fn read_edit_trace(path: &Path) -> Vec<Edit> {
+    fs::read_to_string(path)
+        .with_context(|| format!("Failed to read {path:?}"))
+        .unwrap()
+        .lines()
+        .filter(|line| !line.trim().is_empty())
+        .map(|line| {
+            let edit: RecordedEdit = serde_json::from_str(line)
+                .with_context(|| format!("Invalid edit in {path:?}: {line}"))
+                .unwrap();
+            Edit {
+                position: edit.position,
+                deleted_length: edit.deleted_length,
+                inserted_text: edit.inserted_text.into_bytes(),
+            }
+        })
+        .collect()
+}
+
+fn write_edit_trace(path: &Path, edits: &[Edit]) {
+    let mut trace = String::new();
+    let mut plain_trace = Vec::new();
+    for edit in edits {
+        // For each edit, a line with its position, deleted length and inserted length in
+        // bytes, followed by the inserted bytes and a newline.
+        writeln!(
+            plain_trace,
+            "{} {} {}",
+            edit.position,
+            edit.deleted_length,
+            edit.inserted_text.len()
+        )
+        .unwrap();
+        plain_trace.extend_from_slice(&edit.inserted_text);
+        plain_trace.push(b'\n');
+
+        let inserted_text = str::from_utf8(&edit.inserted_text)
+            .with_context(|| format!("Edit for {path:?} inserts invalid UTF-8"))
+            .unwrap();
+        let edit = RecordedEdit {
+            position: edit.position,
+            deleted_length: edit.deleted_length,
+            inserted_text: inserted_text.to_string(),
+        };
+        trace += &serde_json::to_string(&edit).unwrap();
+        trace.push('\n');
+    }
+    fs::create_dir_all(path.parent().unwrap()).unwrap();
+    fs::write(path, trace)
+        .with_context(|| format!("Failed to write {path:?}"))
+        .unwrap();
+    let plain_path = path.with_extension("edits");
+    fs::write(&plain_path, plain_trace)
+        .with_context(|| format!("Failed to write {plain_path:?}"))
+        .unwrap();
+}
+
+// Simulate an editing session as a mix of typing and deleting one character at a time,
+// and pasting whole lines, at random positions.
+fn synthesize_edits(source_code: &[u8]) -> Vec<Edit> {
+    let mut rand = Rand::new(0);
+    let mut input = source_code.to_vec();
+    let mut edits = Vec::with_capacity(*EDIT_COUNT);
+    while edits.len() < *EDIT_COUNT {
+        match rand.unsigned(2) {
+            // Type a few words.
+            0 => {
+                let mut position = char_boundary(&input, rand.unsigned(input.len()));
+                for byte in rand.words(3) {
+                    let edit = Edit {
+                        position,
+                        deleted_length: 0,
+                        inserted_text: vec![byte],
+                    };
+                    push_edit(&mut input, &mut edits, edit);
+                    position += 1;
+                }
+            }
+            // Delete backwards from the cursor.
+            1 => {
+                let mut position = char_boundary(&input, rand.unsigned(input.len()));
+                for _ in 0..rand.unsigned(10) {
+                    if position == 0 {
+                        break;
+                    }
+                    let previous = char_boundary(&input, position - 1);
+                    let edit = Edit {
+                        position: previous,
+                        deleted_length: position - previous,
+                        inserted_text: Vec::new(),
+                    };
+                    push_edit(&mut input, &mut edits, edit);
+                    position = previous;
+                }
+            }
+            // Paste a copy of some lines at the start of another line.
+            _ => {
+                let line_starts = std::iter::once(0)
+                    .chain(memchr::memchr_iter(b'\n', &input).map(|i| i + 1))
+                    .collect::<Vec<_>>();
+                let first_line = rand.unsigned(line_starts.len() - 1);
+                let last_line = first_line + 1 + rand.unsigned(4);
+                let start = line_starts[first_line];
+                let end = line_starts.get(last_line).copied().unwrap_or(input.len());
+                let mut inserted_text = input[start..end].to_vec();
+                if inserted_text.last() != Some(&b'\n') {
+                    inserted_text.push(b'\n');
+                }
+                let edit = Edit {
+                    position: line_starts[rand.unsigned(line_starts.len() - 1)],
+                    deleted_length: 0,
+                    inserted_text,
+                };
+                push_edit(&mut input, &mut edits, edit);
+            }
+        }
+    }
+    edits.truncate(*EDIT_COUNT);
+    edits
+}
+
+fn push_edit(input: &mut Vec<u8>, edits: &mut Vec<Edit>, edit: Edit) {
+    input.splice(
+        edit.position..edit.position + edit.deleted_length,
+        edit.inserted_text.iter().copied(),
+    );
+    edits.push(edit);
+}
+
+fn char_boundary(input: &[u8], mut position: usize) -> usize {
+    while position > 0 && position < input.len() && input[position] & 0xC0 == 0x80 {
+        position -= 1;
+    }
+    position
+}
+
+// Returns the 50th and 99th percentiles, in microseconds.
+fn percentiles(durations: &mut [Duration]) -> Option<(f64, f64)> {
+    if durations.is_empty() {
+        return None;
+    }
+    durations.sort_unstable();
+    let percentile =
+        |percent: usize| durations[(durations.len() - 1) * percent / 100].as_secs_f64() * 1e6;
+    Some((percentile(50), percentile(99)))
+}
+
+fn execute_query(
+    language: &Language,
+    language_name: &str,
+    path: &Path,
+    examples: &[(Vec<u8>, Tree)],
+    max_path_length: usize,
+) {
+    let source = fs::read_to_string(path)
+        .with_context(|| format!("Failed to read {path:?}"))
+        .unwrap();
+    let query = Query::new(language, &source)
+        .with_context(|| format!("Query file path: {path:?}"))
+        .expect("Failed to parse query");
+    let byte_count = examples
+        .iter()
+        .map(|(source_code, _)| source_code.len())
+        .sum();
+
+    let mut cursor = QueryCursor::new();
+    let file_name = path.file_name().unwrap().to_str().unwrap();
+    let example = example_name(path);
+    let key = |benchmark| ResultKey {
+        language: language_name,
+        benchmark,
+        example: &example,
+    };
+    time_throughput(
+        key("query matches"),
+        file_name,
+        max_path_length,
+        byte_count,
+        "captures",
+        || {
+            let mut capture_count = 0;
+            for (source_code, tree) in examples {
+                for query_match in cursor.matches(&query, tree.root_node(), source_code.as_slice())
+                {
+                    capture_count += black_box(query_match).captures.len();
+                }
+            }
+            capture_count
+        },
+    );
+    time_throughput(
+        key("query captures"),
+        "",
+        max_path_length,
+        byte_count,
+        "captures",
+        || {
+            let mut capture_count = 0;
+            for (source_code, tree) in examples {
+                for capture in cursor.captures(&query, tree.root_node(), source_code.as_slice()) {
+                    black_box(capture);
+                    capture_count += 1;
+                }
+            }
+            capture_count
+        },
+    );
+}
+
+fn highlight(
+    config: &HighlightConfiguration,
+    language_name: &str,
+    path: &Path,
+    max_path_length: usize,
+) {
+    let source_code = fs::read(path)
+        .with_context(|| format!("Failed to read {path:?}"))
+        .unwrap();
+    let mut highlighter = Highlighter::new();
+    let file_name = path.file_name().unwrap().to_str().unwrap();
+    let key = ResultKey {
+        language: language_name,
+        benchmark: "highlight",
+        example: &example_name(path),
+    };
+    time_throughput(
+        key,
+        file_name,
+        max_path_length,
+        source_code.len(),
+        "highlights",
+        || {
+            let mut highlight_count = 0;
+            for event in highlighter
+                .highlight(config, &source_code, None, |_| None)
+                .unwrap()
+            {
+                if let HighlightEvent::HighlightStart(_) = black_box(event.unwrap()) {
+                    highlight_count += 1;
+                }
+            }
+            highlight_count
+        },
+    );
+}
+
+fn render_html(
+    config: &HighlightConfiguration,
+    language_name: &str,
+    path: &Path,
+    max_path_length: usize,
+) {
+    let source_code = fs::read(path)
+        .with_context(|| format!("Failed to read {path:?}"))
+        .unwrap();
+    let mut highlighter = Highlighter::new();
+    let events = highlighter
+        .highlight(config, &source_code, None, |_| None)
+        .unwrap()
+        .collect::<Result<Vec<_>, _>>()
+        .unwrap();
+    let attributes = config
+        .query
+        .capture_names()
+        .iter()
+        .map(|name| format!("class={name}"))
+        .collect::<Vec<_>>();
+
+    let file_name = path.file_name().unwrap().to_str().unwrap();
+    let example = example_name(path);
+    let key = |benchmark| ResultKey {
+        language: language_name,
+        benchmark,
+        example: &example,
+    };
+    time_bytes(
+        key("render html (HtmlRenderer)"),
+        file_name,
+        max_path_length,
+        source_code.len(),
+        || {
+            let mut renderer = HtmlRenderer::new();
+            renderer
+                .render(events.iter().copied().map(Ok), &source_code, &|highlight| {
+                    attributes[highlight.0].as_bytes()
+                })
+                .unwrap();
+            io::sink().write_all(&renderer.html).unwrap();
+        },
+    );
+    time_bytes(
+        key("render html (HtmlWriter)"),
+        "",
+        max_path_length,
+        source_code.len(),
+        || {
+            let mut writer = HtmlWriter::new(io::sink(), &attributes);
+            writer
+                .render(events.iter().copied().map(Ok), &source_code)
+                .unwrap();
+            writer.finish().unwrap();
+        },
+    );
+}
+
+const LARGE_FUNCTION_LOCAL_COUNT: usize = 10_000;
+
+fn large_function_locals(
+    language: &Language,
+    language_name: &str,
+    highlight_config: &HighlightConfiguration,
+    query_paths: &[PathBuf],
+    max_path_length: usize,
+) {
+    // Refer back to variables that were defined much earlier in the function, so that
+    // resolving a reference can't stop at the most recent definitions.
+    let mut source_code = String::from("function f(v0) {\n");
+    for i in 1..LARGE_FUNCTION_LOCAL_COUNT {
+        writeln!(&mut source_code, "  let v{i} = v{} + v0;", i / 2).unwrap();
+    }
+    source_code.push_str("  return v1;\n}\n");
+    let source_code = source_code.as_bytes();
+
+    let key = |benchmark| ResultKey {
+        language: language_name,
+        benchmark,
+        example: "large function locals",
+    };
+    let mut highlighter = Highlighter::new();
+    time_bytes(
+        key("highlight"),
+        "highlight",
+        max_path_length,
+        source_code.len(),
+        || {
+            for event in highlighter
+                .highlight(highlight_config, source_code, None, |_| None)
+                .unwrap()
+            {
+                black_box(event.unwrap());
+            }
+        },
+    );
+
+    let Some(tags_query) = read_query(query_paths, "tags.scm") else {
+        return;
+    };
+    let locals_query = read_query(query_paths, "locals.scm").unwrap_or_default();
+    let tags_config = TagsConfiguration::new(language.clone(), &tags_query, &locals_query)
+        .expect("Failed to parse tags query");
+    let mut context = TagsContext::new();
+    time_bytes(
+        key("tags"),
+        "tags",
+        max_path_length,
+        source_code.len(),
+        || {
+            for tag in context
+                .generate_tags(&tags_config, source_code, None)
+                .unwrap()
+                .0
+            {
+                black_box(tag.unwrap());
+            }
+        },
+    );
+}
+
+fn time_bytes(key: ResultKey, label: &str, width: usize, byte_count: usize, action: impl FnMut()) {
+    let samples = time_samples(action);
+    record_samples(key, &samples);
+    let duration_ns = mean(&samples).as_nanos();
+    let speed = ((byte_count as u128) * 1_000_000) / duration_ns;
+    eprintln!(
+        "    {label:width$}\ttime {:>7.2} ms\t\tspeed {speed:>6} bytes/ms",
+        (duration_ns as f64) / 1e6,
+    );
+}
+
+// Like `time_bytes`, but also reports how many items per second the action produced,
+// and the peak amount of memory that it allocated.
+fn time_throughput(
+    key: ResultKey,
+    label: &str,
+    width: usize,
+    byte_count: usize,
+    item_name: &str,
+    mut action: impl FnMut() -> usize,
+) {
+    let mut item_count = 0;
+    let mut samples = Vec::new();
+    let peak_bytes = peak_memory(|| samples = time_samples(|| item_count = action()));
+    record_samples(key, &samples);
+    let duration_ns = mean(&samples).as_nanos().max(1);
+    let speed = ((byte_count as u128) * 1_000_000) / duration_ns;
+    let items_per_second = ((item_count as u128) * 1_000_000_000) / duration_ns;
+    eprintln!(
+        "    {label:width$}\ttime {:>7.2} ms\t\tspeed {speed:>6} bytes/ms\t\
+         {items_per_second:>9} {item_name}/s\tpeak {:>7} KB",
+        (duration_ns as f64) / 1e6,
+        peak_bytes / 1024,
+    );
+}
+
+fn get_highlight_config(
+    language: &Language,
+    language_name: &str,
+    query_paths: &[PathBuf],
+) -> Option<HighlightConfiguration> {
+    let highlights_query = read_query(query_paths, "highlights.scm")?;
+    let mut config = HighlightConfiguration::new(
+        language.clone(),
+        language_name,
+        &highlights_query,
+        &read_query(query_paths, "injections.scm").unwrap_or_default(),
+        &read_query(query_paths, "locals.scm").unwrap_or_default(),
+    )
+    .ok()?;
+    let names = config
+        .query
+        .capture_names()
+        .iter()
+        .map(ToString::to_string)
+        .collect::<Vec<_>>();
+    config.configure(&names);
+    Some(config)
+}
+
+fn read_query(query_paths: &[PathBuf], file_name: &str) -> Option<String> {
+    query_paths
+        .iter()
+        .find(|path| path.file_name().unwrap() == file_name)
+        .map(|path| fs::read_to_string(path).unwrap())
+}
+
+const LARGE_ARRAY_LENGTH: usize = 50_000;
+
+fn child_access(parser: &mut Parser, language_name: &str) {
+    let source_code = format!("[{}]", vec!["0"; LARGE_ARRAY_LENGTH].join(","));
+    let tree = parser.parse(&source_code, None).expect("Failed to parse");
+    let array_node = tree.root_node().child(0).unwrap();
+    let child_count = array_node.child_count();
+
+    let key = |benchmark| ResultKey {
+        language: language_name,
+        benchmark,
+        example: "large array",
+    };
+    time_children(key("child(i)"), child_count, || {
+        for i in 0..child_count {
+            black_box(array_node.child(i));
+        }
+    });
+    time_children(key("child_range(..)"), child_count, || {
+        black_box(array_node.child_range(0..child_count));
+    });
+    let mut cursor = array_node.walk();
+    time_children(key("children(cursor)"), child_count, || {
+        for child in array_node.children(&mut cursor) {
+            black_box(child);
+        }
+    });
+}
+
+fn time_children(key: ResultKey, child_count: usize, action: impl FnMut()) {
+    let samples = time_samples(action);
+    record_samples(key, &samples);
+    let duration_ns = mean(&samples).as_nanos();
+    eprintln!(
+        "    {:18}\ttime {:>7.2} ms\t\t{:>6} ns/child",
+        key.benchmark,
+        (duration_ns as f64) / 1e6,
+        duration_ns / (child_count as u128),
+    );
+}
+
 fn get_language(path: &Path) -> Language {
     let src_path = GRAMMARS_DIR.join(path).join("src");
     TEST_LOADER
@@ -221,3 +1228,119 @@ fn get_language(path: &Path) -> Language {
         .with_context(|| format!("Failed to load language at path {src_path:?}"))
         .unwrap()
 }
+
+// Count the memory allocated both by Rust code and by the tree-sitter library, so
+// that the peak memory use of each benchmark can be reported.
+#[global_allocator]
+static ALLOCATOR: CountingAllocator = CountingAllocator;
+
+static ALLOCATED_BYTES: AtomicUsize = AtomicUsize::new(0);
+static PEAK_ALLOCATED_BYTES: AtomicUsize = AtomicUsize::new(0);
+
+fn record_allocation(size: usize) {
+    let allocated = ALLOCATED_BYTES.fetch_add(size, Ordering::Relaxed) + size;
+    PEAK_ALLOCATED_BYTES.fetch_max(allocated, Ordering::Relaxed);
+}
+
+fn record_deallocation(size: usize) {
+    ALLOCATED_BYTES.fetch_sub(size, Ordering::Relaxed);
+}
+
+// Returns the largest number of bytes that were allocated at any point while running the
+// action, not counting the ones that were already allocated before it started.
+fn peak_memory(action: impl FnOnce()) -> usize {
+    let baseline = ALLOCATED_BYTES.load(Ordering::Relaxed);
+    PEAK_ALLOCATED_BYTES.store(baseline, Ordering::Relaxed);
+    action();
+    PEAK_ALLOCATED_BYTES.load(Ordering::Relaxed) - baseline
+}
+
+struct CountingAllocator;
+
+unsafe impl GlobalAlloc for CountingAllocator {
+    unsafe fn alloc(&self, layout: Layout) -> *mut u8 {
+        let result = System.alloc(layout);
+        if !result.is_null() {
+            record_allocation(layout.size());
+        }
+        result
+    }
+
+    unsafe fn alloc_zeroed(&self, layout: Layout) -> *mut u8 {
+        let result = System.alloc_zeroed(layout);
+        if !result.is_null() {
+            record_allocation(layout.size());
+        }
+        result
+    }
+
+    unsafe fn realloc(&self, ptr: *mut u8, layout: Layout, new_size: usize) -> *mut u8 {
+        let result = System.realloc(ptr, layout, new_size);
+        if !result.is_null() {
+            record_deallocation(layout.size());
+            record_allocation(new_size);
+        }
+        result
+    }
+
+    unsafe fn dealloc(&self, ptr: *mut u8, layout: Layout) {
+        record_deallocation(layout.size());
+        System.dealloc(ptr, layout);
+    }
+}
+
+extern "C" {
+    fn malloc(size: usize) -> *mut c_void;
+    fn realloc(ptr: *mut c_void, size: usize) -> *mut c_void;
+    fn free(ptr: *mut c_void);
+}
+
+// The library's allocations are prefixed with their size, so that it can be
+// subtracted again when they are freed.
+const ALLOCATION_HEADER_SIZE: usize = 16;
+
+unsafe extern "C" fn ts_counting_malloc(size: usize) -> *mut c_void {
+    let header = malloc(size + ALLOCATION_HEADER_SIZE).cast::<usize>();
+    if header.is_null() {
+        return ptr::null_mut();
+    }
+    header.write(size);
+    record_allocation(size);
+    header.cast::<u8>().add(ALLOCATION_HEADER_SIZE).cast()
+}
+
+unsafe extern "C" fn ts_counting_calloc(count: usize, size: usize) -> *mut c_void {
+    let Some(size) = count.checked_mul(size) else {
+        return ptr::null_mut();
+    };
+    let result = ts_counting_malloc(size);
+    if !result.is_null() {
+        ptr::write_bytes(result.cast::<u8>(), 0, size);
+    }
+    result
+}
+
+unsafe extern "C" fn ts_counting_realloc(ptr: *mut c_void, size: usize) -> *mut c_void {
+    if ptr.is_null() {
+        return ts_counting_malloc(size);
+    }
+    let header = ptr.cast::<u8>().sub(ALLOCATION_HEADER_SIZE).cast::<usize>();
+    let old_size = header.read();
+    let header = realloc(header.cast(), size + ALLOCATION_HEADER_SIZE).cast::<usize>();
+    if header.is_null() {
+        return ptr::null_mut();
+    }
+    header.write(size);
+    record_deallocation(old_size);
+    record_allocation(size);
+    header.cast::<u8>().add(ALLOCATION_HEADER_SIZE).cast()
+}
+
+unsafe extern "C" fn ts_counting_free(ptr: *mut c_void) {
+    if ptr.is_null() {
+        return;
+    }
+    let header = ptr.cast::<u8>().sub(ALLOCATION_HEADER_SIZE).cast::<usize>();
+    record_deallocation(header.read());
+    free(header.cast());
+}
@@ -1,11 +1,12 @@
 #![doc = include_str!("../README.md")]
 
 use std::{
-    collections::HashMap,
+    collections::{hash_map::DefaultHasher, HashMap},
     env,
     ffi::{OsStr, OsString},
     fs,
-    io::{BufRead, BufReader},
+    hash::{Hash, Hasher},
+    io::{BufRead, BufReader, Write},
     mem,
     ops::Range,
     path::{Path, PathBuf},
@@ -102,6 +103,7 @@ pub struct LanguageConfiguration<'a> {
     tags_config: OnceCell<Option<TagsConfiguration>>,
     highlight_names: &'a Mutex<Vec<String>>,
     use_all_highlight_names: bool,
+    precompiled_highlights_path: Option<PathBuf>,
 }
 
 pub struct Loader {
@@ -113,6 +115,7 @@ pub struct Loader {
     language_configuration_ids_by_first_line_regex: HashMap<String, Vec<usize>>,
     highlight_names: Box<Mutex<Vec<String>>>,
     use_all_highlight_names: bool,
+    precompiled_highlights_path: Option<PathBuf>,
     debug_build: bool,
 
     #[cfg(feature = "wasm")]
@@ -176,6 +179,7 @@ impl Loader {
             language_configuration_ids_by_first_line_regex: HashMap::new(),
             highlight_names: Box::new(Mutex::new(Vec::new())),
             use_all_highlight_names: true,
+            precompiled_highlights_path: None,
             debug_build: false,
 
             #[cfg(feature = "wasm")]
@@ -195,6 +199,17 @@ impl Loader {
         self.highlight_names.lock().unwrap().clone()
     }
 
+    /// Store precompiled highlight configurations in the given directory, and load them
+    /// from there instead of compiling the highlight queries, when they are up to date.
+    ///
+    /// Each configuration is stored in a file whose name contains a hash of the language's
+    /// ABI version, its node types and fields, the path, size and modification time of its
+    /// generated `src/parser.c`, and the contents of its query files. Languages without a
+    /// generated parser are not precompiled. This must be set before the languages are found.
+    pub fn use_precompiled_highlights(&mut self, path: Option<PathBuf>) {
+        self.precompiled_highlights_path = path;
+    }
+
     pub fn find_all_languages(&mut self, config: &Config) -> Result<()> {
         if config.parser_directories.is_empty() {
             eprintln!("Warning: You have not configured any parser directories!");
@@ -1026,6 +1041,7 @@ impl Loader {
                         tags_config: OnceCell::new(),
                         highlight_names: &self.highlight_names,
                         use_all_highlight_names: self.use_all_highlight_names,
+                        precompiled_highlights_path: self.precompiled_highlights_path.clone(),
                     };
 
                     for file_type in &configuration.file_types {
@@ -1083,6 +1099,7 @@ impl Loader {
                 tags_config: OnceCell::new(),
                 highlight_names: &self.highlight_names,
                 use_all_highlight_names: self.use_all_highlight_names,
+                precompiled_highlights_path: self.precompiled_highlights_path.clone(),
             };
             self.language_configurations.push(unsafe {
                 mem::transmute::<LanguageConfiguration<'_>, LanguageConfiguration<'static>>(
@@ -1225,6 +1242,27 @@ impl<'a> LanguageConfiguration<'a> {
                 if highlights_query.is_empty() {
                     Ok(None)
                 } else {
+                    let precompiled_path =
+                        self.precompiled_highlights_path.as_ref().and_then(|dir| {
+                            let key = precompiled_highlights_key(
+                                &language,
+                                &self.root_path.join("src").join("parser.c"),
+                                &[&highlights_query, &injections_query, &locals_query],
+                            )
+                            .ok()?;
+                            Some(dir.join(format!("{}-{key:016x}.bin", self.language_name)))
+                        });
+                    if let Some(mut result) = precompiled_path
+                        .as_ref()
+                        .and_then(|path| fs::read(path).ok())
+                        .and_then(|data| {
+                            HighlightConfiguration::deserialize(language.clone(), &data)
+                        })
+                    {
+                        self.configure_highlight_names(&mut result);
+                        return Ok(Some(result));
+                    }
+
                     let mut result = HighlightConfiguration::new(
                         language,
                         &self.language_name,
@@ -1259,22 +1297,40 @@ impl<'a> LanguageConfiguration<'a> {
                             }
                         }
                     })?;
-                    let mut all_highlight_names = self.highlight_names.lock().unwrap();
-                    if self.use_all_highlight_names {
-                        for capture_name in result.query.capture_names() {
-                            if !all_highlight_names.iter().any(|x| x == capture_name) {
-                                all_highlight_names.push((*capture_name).to_string());
-                            }
-                        }
+                    if let Some(path) = &precompiled_path {
+                        // The precompiled configuration is only a cache, so failing to
+                        // write it is not an error.
+                        let _ = Self::write_precompiled_highlights(path, &result.serialize());
                     }
-                    result.configure(all_highlight_names.as_slice());
-                    drop(all_highlight_names);
+                    self.configure_highlight_names(&mut result);
                     Ok(Some(result))
                 }
             })
             .map(Option::as_ref)
     }
 
+    fn configure_highlight_names(&self, config: &mut HighlightConfiguration) {
+        let mut all_highlight_names = self.highlight_names.lock().unwrap();
+        if self.use_all_highlight_names {
+            for capture_name in config.query.capture_names() {
+                if !all_highlight_names.iter().any(|x| x == capture_name) {
+                    all_highlight_names.push((*capture_name).to_string());
+                }
+            }
+        }
+        config.configure(all_highlight_names.as_slice());
+    }
+
+    // Write the file atomically, so that other processes never read a partial file.
+    fn write_precompiled_highlights(path: &Path, data: &[u8]) -> Result<()> {
+        let dir = path.parent().unwrap();
+        fs::create_dir_all(dir)?;
+        let mut file = tempfile::NamedTempFile::new_in(dir)?;
+        file.write_all(data)?;
+        file.persist(path)?;
+        Ok(())
+    }
+
     pub fn tags_config(&self, language: Language) -> Result<Option<&TagsConfiguration>> {
         self.tags_config
             .get_or_try_init(|| {
@@ -1385,6 +1441,35 @@ fn needs_recompile(lib_path: &Path, paths_to_check: &[PathBuf]) -> Result<bool>
     Ok(false)
 }
 
+// A precompiled highlight configuration refers to the language's symbols and fields by id,
+// so it is only valid for the exact same language and queries. Compiling the queries also
+// analyzes them using the language's parse tables, which can change without changing any
+// symbol names, so the key also covers the generated parser that the language is built from.
+fn precompiled_highlights_key(
+    language: &Language,
+    parser_path: &Path,
+    queries: &[&str],
+) -> Result<u64> {
+    let parser_metadata = fs::metadata(parser_path)?;
+    let mut hasher = DefaultHasher::new();
+    env!("CARGO_PKG_VERSION").hash(&mut hasher);
+    parser_path.hash(&mut hasher);
+    parser_metadata.len().hash(&mut hasher);
+    parser_metadata.modified()?.hash(&mut hasher);
+    language.version().hash(&mut hasher);
+    language.node_kind_count().hash(&mut hasher);
+    for id in 0..language.node_kind_count() as u16 {
+        language.node_kind_for_id(id).hash(&mut hasher);
+        language.node_kind_is_named(id).hash(&mut hasher);
+    }
+    language.field_count().hash(&mut hasher);
+    for id in 1..=language.field_count() as u16 {
+        language.field_name_for_id(id).hash(&mut hasher);
+    }
+    queries.hash(&mut hasher);
+    Ok(hasher.finish())
+}
+
 fn mtime(path: &Path) -> Result<SystemTime> {
     Ok(fs::metadata(path)?.modified()?)
 }
@@ -1,5 +1,11 @@
 use std::{
-    collections::HashMap, fmt::Write, fs, io, path, str, sync::atomic::AtomicUsize, time::Instant,
+    collections::HashMap,
+    fmt::Write,
+    fs,
+    io::{self, Write as _},
+    path, str,
+    sync::atomic::AtomicUsize,
+    time::Instant,
 };
 
 use ansi_term::Color;
@@ -331,7 +337,7 @@ pub fn ansi(
     cancellation_flag: Option<&AtomicUsize>,
 ) -> Result<()> {
     let stdout = io::stdout();
-    let mut stdout = stdout.lock();
+    let mut stdout = io::BufWriter::new(stdout.lock());
     let time = Instant::now();
     let mut highlighter = Highlighter::new();
 
@@ -339,24 +345,35 @@ pub fn ansi(
         loader.highlight_config_for_injection_string(string)
     })?;
 
-    let mut style_stack = vec![theme.default_style().ansi];
+    // Format each style's escape sequences once, rather than for every
+    // piece of source text that is written with that style.
+    let escape_codes =
+        |style: ansi_term::Style| (style.prefix().to_string(), style.suffix().to_string());
+    let default_codes = escape_codes(theme.default_style().ansi);
+    let codes = theme
+        .styles
+        .iter()
+        .map(|style| escape_codes(style.ansi))
+        .collect::<Vec<_>>();
+
+    let mut style_stack = vec![&default_codes];
     for event in events {
         match event? {
             HighlightEvent::HighlightStart(highlight) => {
-                style_stack.push(theme.styles[highlight.0].ansi);
+                style_stack.push(&codes[highlight.0]);
             }
             HighlightEvent::HighlightEnd => {
                 style_stack.pop();
             }
             HighlightEvent::Source { start, end } => {
-                style_stack
-                    .last()
-                    .unwrap()
-                    .paint(&source[start..end])
-                    .write_to(&mut stdout)?;
+                let (prefix, suffix) = style_stack.last().unwrap();
+                stdout.write_all(prefix.as_bytes())?;
+                stdout.write_all(&source[start..end])?;
+                stdout.write_all(suffix.as_bytes())?;
             }
         }
     }
+    stdout.flush()?;
 
     if print_time {
         eprintln!("Time: {}ms", time.elapsed().as_millis());
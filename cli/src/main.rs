@@ -1,6 +1,7 @@
 use std::{
     collections::HashSet,
     env, fs,
+    num::NonZeroUsize,
     path::{Path, PathBuf},
 };
 
@@ -342,6 +343,19 @@ struct Tags {
     pub paths: Option<Vec<String>>,
     #[arg(long, help = "The path to an alternative config.json file")]
     pub config_path: Option<PathBuf>,
+    #[arg(
+        long,
+        help = "Write the tags to a binary index at this path, instead of printing them"
+    )]
+    pub index: Option<PathBuf>,
+    #[arg(
+        long,
+        requires = "index",
+        help = "Update the existing index with the given files, instead of replacing it"
+    )]
+    pub update: bool,
+    #[arg(long, help = "The number of threads to use when writing an index")]
+    pub threads: Option<NonZeroUsize>,
 }
 
 #[derive(Args)]
@@ -895,14 +909,30 @@ fn run() -> Result<()> {
             let loader_config = config.get()?;
             loader.find_all_languages(&loader_config)?;
             let paths = collect_paths(tags_options.paths_file.as_deref(), tags_options.paths)?;
-            tags::generate_tags(
-                &loader,
-                &config.get()?,
-                tags_options.scope.as_deref(),
-                &paths,
-                tags_options.quiet,
-                tags_options.time,
-            )?;
+            if let Some(index_path) = tags_options.index {
+                let thread_count = tags_options.threads.unwrap_or_else(|| {
+                    std::thread::available_parallelism().unwrap_or(NonZeroUsize::MIN)
+                });
+                tags::generate_tags_index(
+                    &loader,
+                    &config.get()?,
+                    tags_options.scope.as_deref(),
+                    &paths,
+                    &index_path,
+                    tags_options.update,
+                    thread_count,
+                    tags_options.time,
+                )?;
+            } else {
+                tags::generate_tags(
+                    &loader,
+                    &config.get()?,
+                    tags_options.scope.as_deref(),
+                    &paths,
+                    tags_options.quiet,
+                    tags_options.time,
+                )?;
+            }
         }
 
         Commands::Playground(playground_options) => {
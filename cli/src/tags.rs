@@ -1,33 +1,140 @@
 use std::{
     fs,
     io::{self, Write},
+    num::NonZeroUsize,
     path::Path,
     str,
+    sync::atomic::Ordering,
     time::Instant,
 };
 
-use anyhow::{anyhow, Result};
-use tree_sitter_loader::{Config, Loader};
-use tree_sitter_tags::TagsContext;
+use anyhow::{anyhow, Context, Result};
+use tree_sitter::Language;
+use tree_sitter_loader::{Config, LanguageConfiguration, Loader};
+use tree_sitter_tags::{
+    index::{TagsIndex, TagsIndexBuilder},
+    TagsContext,
+};
 
 use super::util;
 
-pub fn generate_tags(
+#[allow(clippy::too_many_arguments)]
+pub fn generate_tags_index(
     loader: &Loader,
     loader_config: &Config,
     scope: Option<&str>,
     paths: &[String],
-    quiet: bool,
+    index_path: &Path,
+    update: bool,
+    thread_count: NonZeroUsize,
     time: bool,
 ) -> Result<()> {
-    let mut lang = None;
-    if let Some(scope) = scope {
-        lang = loader.language_configuration_for_scope(scope)?;
-        if lang.is_none() {
-            return Err(anyhow!("Unknown scope '{scope}'"));
+    let lang = language_for_scope(loader, scope)?;
+    let mut files = Vec::with_capacity(paths.len());
+    let mut untaggable_paths = Vec::new();
+    for path in paths {
+        let path = Path::new(path);
+        let (language, language_config) = match lang.clone() {
+            Some(v) => v,
+            None => {
+                if let Some(v) = loader.language_configuration_for_file_name(path)? {
+                    v
+                } else {
+                    eprintln!("{}", util::lang_not_found_for_path(path, loader_config));
+                    untaggable_paths.push(path);
+                    continue;
+                }
+            }
+        };
+        if let Some(tags_config) = language_config.tags_config(language)? {
+            files.push((path, tags_config));
+        } else {
+            eprintln!("No tags config found for path {path:?}");
+            untaggable_paths.push(path);
+        }
+    }
+
+    let mut builder = if update && index_path.exists() {
+        let file = fs::File::open(index_path)
+            .with_context(|| format!("Failed to open index {index_path:?}"))?;
+        let mut index = TagsIndex::new(io::BufReader::new(file))
+            .with_context(|| format!("Failed to read index {index_path:?}"))?;
+        TagsIndexBuilder::from_index(&mut index)
+            .with_context(|| format!("Failed to read index {index_path:?}"))?
+    } else {
+        TagsIndexBuilder::new()
+    };
+
+    // Drop the tags of indexed files that have been deleted since the index was
+    // written, or that can no longer be tagged.
+    let removed_paths = builder
+        .paths()
+        .filter(|path| !Path::new(path).exists())
+        .map(str::to_string)
+        .collect::<Vec<_>>();
+    for path in removed_paths {
+        builder.remove_file(&path);
+    }
+    for path in untaggable_paths {
+        builder.remove_file(&path.to_string_lossy());
+    }
+
+    let cancellation_flag = util::cancel_on_signal();
+    let t0 = Instant::now();
+    for (i, error) in builder.add_files(&files, thread_count, Some(&cancellation_flag)) {
+        // When updating an index, files that no longer exist are simply removed from it.
+        if !(update && error.kind() == io::ErrorKind::NotFound) {
+            eprintln!("Failed to tag {:?}: {error}", files[i].0);
         }
     }
+    if cancellation_flag.load(Ordering::SeqCst) != 0 {
+        return Err(anyhow!("Cancelled"));
+    }
+
+    // Replace the index only once the new one has been written completely.
+    let mut temp_path = index_path.as_os_str().to_owned();
+    temp_path.push(".tmp");
+    let result = fs::File::create(&temp_path).and_then(|file| {
+        let mut writer = io::BufWriter::new(file);
+        builder.write(&mut writer)?;
+        writer.flush()
+    });
+    if let Err(error) = result {
+        fs::remove_file(&temp_path).ok();
+        return Err(error).with_context(|| format!("Failed to write index {index_path:?}"));
+    }
+    fs::rename(&temp_path, index_path)?;
 
+    if time {
+        println!("time: {}ms", t0.elapsed().as_millis());
+    }
+
+    Ok(())
+}
+
+fn language_for_scope<'a>(
+    loader: &'a Loader,
+    scope: Option<&str>,
+) -> Result<Option<(Language, &'a LanguageConfiguration<'a>)>> {
+    let Some(scope) = scope else {
+        return Ok(None);
+    };
+    let lang = loader.language_configuration_for_scope(scope)?;
+    if lang.is_none() {
+        return Err(anyhow!("Unknown scope '{scope}'"));
+    }
+    Ok(lang)
+}
+
+pub fn generate_tags(
+    loader: &Loader,
+    loader_config: &Config,
+    scope: Option<&str>,
+    paths: &[String],
+    quiet: bool,
+    time: bool,
+) -> Result<()> {
+    let lang = language_for_scope(loader, scope)?;
     let mut context = TagsContext::new();
     let cancellation_flag = util::cancel_on_signal();
     let stdout = io::stdout();
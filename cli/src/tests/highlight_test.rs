@@ -1,14 +1,18 @@
 use std::{
     ffi::CString,
     fs,
+    num::NonZeroUsize,
+    ops,
     os::raw::c_char,
     ptr, slice, str,
     sync::atomic::{AtomicUsize, Ordering},
 };
 
 use lazy_static::lazy_static;
+use tree_sitter::{InputEdit, Point};
 use tree_sitter_highlight::{
-    c, Error, Highlight, HighlightConfiguration, HighlightEvent, Highlighter, HtmlRenderer,
+    c, Error, Highlight, HighlightConfiguration, HighlightEvent, HighlightSession, Highlighter,
+    HtmlRenderer, HtmlWriter,
 };
 
 use super::helpers::fixtures::{get_highlight_config, get_language, get_language_queries_path};
@@ -344,6 +348,48 @@ fn test_highlighting_carriage_returns() {
     );
 }
 
+#[test]
+fn test_highlighting_with_html_writer() {
+    let carriage_return_highlight = HIGHLIGHT_NAMES
+        .iter()
+        .position(|s| s == "carriage-return")
+        .map(Highlight);
+    let javascript = "a = \"a\rb\"\r\nb\r\nconst c = '<&>' + d(e)\n".repeat(200);
+    let html = "<div>\n<script>const a = `<b>${c}</b>`;</script>\n</div>\n".repeat(200);
+    let mut invalid_utf8 = b"const s = '\xc0\xc1';\n".repeat(10);
+    invalid_utf8.extend_from_slice(b"// a\r\xe2\x80");
+
+    for (source, config) in [
+        (javascript.as_bytes(), &*JS_HIGHLIGHT),
+        (html.as_bytes(), &*HTML_HIGHLIGHT),
+        (&invalid_utf8, &*JS_HIGHLIGHT),
+    ] {
+        let mut highlighter = Highlighter::new();
+        let events = highlighter
+            .highlight(config, source, None, &test_language_for_injection_string)
+            .unwrap()
+            .map(Result::unwrap)
+            .collect::<Vec<_>>();
+
+        let mut renderer = HtmlRenderer::new();
+        renderer.set_carriage_return_highlight(carriage_return_highlight);
+        renderer
+            .render(events.iter().copied().map(Ok), source, &|highlight| {
+                HTML_ATTRS[highlight.0].as_bytes()
+            })
+            .unwrap();
+
+        let mut writer = HtmlWriter::new(Vec::new(), &HTML_ATTRS);
+        writer.set_carriage_return_highlight(carriage_return_highlight);
+        writer
+            .render(events.iter().copied().map(Ok), source)
+            .unwrap();
+        let html = writer.finish().unwrap();
+
+        assert_eq!(str::from_utf8(&html), str::from_utf8(&renderer.html));
+    }
+}
+
 #[test]
 fn test_highlighting_ejs_with_html_and_javascript() {
     let source = ["<div><% foo() %></div><script> bar() </script>"].join("\n");
@@ -489,77 +535,9 @@ fn test_highlighting_cancellation() {
 
 #[test]
 fn test_highlighting_via_c_api() {
-    let highlights = [
-        "class=tag\0",
-        "class=function\0",
-        "class=string\0",
-        "class=keyword\0",
-    ];
-    let highlight_names = highlights
-        .iter()
-        .map(|h| h["class=".len()..].as_ptr().cast::<c_char>())
-        .collect::<Vec<_>>();
-    let highlight_attrs = highlights
-        .iter()
-        .map(|h| h.as_bytes().as_ptr().cast::<c_char>())
-        .collect::<Vec<_>>();
-    let highlighter = unsafe {
-        c::ts_highlighter_new(
-            std::ptr::addr_of!(highlight_names[0]),
-            std::ptr::addr_of!(highlight_attrs[0]),
-            highlights.len() as u32,
-        )
-    };
-
+    let highlighter = new_c_highlighter();
     let source_code = c_string("<script>\nconst a = b('c');\nc.d();\n</script>");
-
-    let js_scope = c_string("source.js");
-    let js_injection_regex = c_string("^javascript");
-    let language = get_language("javascript");
-    let lang_name = c_string("javascript");
-    let queries = get_language_queries_path("javascript");
-    let highlights_query = fs::read_to_string(queries.join("highlights.scm")).unwrap();
-    let injections_query = fs::read_to_string(queries.join("injections.scm")).unwrap();
-    let locals_query = fs::read_to_string(queries.join("locals.scm")).unwrap();
-    unsafe {
-        c::ts_highlighter_add_language(
-            highlighter,
-            lang_name.as_ptr(),
-            js_scope.as_ptr(),
-            js_injection_regex.as_ptr(),
-            language,
-            highlights_query.as_ptr().cast::<c_char>(),
-            injections_query.as_ptr().cast::<c_char>(),
-            locals_query.as_ptr().cast::<c_char>(),
-            highlights_query.len() as u32,
-            injections_query.len() as u32,
-            locals_query.len() as u32,
-        );
-    }
-
     let html_scope = c_string("text.html.basic");
-    let html_injection_regex = c_string("^html");
-    let language = get_language("html");
-    let lang_name = c_string("html");
-    let queries = get_language_queries_path("html");
-    let highlights_query = fs::read_to_string(queries.join("highlights.scm")).unwrap();
-    let injections_query = fs::read_to_string(queries.join("injections.scm")).unwrap();
-    unsafe {
-        c::ts_highlighter_add_language(
-            highlighter,
-            lang_name.as_ptr(),
-            html_scope.as_ptr(),
-            html_injection_regex.as_ptr(),
-            language,
-            highlights_query.as_ptr().cast::<c_char>(),
-            injections_query.as_ptr().cast::<c_char>(),
-            ptr::null(),
-            highlights_query.len() as u32,
-            injections_query.len() as u32,
-            0,
-        );
-    }
-
     let buffer = c::ts_highlight_buffer_new();
 
     unsafe {
@@ -573,26 +551,8 @@ fn test_highlighting_via_c_api() {
         );
     }
 
-    let output_bytes = unsafe { c::ts_highlight_buffer_content(buffer) };
-    let output_line_offsets = unsafe { c::ts_highlight_buffer_line_offsets(buffer) };
-    let output_len = unsafe { c::ts_highlight_buffer_len(buffer) };
-    let output_line_count = unsafe { c::ts_highlight_buffer_line_count(buffer) };
-
-    let output_bytes = unsafe { slice::from_raw_parts(output_bytes, output_len as usize) };
-    let output_line_offsets =
-        unsafe { slice::from_raw_parts(output_line_offsets, output_line_count as usize) };
-
-    let mut lines = Vec::new();
-    for i in 0..(output_line_count as usize) {
-        let line_start = output_line_offsets[i] as usize;
-        let line_end = output_line_offsets
-            .get(i + 1)
-            .map_or(output_bytes.len(), |x| *x as usize);
-        lines.push(str::from_utf8(&output_bytes[line_start..line_end]).unwrap());
-    }
-
     assert_eq!(
-        lines,
+        c_highlight_buffer_lines(buffer),
         vec![
             "&lt;<span class=tag>script</span>&gt;\n",
             "<span class=keyword>const</span> a = <span class=function>b</span>(<span class=string>&#39;c&#39;</span>);\n",
@@ -607,6 +567,98 @@ fn test_highlighting_via_c_api() {
     }
 }
 
+#[test]
+fn test_highlighting_batch_via_c_api() {
+    let highlighter = new_c_highlighter();
+    let html_scope = c_string("text.html.basic");
+    let js_scope = c_string("source.js");
+    let unknown_scope = c_string("source.unknown");
+
+    let mut documents = (0..50)
+        .map(|i| {
+            (
+                &html_scope,
+                c_string(&format!("<script>\nconst a{i} = b('c');\n</script>")),
+            )
+        })
+        .collect::<Vec<_>>();
+    documents.insert(10, (&unknown_scope, c_string("a")));
+    documents.insert(20, (&js_scope, c_string("c.d();")));
+
+    let scope_names = documents
+        .iter()
+        .map(|(scope, _)| scope.as_ptr())
+        .collect::<Vec<_>>();
+    let source_codes = documents
+        .iter()
+        .map(|(_, source)| source.as_ptr())
+        .collect::<Vec<_>>();
+    let source_code_lens = documents
+        .iter()
+        .map(|(_, source)| source.as_bytes().len() as u32)
+        .collect::<Vec<_>>();
+    let buffers = documents
+        .iter()
+        .map(|_| c::ts_highlight_buffer_new())
+        .collect::<Vec<_>>();
+    let mut errors = documents
+        .iter()
+        .map(|_| c::ErrorCode::Timeout)
+        .collect::<Vec<_>>();
+
+    unsafe {
+        c::ts_highlighter_highlight_batch(
+            highlighter,
+            scope_names.as_ptr(),
+            source_codes.as_ptr(),
+            source_code_lens.as_ptr(),
+            buffers.as_ptr(),
+            errors.as_mut_ptr(),
+            documents.len() as u32,
+            4,
+            ptr::null(),
+        );
+    }
+
+    for (i, (error, buffer)) in errors.iter().zip(&buffers).enumerate() {
+        match i {
+            10 => assert!(matches!(error, c::ErrorCode::UnknownScope)),
+            20 => {
+                assert!(matches!(error, c::ErrorCode::Ok));
+                assert_eq!(
+                    c_highlight_buffer_lines(*buffer),
+                    vec!["c.<span class=function>d</span>();\n"]
+                );
+            }
+            _ => {
+                let index = if i < 10 {
+                    i
+                } else if i < 20 {
+                    i - 1
+                } else {
+                    i - 2
+                };
+                assert!(matches!(error, c::ErrorCode::Ok));
+                assert_eq!(
+                    c_highlight_buffer_lines(*buffer),
+                    vec![
+                        "&lt;<span class=tag>script</span>&gt;\n".to_string(),
+                        format!("<span class=keyword>const</span> a{index} = <span class=function>b</span>(<span class=string>&#39;c&#39;</span>);\n"),
+                        "&lt;/<span class=tag>script</span>&gt;\n".to_string(),
+                    ]
+                );
+            }
+        }
+    }
+
+    unsafe {
+        c::ts_highlighter_delete(highlighter);
+        for buffer in buffers {
+            c::ts_highlight_buffer_delete(buffer);
+        }
+    }
+}
+
 #[test]
 fn test_highlighting_with_all_captures_applied() {
     let source = "fn main(a: u32, b: u32) -> { let c = a + b; }";
@@ -666,6 +718,347 @@ fn test_highlighting_with_all_captures_applied() {
     );
 }
 
+#[test]
+fn test_highlighting_range() {
+    let source = [
+        "module.exports = function a(b) {",
+        "  const module = c;",
+        "  console.log(module, b);",
+        "}",
+        "const d = html `<div>${e}</div>`;",
+    ]
+    .join("\n");
+
+    // A local variable in the top-level scope is used within a later function, so
+    // highlighting that function's lines depends on a definition outside of its scope.
+    let top_level_local_source = [
+        "const module = require('a');",
+        "function f(b) {",
+        "  return module(b);",
+        "}",
+    ]
+    .join("\n");
+
+    let mut highlighter = Highlighter::new();
+    for source in [&source, &top_level_local_source] {
+        let expected = highlights_by_byte(
+            highlighter
+                .highlight(
+                    &JS_HIGHLIGHT,
+                    source.as_bytes(),
+                    None,
+                    &test_language_for_injection_string,
+                )
+                .unwrap(),
+            source.len(),
+        );
+
+        // Each line is highlighted the same way as it is within the whole document,
+        // including local variables that are defined on earlier lines.
+        let mut line_start = 0;
+        for line in source.split_inclusive('\n') {
+            let range = line_start..line_start + line.len();
+            let actual = highlights_by_byte(
+                highlighter
+                    .highlight_range(
+                        &JS_HIGHLIGHT,
+                        source.as_bytes(),
+                        range.clone(),
+                        None,
+                        &test_language_for_injection_string,
+                    )
+                    .unwrap(),
+                source.len(),
+            );
+            for (i, highlights) in actual.iter().enumerate() {
+                if range.contains(&i) {
+                    assert_eq!(highlights, &expected[i], "byte {i} in range {range:?}");
+                } else {
+                    assert_eq!(highlights, &None, "byte {i} outside range {range:?}");
+                }
+            }
+            line_start = range.end;
+        }
+    }
+
+    // A range can begin in the middle of a highlighted node.
+    let start = source.find("onsole").unwrap();
+    let events = highlighter
+        .highlight_range(
+            &JS_HIGHLIGHT,
+            source.as_bytes(),
+            start..start + 10,
+            None,
+            &test_language_for_injection_string,
+        )
+        .unwrap()
+        .map(|event| match event.unwrap() {
+            HighlightEvent::HighlightStart(highlight) => HIGHLIGHT_NAMES[highlight.0].as_str(),
+            HighlightEvent::HighlightEnd => "end",
+            HighlightEvent::Source { start, end } => &source[start..end],
+        })
+        .collect::<Vec<_>>();
+    assert_eq!(
+        events,
+        [
+            "variable.builtin",
+            "onsole",
+            "end",
+            "punctuation.delimiter",
+            ".",
+            "end",
+            "function",
+            "log",
+            "end",
+        ]
+    );
+}
+
+#[test]
+fn test_highlighting_injections_in_parallel() {
+    let source = (0..20)
+        .map(|i| format!("<script>\nconst a{i} = html `<div>${{b{i}}}</div>`;\n</script>\n"))
+        .collect::<String>();
+
+    let mut highlighter = Highlighter::new();
+    let mut parallel_highlighter = Highlighter::new();
+    parallel_highlighter.set_thread_count(NonZeroUsize::new(4).unwrap());
+    for range in [0..source.len(), 100..300, 500..source.len()] {
+        let events = |highlighter: &mut Highlighter| {
+            highlighter
+                .highlight_range(
+                    &HTML_HIGHLIGHT,
+                    source.as_bytes(),
+                    range.clone(),
+                    None,
+                    &test_language_for_injection_string,
+                )
+                .unwrap()
+                .map(|event| format!("{:?}", event.unwrap()))
+                .collect::<Vec<_>>()
+        };
+        assert_eq!(events(&mut parallel_highlighter), events(&mut highlighter));
+    }
+}
+
+#[test]
+fn test_highlighting_with_session() {
+    let mut source = [
+        "const a = html `<div>${b}</div>`;",
+        "const c = 1;",
+        "const d = html `<span>${e}</span>`;",
+    ]
+    .join("\n");
+
+    let mut highlighter = Highlighter::new();
+    let mut session = HighlightSession::new(&JS_HIGHLIGHT);
+    let changed_ranges = session
+        .update(
+            &mut highlighter,
+            source.as_bytes(),
+            None,
+            test_language_for_injection_string,
+        )
+        .unwrap()
+        .to_vec();
+    assert_eq!(changed_ranges, [0..source.len()]);
+    assert_session_highlights(
+        &session,
+        &JS_HIGHLIGHT,
+        &mut highlighter,
+        &source,
+        &changed_ranges,
+    );
+
+    // Editing the second line doesn't change either of the injections.
+    let position = source.find('1').unwrap();
+    session.edit(&edit_source(&mut source, position, 1, "2345"));
+    let changed_ranges = session
+        .update(
+            &mut highlighter,
+            source.as_bytes(),
+            None,
+            test_language_for_injection_string,
+        )
+        .unwrap()
+        .to_vec();
+    let second_line = source.find("const c").unwrap()..source.find("\nconst d").unwrap();
+    assert!(changed_ranges
+        .iter()
+        .any(|range| range.start <= position && range.end >= position + 4));
+    assert!(changed_ranges
+        .iter()
+        .all(|range| second_line.start <= range.start && range.end <= second_line.end));
+    assert_session_highlights(
+        &session,
+        &JS_HIGHLIGHT,
+        &mut highlighter,
+        &source,
+        &changed_ranges,
+    );
+
+    // Removing a template tag removes its injection.
+    let position = source.find("html").unwrap();
+    session.edit(&edit_source(&mut source, position, 5, ""));
+    let changed_ranges = session
+        .update(
+            &mut highlighter,
+            source.as_bytes(),
+            None,
+            test_language_for_injection_string,
+        )
+        .unwrap()
+        .to_vec();
+    let template = position..source.find(';').unwrap();
+    assert!(changed_ranges
+        .iter()
+        .any(|range| range.start <= template.start && range.end >= template.end));
+    assert!(changed_ranges
+        .iter()
+        .all(|range| range.end < source.find("const c").unwrap()));
+    assert_session_highlights(
+        &session,
+        &JS_HIGHLIGHT,
+        &mut highlighter,
+        &source,
+        &changed_ranges,
+    );
+
+    // Adding the template tag back adds the injection again.
+    session.edit(&edit_source(&mut source, position, 0, "html "));
+    let changed_ranges = session
+        .update(
+            &mut highlighter,
+            source.as_bytes(),
+            None,
+            test_language_for_injection_string,
+        )
+        .unwrap()
+        .to_vec();
+    assert!(changed_ranges
+        .iter()
+        .all(|range| range.end < source.find("const c").unwrap()));
+    assert_session_highlights(
+        &session,
+        &JS_HIGHLIGHT,
+        &mut highlighter,
+        &source,
+        &changed_ranges,
+    );
+}
+
+#[test]
+fn test_highlighting_with_session_and_combined_injections() {
+    let mut source = "<div><% foo() %></div><script> bar() </script><% baz() %>".to_string();
+
+    let mut highlighter = Highlighter::new();
+    let mut session = HighlightSession::new(&EJS_HIGHLIGHT);
+    let changed_ranges = session
+        .update(
+            &mut highlighter,
+            source.as_bytes(),
+            None,
+            test_language_for_injection_string,
+        )
+        .unwrap()
+        .to_vec();
+    assert_eq!(changed_ranges, [0..source.len()]);
+    assert_session_highlights(
+        &session,
+        &EJS_HIGHLIGHT,
+        &mut highlighter,
+        &source,
+        &changed_ranges,
+    );
+
+    // Updating without any edits keeps all of the layers, including the combined
+    // injections of the HTML and of the embedded code.
+    let changed_ranges = session
+        .update(
+            &mut highlighter,
+            source.as_bytes(),
+            None,
+            test_language_for_injection_string,
+        )
+        .unwrap()
+        .to_vec();
+    assert!(changed_ranges.is_empty());
+    assert_session_highlights(
+        &session,
+        &EJS_HIGHLIGHT,
+        &mut highlighter,
+        &source,
+        &[0..source.len()],
+    );
+
+    // Editing the embedded code updates the combined injection that contains it.
+    let position = source.find("foo").unwrap();
+    session.edit(&edit_source(&mut source, position, 3, "qux"));
+    let changed_ranges = session
+        .update(
+            &mut highlighter,
+            source.as_bytes(),
+            None,
+            test_language_for_injection_string,
+        )
+        .unwrap()
+        .to_vec();
+    assert!(changed_ranges
+        .iter()
+        .any(|range| range.start <= position && range.end >= position + 3));
+    assert_session_highlights(
+        &session,
+        &EJS_HIGHLIGHT,
+        &mut highlighter,
+        &source,
+        &changed_ranges,
+    );
+
+    let changed_ranges = session
+        .update(
+            &mut highlighter,
+            source.as_bytes(),
+            None,
+            test_language_for_injection_string,
+        )
+        .unwrap()
+        .to_vec();
+    assert!(changed_ranges.is_empty());
+    assert_session_highlights(
+        &session,
+        &EJS_HIGHLIGHT,
+        &mut highlighter,
+        &source,
+        &[0..source.len()],
+    );
+}
+
+#[test]
+fn test_highlighting_with_precompiled_configuration() {
+    let source = [
+        "/**",
+        " * @param {string} a",
+        " */",
+        "function f(a) {",
+        "  const b = html `<div>${a}</div>`;",
+        "  return b + c;",
+        "}",
+    ]
+    .join("\n");
+
+    let data = JS_HIGHLIGHT.serialize();
+    let config = HighlightConfiguration::deserialize(get_language("javascript"), &data).unwrap();
+    assert_eq!(config.serialize(), data);
+    assert_eq!(config.names(), JS_HIGHLIGHT.names());
+    assert_eq!(
+        to_html(&source, &config).unwrap(),
+        to_html(&source, &JS_HIGHLIGHT).unwrap(),
+    );
+
+    assert!(HighlightConfiguration::deserialize(get_language("javascript"), &data[1..]).is_none());
+    assert!(HighlightConfiguration::deserialize(get_language("rust"), &data).is_none());
+}
+
 #[test]
 fn test_decode_utf8_lossy() {
     use tree_sitter::LossyUtf8;
@@ -687,6 +1080,105 @@ fn c_string(s: &str) -> CString {
     CString::new(s.as_bytes().to_vec()).unwrap()
 }
 
+// Create a highlighter for HTML and JavaScript via the C API.
+fn new_c_highlighter() -> *mut c::TSHighlighter {
+    let highlights = [
+        "class=tag\0",
+        "class=function\0",
+        "class=string\0",
+        "class=keyword\0",
+    ];
+    let highlight_names = highlights
+        .iter()
+        .map(|h| h["class=".len()..].as_ptr().cast::<c_char>())
+        .collect::<Vec<_>>();
+    let highlight_attrs = highlights
+        .iter()
+        .map(|h| h.as_bytes().as_ptr().cast::<c_char>())
+        .collect::<Vec<_>>();
+    let highlighter = unsafe {
+        c::ts_highlighter_new(
+            std::ptr::addr_of!(highlight_names[0]),
+            std::ptr::addr_of!(highlight_attrs[0]),
+            highlights.len() as u32,
+        )
+    };
+
+    let js_scope = c_string("source.js");
+    let js_injection_regex = c_string("^javascript");
+    let language = get_language("javascript");
+    let lang_name = c_string("javascript");
+    let queries = get_language_queries_path("javascript");
+    let highlights_query = fs::read_to_string(queries.join("highlights.scm")).unwrap();
+    let injections_query = fs::read_to_string(queries.join("injections.scm")).unwrap();
+    let locals_query = fs::read_to_string(queries.join("locals.scm")).unwrap();
+    unsafe {
+        c::ts_highlighter_add_language(
+            highlighter,
+            lang_name.as_ptr(),
+            js_scope.as_ptr(),
+            js_injection_regex.as_ptr(),
+            language,
+            highlights_query.as_ptr().cast::<c_char>(),
+            injections_query.as_ptr().cast::<c_char>(),
+            locals_query.as_ptr().cast::<c_char>(),
+            highlights_query.len() as u32,
+            injections_query.len() as u32,
+            locals_query.len() as u32,
+        );
+    }
+
+    let html_scope = c_string("text.html.basic");
+    let html_injection_regex = c_string("^html");
+    let language = get_language("html");
+    let lang_name = c_string("html");
+    let queries = get_language_queries_path("html");
+    let highlights_query = fs::read_to_string(queries.join("highlights.scm")).unwrap();
+    let injections_query = fs::read_to_string(queries.join("injections.scm")).unwrap();
+    unsafe {
+        c::ts_highlighter_add_language(
+            highlighter,
+            lang_name.as_ptr(),
+            html_scope.as_ptr(),
+            html_injection_regex.as_ptr(),
+            language,
+            highlights_query.as_ptr().cast::<c_char>(),
+            injections_query.as_ptr().cast::<c_char>(),
+            ptr::null(),
+            highlights_query.len() as u32,
+            injections_query.len() as u32,
+            0,
+        );
+    }
+
+    highlighter
+}
+
+fn c_highlight_buffer_lines(buffer: *const c::TSHighlightBuffer) -> Vec<String> {
+    let output_bytes = unsafe { c::ts_highlight_buffer_content(buffer) };
+    let output_line_offsets = unsafe { c::ts_highlight_buffer_line_offsets(buffer) };
+    let output_len = unsafe { c::ts_highlight_buffer_len(buffer) };
+    let output_line_count = unsafe { c::ts_highlight_buffer_line_count(buffer) };
+
+    let output_bytes = unsafe { slice::from_raw_parts(output_bytes, output_len as usize) };
+    let output_line_offsets =
+        unsafe { slice::from_raw_parts(output_line_offsets, output_line_count as usize) };
+
+    let mut lines = Vec::new();
+    for i in 0..(output_line_count as usize) {
+        let line_start = output_line_offsets[i] as usize;
+        let line_end = output_line_offsets
+            .get(i + 1)
+            .map_or(output_bytes.len(), |x| *x as usize);
+        lines.push(
+            str::from_utf8(&output_bytes[line_start..line_end])
+                .unwrap()
+                .to_string(),
+        );
+    }
+    lines
+}
+
 fn test_language_for_injection_string<'a>(string: &str) -> Option<&'a HighlightConfiguration> {
     match string {
         "javascript" => Some(&JS_HIGHLIGHT),
@@ -697,6 +1189,96 @@ fn test_language_for_injection_string<'a>(string: &str) -> Option<&'a HighlightC
     }
 }
 
+fn edit_source(
+    source: &mut String,
+    position: usize,
+    deleted_length: usize,
+    text: &str,
+) -> InputEdit {
+    let position_for_offset = |source: &str, offset: usize| {
+        let row = source[..offset].matches('\n').count();
+        let line_start = source[..offset].rfind('\n').map_or(0, |i| i + 1);
+        Point::new(row, offset - line_start)
+    };
+    let start_position = position_for_offset(source, position);
+    let old_end_position = position_for_offset(source, position + deleted_length);
+    source.replace_range(position..position + deleted_length, text);
+    InputEdit {
+        start_byte: position,
+        old_end_byte: position + deleted_length,
+        new_end_byte: position + text.len(),
+        start_position,
+        old_end_position,
+        new_end_position: position_for_offset(source, position + text.len()),
+    }
+}
+
+// Highlight the given ranges using the session, and check that each byte has the same
+// highlights as it does when the whole document is highlighted from scratch.
+fn assert_session_highlights(
+    session: &HighlightSession,
+    config: &HighlightConfiguration,
+    highlighter: &mut Highlighter,
+    source: &str,
+    ranges: &[ops::Range<usize>],
+) {
+    let mut fresh_highlighter = Highlighter::new();
+    let expected = highlights_by_byte(
+        fresh_highlighter
+            .highlight(
+                config,
+                source.as_bytes(),
+                None,
+                &test_language_for_injection_string,
+            )
+            .unwrap(),
+        source.len(),
+    );
+    let actual = highlights_by_byte(
+        session.highlight(highlighter, source.as_bytes(), 0..source.len(), None),
+        source.len(),
+    );
+    assert_eq!(actual, expected);
+
+    for range in ranges {
+        let actual = highlights_by_byte(
+            session.highlight(highlighter, source.as_bytes(), range.clone(), None),
+            source.len(),
+        );
+        for (i, highlights) in actual.iter().enumerate() {
+            if range.contains(&i) {
+                assert_eq!(highlights, &expected[i], "byte {i} in range {range:?}");
+            } else {
+                assert_eq!(highlights, &None, "byte {i} outside range {range:?}");
+            }
+        }
+    }
+}
+
+fn highlights_by_byte(
+    events: impl Iterator<Item = Result<HighlightEvent, Error>>,
+    len: usize,
+) -> Vec<Option<Vec<usize>>> {
+    let mut result = vec![None; len];
+    let mut highlights = Vec::new();
+    for event in events {
+        match event.unwrap() {
+            HighlightEvent::HighlightStart(s) => highlights.push(s.0),
+            HighlightEvent::HighlightEnd => {
+                highlights.pop().unwrap();
+            }
+            HighlightEvent::Source { start, end } => {
+                for entry in &mut result[start..end] {
+                    assert_eq!(entry, &None);
+                    *entry = Some(highlights.clone());
+                }
+            }
+        }
+    }
+    assert!(highlights.is_empty());
+    result
+}
+
 fn to_html<'a>(
     src: &'a str,
     language_config: &'a HighlightConfiguration,
@@ -1,4 +1,6 @@
-use tree_sitter::{Node, Parser, Point, Tree};
+use std::num::NonZeroUsize;
+
+use tree_sitter::{Node, ParallelVisitor, Parser, Point, Tree};
 
 use super::helpers::{
     edits::get_random_edit,
@@ -219,6 +221,38 @@ fn test_node_children() {
     );
 }
 
+#[test]
+fn test_node_child_range() {
+    let mut parser = Parser::new();
+    parser.set_language(&get_language("json")).unwrap();
+    let source = format!("[{}]", vec!["1"; 5000].join(", "));
+    let tree = parser.parse(&source, None).unwrap();
+    let array_node = tree.root_node().child(0).unwrap();
+    assert_eq!(array_node.child_count(), 2 * 5000 + 1);
+
+    let children = array_node.child_range(0..array_node.child_count());
+    assert_eq!(children.len(), array_node.child_count());
+    for (i, child) in children.iter().enumerate() {
+        assert_eq!(Some(*child), array_node.child(i), "index {i}");
+    }
+
+    let named_children = array_node.named_child_range(0..array_node.named_child_count());
+    assert_eq!(named_children.len(), 5000);
+    for (i, child) in named_children.iter().enumerate() {
+        assert_eq!(Some(*child), array_node.named_child(i), "index {i}");
+    }
+
+    for start in (0..array_node.child_count()).step_by(997) {
+        assert_eq!(
+            array_node.child_range(start..start + 3),
+            children[start..(start + 3).min(children.len())]
+        );
+    }
+    assert_eq!(array_node.named_child_range(4998..6000).len(), 2);
+    assert!(array_node.child_range(20000..20001).is_empty());
+    assert!(array_node.child_range(5..2).is_empty());
+}
+
 #[test]
 fn test_node_children_by_field_name() {
     let mut parser = Parser::new();
@@ -341,6 +375,34 @@ fn test_node_child_by_field_name_with_extra_hidden_children() {
     );
 }
 
+#[test]
+fn test_node_field_children() {
+    let mut parser = Parser::new();
+    let language = get_language("python");
+    parser.set_language(&language).unwrap();
+    let tree = parser
+        .parse(
+            "def f(a, b=1, *c):\n  while a:\n    pass\n  return a if b else c\n",
+            None,
+        )
+        .unwrap();
+
+    for node in get_all_nodes(&tree) {
+        let field_children = node.field_children();
+        assert_eq!(field_children.len(), language.field_count() + 1);
+        assert_eq!(field_children[0], None);
+        for (field_id, child) in field_children.iter().enumerate() {
+            assert_eq!(
+                *child,
+                node.child_by_field_id(field_id as u16),
+                "node {} field {:?}",
+                node.kind(),
+                language.field_name_for_id(field_id as u16),
+            );
+        }
+    }
+}
+
 #[test]
 fn test_node_named_child() {
     let tree = parse_json_example();
@@ -471,6 +533,137 @@ fn test_node_descendant_count() {
     }
 }
 
+#[test]
+fn test_node_flatten() {
+    let tree = parse_json_example();
+    let root = tree.root_node();
+    let all_nodes = get_all_nodes(&tree);
+
+    let flat = root.flatten(false, None);
+    assert_eq!(flat.len(), all_nodes.len());
+    let mut cursor = root.walk();
+    for (i, (entry, node)) in flat.iter().zip(all_nodes.iter()).enumerate() {
+        cursor.goto_descendant(i);
+        assert_eq!(entry.field_id(), cursor.field_id(), "index {i}");
+        assert_eq!(entry.kind_id(), node.kind_id(), "index {i}");
+        assert_eq!(entry.byte_range(), node.byte_range(), "index {i}");
+        assert_eq!(entry.start_position(), node.start_position(), "index {i}");
+        assert_eq!(entry.end_position(), node.end_position(), "index {i}");
+        assert_eq!(entry.is_named(), node.is_named(), "index {i}");
+        assert_eq!(
+            entry.descendant_count() + 1,
+            node.descendant_count(),
+            "index {i}"
+        );
+        assert_eq!(
+            entry.parent_index().map(|p| all_nodes[p]),
+            node.parent(),
+            "index {i}"
+        );
+    }
+
+    let named = root.flatten(true, None);
+    let named_nodes = all_nodes
+        .iter()
+        .filter(|node| node.is_named())
+        .collect::<Vec<_>>();
+    assert_eq!(named.len(), named_nodes.len());
+    for (entry, node) in named.iter().zip(named_nodes) {
+        assert_eq!(entry.kind_id(), node.kind_id());
+        assert_eq!(entry.byte_range(), node.byte_range());
+    }
+
+    let shallow = root.flatten(false, Some(1));
+    assert_eq!(shallow.len(), 2);
+    assert_eq!(shallow[0].descendant_count(), 1);
+    assert_eq!(shallow[1].kind_id(), root.child(0).unwrap().kind_id());
+    assert_eq!(shallow[1].parent_index(), Some(0));
+    assert_eq!(shallow[1].descendant_count(), 0);
+}
+
+#[test]
+fn test_node_partition() {
+    let mut parser = Parser::new();
+    parser.set_language(&get_language("javascript")).unwrap();
+    let source = "function f(a) { return [a, a + 1, g(a)]; }\n".repeat(50);
+    let tree = parser.parse(&source, None).unwrap();
+    let root = tree.root_node();
+    let all_nodes = get_all_nodes(&tree);
+
+    for max_unit_size in [0, 1, 5, 40, all_nodes.len()] {
+        let units = root.partition(max_unit_size);
+        let mut covered = 0;
+        for unit in &units {
+            assert!(unit.descendant_count() <= max_unit_size.max(1));
+            if let Some(parent) = unit.parent() {
+                assert!(parent.descendant_count() > max_unit_size.max(1));
+            }
+            covered += unit.descendant_count();
+        }
+
+        // The units appear in document order, and together with their
+        // ancestors they cover every node exactly once.
+        let positions = units
+            .iter()
+            .map(|unit| all_nodes.iter().position(|node| node == unit).unwrap())
+            .collect::<Vec<_>>();
+        assert!(positions.windows(2).all(|w| w[0] < w[1]));
+        let ancestor_count = all_nodes
+            .iter()
+            .filter(|node| node.descendant_count() > max_unit_size.max(1))
+            .count();
+        assert_eq!(covered + ancestor_count, all_nodes.len());
+    }
+
+    assert_eq!(root.partition(all_nodes.len()), vec![root]);
+}
+
+#[test]
+fn test_node_visit_parallel() {
+    struct EventRecorder;
+
+    impl<'tree> ParallelVisitor<'tree> for EventRecorder {
+        type Output = Vec<(bool, usize)>;
+
+        fn enter(&self, node: Node<'tree>, output: &mut Self::Output) {
+            output.push((true, node.id()));
+        }
+
+        fn leave(&self, node: Node<'tree>, output: &mut Self::Output) {
+            output.push((false, node.id()));
+        }
+
+        fn reduce(&self, mut left: Self::Output, right: Self::Output) -> Self::Output {
+            left.extend(right);
+            left
+        }
+    }
+
+    let mut parser = Parser::new();
+    parser.set_language(&get_language("javascript")).unwrap();
+    let source = "function f(a) { return [a, a + 1, g(a)]; }\n".repeat(200);
+    let tree = parser.parse(&source, None).unwrap();
+
+    fn record(node: Node, events: &mut Vec<(bool, usize)>) {
+        events.push((true, node.id()));
+        for child in node.children(&mut node.walk()) {
+            record(child, events);
+        }
+        events.push((false, node.id()));
+    }
+
+    let mut expected = Vec::new();
+    record(tree.root_node(), &mut expected);
+
+    for thread_count in [1, 2, 8] {
+        let thread_count = NonZeroUsize::new(thread_count).unwrap();
+        let events = tree
+            .root_node()
+            .visit_parallel(&EventRecorder, thread_count);
+        assert_eq!(events, expected);
+    }
+}
+
 #[test]
 fn test_descendant_count_single_node_tree() {
     let mut parser = Parser::new();
@@ -3,7 +3,7 @@ use std::{
     thread, time,
 };
 
-use tree_sitter::{IncludedRangesError, InputEdit, LogType, Parser, Point, Range};
+use tree_sitter::{IncludedRangesError, InputEdit, LogType, Parser, ParserPool, Point, Range};
 use tree_sitter_proc_macro::retry;
 
 use super::helpers::{
@@ -153,6 +153,71 @@ fn test_parsing_with_custom_utf8_input() {
     assert_eq!(root.child(0).unwrap().kind(), "function_item");
 }
 
+#[test]
+fn test_parsing_with_segments() {
+    let mut parser = Parser::new();
+    parser.set_language(&get_language("rust")).unwrap();
+
+    let source_code = "fn main() {\n    println!(\"héllo → wörld\");\n}\n";
+    let expected_tree = parser.parse(source_code, None).unwrap();
+
+    // Split the text into segments of various lengths, including some that
+    // end in the middle of a multi-byte character.
+    for segment_len in 1..8 {
+        let mut segments = source_code
+            .as_bytes()
+            .chunks(segment_len)
+            .collect::<Vec<_>>();
+        segments.insert(1, &[]);
+
+        let tree = parser.parse_segments(&segments, None).unwrap();
+        assert_eq!(
+            tree.root_node().to_sexp(),
+            expected_tree.root_node().to_sexp()
+        );
+        assert!(!tree.root_node().has_error());
+
+        let mut cursor = tree.walk();
+        let mut expected_cursor = expected_tree.walk();
+        while cursor.goto_next_descendant() {
+            assert!(expected_cursor.goto_next_descendant());
+            assert_eq!(
+                cursor.node().byte_range(),
+                expected_cursor.node().byte_range()
+            );
+            assert_eq!(cursor.node().range(), expected_cursor.node().range());
+        }
+
+        // Reparse after an edit, using the old tree.
+        let mut edited_tree = tree.clone();
+        let edited_code = source_code.replace("main", "mainly");
+        edited_tree.edit(&InputEdit {
+            start_byte: 7,
+            old_end_byte: 7,
+            new_end_byte: 9,
+            start_position: Point::new(0, 7),
+            old_end_position: Point::new(0, 7),
+            new_end_position: Point::new(0, 9),
+        });
+        let segments = edited_code
+            .as_bytes()
+            .chunks(segment_len)
+            .collect::<Vec<_>>();
+        let new_tree = parser
+            .parse_segments(&segments, Some(&edited_tree))
+            .unwrap();
+        let function_name = new_tree.root_node().child(0).unwrap().child(1).unwrap();
+        assert_eq!(
+            function_name.utf8_text(edited_code.as_bytes()).unwrap(),
+            "mainly"
+        );
+    }
+
+    let empty_segments: &[&[u8]] = &[];
+    let tree = parser.parse_segments(empty_segments, None).unwrap();
+    assert_eq!(tree.root_node().to_sexp(), "(source_file)");
+}
+
 #[test]
 fn test_parsing_with_custom_utf16_input() {
     let mut parser = Parser::new();
@@ -192,6 +257,51 @@ fn test_parsing_with_custom_utf16_input() {
     assert_eq!(root.child(0).unwrap().kind(), "function_item");
 }
 
+#[test]
+fn test_parsing_latin1_and_utf16_be_input() {
+    let mut parser = Parser::new();
+    parser.set_language(&get_language("rust")).unwrap();
+
+    // In Latin-1, each character is a single byte, so the byte offsets of
+    // the nodes match the character offsets.
+    let source_code = b"// caf\xe9\nconst A: &str = \"na\xefve \xbfs\xed?\";\n";
+    let tree = parser.parse_latin1(source_code, None).unwrap();
+    let root = tree.root_node();
+    assert!(!root.has_error());
+    let string_node = root
+        .descendant_for_byte_range(source_code.len() - 14, source_code.len() - 14)
+        .unwrap()
+        .parent()
+        .unwrap();
+    assert_eq!(string_node.kind(), "string_literal");
+    assert_eq!(
+        &source_code[string_node.byte_range()],
+        b"\"na\xefve \xbfs\xed?\""
+    );
+
+    // Big-endian UTF16 produces the same tree as little-endian UTF16.
+    let source_code = "// café\nconst A: &str = \"naïve 🦀\";\n";
+    let utf16_code = source_code.encode_utf16().collect::<Vec<_>>();
+    let utf16_be_code = utf16_code
+        .iter()
+        .flat_map(|unit| unit.to_be_bytes())
+        .collect::<Vec<_>>();
+    let expected_tree = parser.parse_utf16(&utf16_code, None).unwrap();
+    let tree = parser.parse_utf16_be(&utf16_be_code, None).unwrap();
+    assert!(!tree.root_node().has_error());
+    assert_eq!(
+        tree.root_node().to_sexp(),
+        expected_tree.root_node().to_sexp()
+    );
+
+    let mut cursor = tree.walk();
+    let mut expected_cursor = expected_tree.walk();
+    while cursor.goto_next_descendant() {
+        assert!(expected_cursor.goto_next_descendant());
+        assert_eq!(cursor.node().range(), expected_cursor.node().range());
+    }
+}
+
 #[test]
 fn test_parsing_with_callback_returning_owned_strings() {
     let mut parser = Parser::new();
@@ -594,6 +704,63 @@ fn test_parsing_on_multiple_threads() {
     assert_eq!(child_count_differences, &[1, 2, 3, 4]);
 }
 
+#[test]
+fn test_parser_pool() {
+    let rust = get_language("rust");
+    let json = get_language("json");
+    let pool = ParserPool::new(3);
+
+    // Parsers are created on demand, and returned to the pool when dropped.
+    pool.reserve(&rust, 1).unwrap();
+    assert_eq!(pool.idle_count(), 1);
+    {
+        let mut rust_parser = pool.get(&rust).unwrap();
+        let mut json_parser = pool.get(&json).unwrap();
+        assert_eq!(pool.idle_count(), 0);
+        assert_eq!(rust_parser.language(), Some(rust.clone()));
+        assert_eq!(json_parser.language(), Some(json.clone()));
+
+        // Any configuration is undone before a parser is reused.
+        rust_parser.set_timeout_micros(1);
+        rust_parser
+            .set_included_ranges(&[simple_range(5, 10)])
+            .unwrap();
+        let tree = json_parser.parse("[1, 2", None).unwrap();
+        assert!(tree.root_node().has_error());
+    }
+    assert_eq!(pool.idle_count(), 2);
+    {
+        let rust_parser = pool.get(&rust).unwrap();
+        assert_eq!(rust_parser.timeout_micros(), 0);
+        assert_eq!(
+            rust_parser.included_ranges(),
+            Parser::new().included_ranges()
+        );
+        let json_parser = pool.get(&json).unwrap();
+        assert_eq!(pool.idle_count(), 0);
+        drop(json_parser.into_inner());
+    }
+    assert_eq!(pool.idle_count(), 1);
+
+    // Parsers that are returned to a full pool are deleted.
+    let this_file_source = include_str!("parser_test.rs");
+    thread::scope(|scope| {
+        for _ in 0..8 {
+            scope.spawn(|| {
+                for _ in 0..4 {
+                    let mut parser = pool.get(&rust).unwrap();
+                    let tree = parser.parse(this_file_source, None).unwrap();
+                    assert!(!tree.root_node().has_error());
+                }
+            });
+        }
+    });
+    assert!(pool.idle_count() <= 3);
+
+    pool.clear();
+    assert_eq!(pool.idle_count(), 0);
+}
+
 #[test]
 fn test_parsing_cancelled_by_another_thread() {
     let cancellation_flag = std::sync::Arc::new(AtomicUsize::new(0));
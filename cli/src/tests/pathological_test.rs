@@ -1,6 +1,12 @@
-use tree_sitter::Parser;
+use std::{env, fs};
 
-use super::helpers::{allocations, fixtures::get_language};
+use serde::{Deserialize, Serialize};
+use tree_sitter::{Language, LogType, Node, Parser, Query, QueryCursor, Tree};
+
+use super::helpers::{
+    allocations,
+    fixtures::{fixtures_dir, get_language, get_language_queries_path},
+};
 
 #[test]
 fn test_pathological_example_1() {
@@ -13,3 +19,123 @@ fn test_pathological_example_1() {
         parser.parse(source, None).unwrap();
     });
 }
+
+/// The cost ceilings of an input in `test/fixtures/pathological_inputs`, as recorded by the
+/// fuzzer's cost mode, or by this test when `TREE_SITTER_RECORD_COST_CEILINGS` is set.
+/// Each ceiling is 50% above the measured cost.
+#[derive(Serialize, Deserialize)]
+struct CostCeiling {
+    max_parse_operations: usize,
+    #[serde(skip_serializing_if = "Option::is_none")]
+    max_query_states: Option<u32>,
+}
+
+#[test]
+fn test_pathological_inputs() {
+    let mut input_count = 0;
+    for language_dir in fs::read_dir(fixtures_dir().join("pathological_inputs")).unwrap() {
+        let language_dir = language_dir.unwrap().path();
+        let language_name = language_dir.file_name().unwrap().to_str().unwrap();
+        let language = get_language(language_name);
+        let query =
+            fs::read_to_string(get_language_queries_path(language_name).join("highlights.scm"))
+                .ok()
+                .map(|source| Query::new(&language, &source).unwrap());
+
+        for entry in fs::read_dir(&language_dir).unwrap() {
+            let input_path = entry.unwrap().path();
+            if input_path
+                .extension()
+                .is_some_and(|extension| extension == "json")
+            {
+                continue;
+            }
+            let mut ceiling_path = input_path.clone().into_os_string();
+            ceiling_path.push(".json");
+            let input = fs::read(&input_path).unwrap();
+            input_count += 1;
+
+            let (parse_operations, tree) = count_parse_operations(&language, &input);
+
+            // Ceilings are only ever written from measured costs, never by hand.
+            if env::var("TREE_SITTER_RECORD_COST_CEILINGS").is_ok() {
+                let ceiling = CostCeiling {
+                    max_parse_operations: parse_operations * 3 / 2,
+                    max_query_states: query.as_ref().map(|query| {
+                        count_peak_query_states(query, tree.root_node(), &input) * 3 / 2
+                    }),
+                };
+                let json = serde_json::to_string_pretty(&ceiling).unwrap();
+                fs::write(&ceiling_path, json + "\n").unwrap();
+                continue;
+            }
+
+            let ceiling: CostCeiling =
+                serde_json::from_str(&fs::read_to_string(&ceiling_path).unwrap_or_else(|_| {
+                    panic!(
+                        "No cost ceiling was recorded for {input_path:?}. \
+                         Run this test with TREE_SITTER_RECORD_COST_CEILINGS=1 to record one."
+                    )
+                }))
+                .unwrap();
+            assert!(
+                parse_operations <= ceiling.max_parse_operations,
+                "Parsing {input_path:?} took {parse_operations} operations, more than the maximum of {}",
+                ceiling.max_parse_operations,
+            );
+
+            if let (Some(query), Some(max_query_states)) = (&query, ceiling.max_query_states) {
+                let query_states = count_peak_query_states(query, tree.root_node(), &input);
+                assert!(
+                    query_states <= max_query_states,
+                    "Querying {input_path:?} needed {query_states} states, more than the maximum of {max_query_states}",
+                );
+            }
+        }
+    }
+    assert_ne!(input_count, 0, "No pathological inputs were found");
+}
+
+// Count the parse actions that are logged, the same way the fuzzer does.
+fn count_parse_operations(language: &Language, input: &[u8]) -> (usize, Tree) {
+    let mut operation_count = 0;
+    let mut parser = Parser::new();
+    parser.set_language(language).unwrap();
+    parser.set_logger(Some(Box::new(|log_type, _| {
+        if log_type == LogType::Parse {
+            operation_count += 1;
+        }
+    })));
+    let tree = parser.parse(input, None).unwrap();
+    drop(parser);
+    (operation_count, tree)
+}
+
+// Find the largest number of matches that are in progress at once, as the smallest match
+// limit that isn't exceeded. The limit is doubled until it isn't exceeded, and then binary
+// searched, the same way the fuzzer does. Each attempt uses a new cursor, because a cursor
+// keeps the capture lists that it allocated under a higher limit.
+fn count_peak_query_states(query: &Query, node: Node, text: &[u8]) -> u32 {
+    let exceeds_match_limit = |limit| {
+        let mut cursor = QueryCursor::new();
+        cursor.set_match_limit(limit);
+        cursor.matches(query, node, text).for_each(drop);
+        cursor.did_exceed_match_limit()
+    };
+
+    let max_limit = u32::from(u16::MAX);
+    let mut high = 1;
+    while high < max_limit && exceeds_match_limit(high) {
+        high = (high * 2).min(max_limit);
+    }
+    let mut low = high / 2;
+    while high - low > 1 {
+        let mid = low + (high - low) / 2;
+        if exceeds_match_limit(mid) {
+            low = mid;
+        } else {
+            high = mid;
+        }
+    }
+    high
+}
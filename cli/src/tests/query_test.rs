@@ -3839,6 +3839,108 @@ fn test_query_disable_pattern() {
     });
 }
 
+#[test]
+fn test_query_serialization() {
+    allocations::record(|| {
+        let language = get_language("javascript");
+        let query_source = r#"
+            (function_declaration
+                name: (identifier) @name)
+            ((identifier) @constant
+                (#match? @constant "^[A-Z]+$")
+                (#set! priority 2)
+                (#custom? @constant "value"))
+            (class_declaration
+                name: (identifier) @name
+                body: (class_body (method_definition)* @method))
+            (export_statement
+                !decorator
+                !source
+                (_) @exported)
+        "#;
+        let mut query = Query::new(&language, query_source).unwrap();
+        query.disable_pattern(0);
+
+        let data = query.serialize();
+        let deserialized = Query::deserialize(&language, &data).unwrap();
+        assert_eq!(deserialized.serialize(), data);
+        assert_eq!(deserialized.pattern_count(), query.pattern_count());
+        assert_eq!(deserialized.capture_names(), query.capture_names());
+        assert_eq!(
+            deserialized.capture_quantifiers(2),
+            query.capture_quantifiers(2)
+        );
+        assert_eq!(
+            deserialized.general_predicates(1),
+            query.general_predicates(1)
+        );
+        assert_eq!(
+            deserialized.property_settings(1),
+            query.property_settings(1)
+        );
+
+        let source = "
+            function AB() { return cd(EF); }
+            export class G { a() {} b() {} }
+        "
+        .unindent();
+        let mut parser = Parser::new();
+        parser.set_language(&language).unwrap();
+        let tree = parser.parse(&source, None).unwrap();
+        let mut cursor = QueryCursor::new();
+        let expected = collect_matches(
+            cursor.matches(&query, tree.root_node(), source.as_bytes()),
+            &query,
+            &source,
+        );
+        let matches = collect_matches(
+            cursor.matches(&deserialized, tree.root_node(), source.as_bytes()),
+            &deserialized,
+            &source,
+        );
+        assert_eq!(matches, expected);
+
+        // The data only depends on the query, not on the contents of padding bytes.
+        let mut recompiled = Query::new(&language, query_source).unwrap();
+        recompiled.disable_pattern(0);
+        assert_eq!(recompiled.serialize(), data);
+
+        // Truncated, extended, or corrupted data is rejected.
+        for length in 0..data.len() {
+            assert!(Query::deserialize(&language, &data[..length]).is_none());
+        }
+        let mut extended = data.clone();
+        extended.push(0);
+        assert!(Query::deserialize(&language, &extended).is_none());
+        let mut corrupted = data.clone();
+        corrupted[0] ^= 1;
+        assert!(Query::deserialize(&language, &corrupted).is_none());
+
+        // Every index in the data is checked, so data with any byte changed is either
+        // rejected or produces a query that can be executed safely.
+        for i in 0..data.len() {
+            for mask in [0x01, 0x80, 0xff] {
+                let mut corrupted = data.clone();
+                corrupted[i] ^= mask;
+                if let Some(query) = Query::deserialize(&language, &corrupted) {
+                    for m in cursor.matches(&query, tree.root_node(), source.as_bytes()) {
+                        for capture in m.captures {
+                            assert!((capture.index as usize) < query.capture_names().len());
+                        }
+                    }
+                    let captures = cursor.captures(&query, tree.root_node(), source.as_bytes());
+                    for (m, _) in captures {
+                        assert!(m.pattern_index < query.pattern_count());
+                    }
+                }
+            }
+        }
+
+        // The data is only valid for the language that the query was created for.
+        assert!(Query::deserialize(&get_language("python"), &data).is_none());
+    });
+}
+
 #[test]
 fn test_query_alternative_predicate_prefix() {
     allocations::record(|| {
@@ -1,15 +1,25 @@
 use std::{
     ffi::{CStr, CString},
-    fs, ptr, slice, str,
+    fs,
+    io::{self, Cursor},
+    num::NonZeroUsize,
+    ptr, slice, str,
 };
 
 use tree_sitter::Point;
-use tree_sitter_tags::{c_lib as c, Error, TagsConfiguration, TagsContext};
+use tree_sitter_tags::{
+    c_lib as c,
+    index::{IndexedTag, TagsIndex, TagsIndexBuilder},
+    Error, Tag, TagsConfiguration, TagsContext,
+};
 
 use super::helpers::{
     allocations,
+    edits::get_random_edit,
     fixtures::{get_language, get_language_queries_path},
+    random::Rand,
 };
+use crate::parse::{perform_edit, Edit};
 
 const PYTHON_TAG_QUERY: &str = r#"
 (
@@ -432,6 +442,191 @@ fn test_tags_via_c_api() {
     });
 }
 
+#[test]
+fn test_tags_index() {
+    let language = get_language("javascript");
+    let tags_config = TagsConfiguration::new(language, JS_TAG_QUERY, "").unwrap();
+    let dir = tempfile::tempdir().unwrap();
+    let paths = (0..20)
+        .map(|i| {
+            let path = dir.path().join(format!("file{i:02}.js"));
+            let source = format!(
+                "function f{i}() {{ return f{}(); }}\nclass C{i} {{ m() {{}} }}\n",
+                (i + 1) % 20
+            );
+            fs::write(&path, source).unwrap();
+            path
+        })
+        .collect::<Vec<_>>();
+    let files = paths
+        .iter()
+        .map(|path| (path, &tags_config))
+        .collect::<Vec<_>>();
+
+    let mut builder = TagsIndexBuilder::new();
+    let errors = builder.add_files(&files, NonZeroUsize::new(4).unwrap(), None);
+    assert!(errors.is_empty());
+    let mut index_bytes = Vec::new();
+    builder.write(&mut index_bytes).unwrap();
+
+    let mut index = TagsIndex::new(Cursor::new(&index_bytes)).unwrap();
+    assert_eq!(index.file_count(), 20);
+    assert_eq!(
+        index.definitions("f3").unwrap(),
+        &[IndexedTag {
+            path: paths[3].to_string_lossy().to_string(),
+            syntax_type: "function".to_string(),
+            is_definition: true,
+            range: 0..30,
+            name_range: 9..11,
+            span: Point::new(0, 9)..Point::new(0, 11),
+        }]
+    );
+    assert_eq!(
+        index
+            .tags("f3")
+            .unwrap()
+            .iter()
+            .map(|tag| (tag.path.as_str(), tag.syntax_type.as_str()))
+            .collect::<Vec<_>>(),
+        &[
+            (paths[2].to_str().unwrap(), "call"),
+            (paths[3].to_str().unwrap(), "function"),
+        ]
+    );
+    assert_eq!(index.definitions("m").unwrap().len(), 20);
+    assert!(index.definitions("f20").unwrap().is_empty());
+
+    // Replace one file and remove another.
+    fs::write(&paths[3], "function g() {}\n").unwrap();
+    fs::remove_file(&paths[4]).unwrap();
+    let mut builder = TagsIndexBuilder::from_index(&mut index).unwrap();
+    let errors = builder.add_files(&files[3..5], NonZeroUsize::new(4).unwrap(), None);
+    assert_eq!(errors.len(), 1);
+    assert_eq!(errors[0].0, 1);
+    assert_eq!(errors[0].1.kind(), io::ErrorKind::NotFound);
+    let mut index_bytes = Vec::new();
+    builder.write(&mut index_bytes).unwrap();
+
+    let mut index = TagsIndex::new(Cursor::new(&index_bytes)).unwrap();
+    assert_eq!(index.file_count(), 19);
+    assert!(index.definitions("f3").unwrap().is_empty());
+    assert!(index.tags("f4").unwrap().is_empty());
+    assert_eq!(
+        index
+            .definitions("g")
+            .unwrap()
+            .iter()
+            .map(|tag| tag.path.as_str())
+            .collect::<Vec<_>>(),
+        &[paths[3].to_str().unwrap()]
+    );
+}
+
+#[test]
+fn test_tags_incremental_update() {
+    let language = get_language("javascript");
+    let tags_config = TagsConfiguration::new(language, JS_TAG_QUERY, "").unwrap();
+    let mut source = r"
+    // Data about a customer.
+    class Customer {
+        /*
+         * Get the customer's age
+         */
+        getAge() { return age(this.birthday); }
+    }
+
+    // ok
+    class Agent { call() { return héllo(); } }
+
+    function age(date) {
+        return now() - date;
+    }
+    "
+    .as_bytes()
+    .to_vec();
+
+    let mut tag_context = TagsContext::new();
+    let (mut tags, mut tree) = tag_context
+        .generate_tags_and_tree(&tags_config, &source, None)
+        .unwrap();
+
+    // Rename a method, change the comment above a class, and edit a line that
+    // contains several tags.
+    let mut edits = Vec::new();
+    for (text, replacement) in [
+        ("getAge", "getBirthday"),
+        ("// ok", "// An agent."),
+        ("héllo", "hello"),
+    ] {
+        let position = substr_position(&source, text);
+        let edit = Edit {
+            position,
+            deleted_length: text.len(),
+            inserted_text: replacement.as_bytes().to_vec(),
+        };
+        edits.push(perform_edit(&mut tree.clone(), &mut source, &edit).unwrap());
+    }
+    let (new_tags, new_tree) = tag_context
+        .update_tags(&tags_config, &source, &tree, &edits, &tags, None)
+        .unwrap();
+    assert_eq!(
+        new_tags
+            .iter()
+            .map(|t| (substr(&source, &t.name_range), t.docs.as_deref()))
+            .collect::<Vec<_>>(),
+        &[
+            ("Customer", Some("Data about a customer.")),
+            ("getBirthday", Some("Get the customer's age")),
+            ("age", None),
+            ("Agent", Some("An agent.")),
+            ("call", None),
+            ("hello", None),
+            ("age", None),
+            ("now", None),
+        ]
+    );
+    assert_tags_eq(&new_tags, &generate_all_tags(&tags_config, &source));
+    (tags, tree) = (new_tags, new_tree);
+
+    // Random edits produce the same tags as generating them from scratch.
+    let mut rand = Rand::new(0);
+    for _ in 0..20 {
+        let edit = get_random_edit(&mut rand, &source);
+        let edit = perform_edit(&mut tree.clone(), &mut source, &edit).unwrap();
+        let (new_tags, new_tree) = tag_context
+            .update_tags(&tags_config, &source, &tree, &[edit], &tags, None)
+            .unwrap();
+        assert_tags_eq(&new_tags, &generate_all_tags(&tags_config, &source));
+        (tags, tree) = (new_tags, new_tree);
+    }
+}
+
+fn generate_all_tags(config: &TagsConfiguration, source: &[u8]) -> Vec<Tag> {
+    TagsContext::new()
+        .generate_tags(config, source, None)
+        .unwrap()
+        .0
+        .collect::<Result<Vec<_>, _>>()
+        .unwrap()
+}
+
+fn assert_tags_eq(actual: &[Tag], expected: &[Tag]) {
+    let actual = actual.iter().map(|t| format!("{t:?}")).collect::<Vec<_>>();
+    let expected = expected
+        .iter()
+        .map(|t| format!("{t:?}"))
+        .collect::<Vec<_>>();
+    assert_eq!(actual, expected);
+}
+
+fn substr_position(source: &[u8], text: &str) -> usize {
+    source
+        .windows(text.len())
+        .position(|window| window == text.as_bytes())
+        .unwrap()
+}
+
 fn substr<'a>(source: &'a [u8], range: &std::ops::Range<usize>) -> &'a str {
     std::str::from_utf8(&source[range.clone()]).unwrap()
 }
@@ -416,6 +416,118 @@ fn test_tree_cursor_previous_sibling() {
     assert!(!cursor.goto_previous_sibling());
 }
 
+#[test]
+fn test_tree_cursor_next_descendant() {
+    let mut parser = Parser::new();
+    parser.set_language(&get_language("rust")).unwrap();
+
+    let text = "
+        // A comment
+        struct Stuff {
+            a: A,
+            b: Option<B>,
+        }
+
+        fn f(x: &[u8]) -> usize { x.iter().filter(|b| **b > 0).count() }
+    ";
+    let tree = parser.parse(text, None).unwrap();
+
+    let mut expected = Vec::new();
+    let mut cursor = tree.walk();
+    let mut visited_children = false;
+    loop {
+        if !visited_children {
+            expected.push((cursor.node(), cursor.field_name()));
+            if !cursor.goto_first_child() {
+                visited_children = true;
+            }
+        } else if cursor.goto_next_sibling() {
+            visited_children = false;
+        } else if !cursor.goto_parent() {
+            break;
+        }
+    }
+
+    let mut nodes = vec![(cursor.node(), cursor.field_name())];
+    while cursor.goto_next_descendant() {
+        assert_eq!(cursor.descendant_index(), nodes.len());
+        nodes.push((cursor.node(), cursor.field_name()));
+    }
+    assert_eq!(nodes, expected);
+    assert_eq!(cursor.node(), tree.root_node());
+
+    // A cursor that starts on an inner node only visits that node's subtree.
+    let struct_node = tree.root_node().named_child(1).unwrap();
+    assert_eq!(struct_node.kind(), "struct_item");
+    let mut cursor = struct_node.walk();
+    let mut count = 1;
+    while cursor.goto_next_descendant() {
+        count += 1;
+    }
+    assert_eq!(count, struct_node.descendant_count());
+    assert_eq!(cursor.node(), struct_node);
+}
+
+#[test]
+fn test_tree_cursor_descendant_for_position() {
+    let mut parser = Parser::new();
+    parser.set_language(&get_language("rust")).unwrap();
+
+    let text = "
+        // A comment
+        struct Stuff {
+            a: A,
+            b: Option<B>,
+        }
+
+        fn f(x: &[u8]) -> usize { x.iter().filter(|b| **b > 0).count() }
+    ";
+    let tree = parser.parse(text, None).unwrap();
+    let root = tree.root_node();
+
+    let mut point = Point::new(0, 0);
+    let mut positions = Vec::new();
+    for (byte, c) in text.bytes().enumerate() {
+        positions.push((byte, point));
+        if c == b'\n' {
+            point = Point::new(point.row + 1, 0);
+        } else {
+            point.column += 1;
+        }
+    }
+
+    // Move forward and then backward through the text, so that each move
+    // starts from the node found for the previous position.
+    let mut cursor = tree.walk();
+    for &(byte, point) in positions.iter().chain(positions.iter().rev()) {
+        cursor.goto_descendant_for_byte(byte);
+        assert_eq!(
+            cursor.node(),
+            root.descendant_for_byte_range(byte, byte).unwrap()
+        );
+
+        let mut descendant_cursor = tree.walk();
+        descendant_cursor.goto_descendant(cursor.descendant_index());
+        assert_eq!(descendant_cursor.node(), cursor.node());
+        assert_eq!(descendant_cursor.depth(), cursor.depth());
+
+        cursor.goto_descendant_for_point(point);
+        assert_eq!(
+            cursor.node(),
+            root.descendant_for_point_range(point, point).unwrap()
+        );
+    }
+
+    // A cursor that starts on an inner node stays within that node.
+    let struct_node = root.named_child(1).unwrap();
+    let mut cursor = struct_node.walk();
+    cursor.goto_descendant_for_byte(text.find("Option").unwrap());
+    assert_eq!(cursor.node().kind(), "type_identifier");
+    assert_eq!(cursor.node().utf8_text(text.as_bytes()).unwrap(), "Option");
+    cursor.goto_descendant_for_byte(text.len());
+    assert_eq!(cursor.node(), struct_node);
+}
+
 #[test]
 fn test_tree_cursor_fields() {
     let mut parser = Parser::new();
@@ -63,6 +63,24 @@ TSHighlightError ts_highlighter_highlight(
   const size_t *cancellation_flag
 );
 
+// Compute syntax highlighting for several documents at once, using up to
+// `thread_count` threads, or one thread per CPU if `thread_count` is zero.
+// The `scope_names`, `source_codes`, `source_code_lens`, `outputs` and
+// `errors` arrays must each contain `count` elements. Each document's HTML
+// is stored in the corresponding output buffer, and the result of
+// highlighting it is stored in the corresponding element of `errors`.
+void ts_highlighter_highlight_batch(
+  const TSHighlighter *self,
+  const char **scope_names,
+  const char **source_codes,
+  const uint32_t *source_code_lens,
+  TSHighlightBuffer **outputs,
+  TSHighlightError *errors,
+  uint32_t count,
+  uint32_t thread_count,
+  const size_t *cancellation_flag
+);
+
 // TSHighlightBuffer: This struct stores the HTML output of syntax
 // highlighting. It can be reused for multiple highlighting calls.
 TSHighlightBuffer *ts_highlight_buffer_new();
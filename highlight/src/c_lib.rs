@@ -1,6 +1,13 @@
 use std::{
-    collections::HashMap, ffi::CStr, fmt, os::raw::c_char, process::abort, slice, str,
-    sync::atomic::AtomicUsize,
+    collections::HashMap,
+    ffi::CStr,
+    fmt,
+    num::NonZeroUsize,
+    os::raw::c_char,
+    process::abort,
+    slice, str,
+    sync::{atomic::AtomicUsize, Mutex},
+    thread,
 };
 
 use regex::Regex;
@@ -264,7 +271,125 @@ pub unsafe extern "C" fn ts_highlighter_highlight(
     let scope_name = unwrap(CStr::from_ptr(scope_name).to_str());
     let source_code = slice::from_raw_parts(source_code.cast::<u8>(), source_code_len as usize);
     let cancellation_flag = cancellation_flag.as_ref();
-    this.highlight(source_code, scope_name, output, cancellation_flag)
+    this.highlight(
+        source_code,
+        scope_name,
+        &mut output.highlighter,
+        &mut output.renderer,
+        cancellation_flag,
+    )
+}
+
+/// Highlight several strings of source code at once, using up to `thread_count` threads.
+///
+/// Each document is rendered into the corresponding buffer in `outputs`, and the result of
+/// highlighting it is stored in the corresponding element of `errors`, so a document that
+/// fails to highlight doesn't affect the others. Each thread reuses a single [`Highlighter`]
+/// for all of the documents that it processes. If `thread_count` is zero, one thread is
+/// used per available CPU.
+///
+/// # Safety
+///
+/// `scope_names`, `source_codes`, `source_code_lens`, `outputs` and `errors` must be
+/// non-null arrays of `count` elements, and every element of `scope_names`, `source_codes`
+/// and `outputs` must be non-null. The buffers in `outputs` must be distinct instances
+/// created by [`ts_highlight_buffer_new`].
+///
+/// `this` must be a non-null pointer to a [`TSHighlighter`] instance created by
+/// [`ts_highlighter_new`]
+#[no_mangle]
+pub unsafe extern "C" fn ts_highlighter_highlight_batch(
+    this: *const TSHighlighter,
+    scope_names: *const *const c_char,
+    source_codes: *const *const c_char,
+    source_code_lens: *const u32,
+    outputs: *const *mut TSHighlightBuffer,
+    errors: *mut ErrorCode,
+    count: u32,
+    thread_count: u32,
+    cancellation_flag: *const AtomicUsize,
+) {
+    let this = unwrap_ptr(this);
+    let count = count as usize;
+    if count == 0 {
+        return;
+    }
+    let scope_names = slice::from_raw_parts(scope_names, count);
+    let source_codes = slice::from_raw_parts(source_codes, count);
+    let source_code_lens = slice::from_raw_parts(source_code_lens, count);
+    let outputs = slice::from_raw_parts(outputs, count);
+    let errors = slice::from_raw_parts_mut(errors, count);
+    let cancellation_flag = cancellation_flag.as_ref();
+
+    let documents = scope_names
+        .iter()
+        .zip(source_codes)
+        .zip(source_code_lens)
+        .zip(outputs)
+        .zip(errors)
+        .map(|((((scope_name, source_code), len), output), error)| {
+            (
+                CStr::from_ptr(*scope_name).to_str(),
+                slice::from_raw_parts(source_code.cast::<u8>(), *len as usize),
+                unwrap_mut_ptr(*output),
+                error,
+            )
+        })
+        .collect::<Vec<_>>();
+
+    let thread_count = match NonZeroUsize::new(thread_count as usize) {
+        Some(thread_count) => thread_count.get(),
+        None => thread::available_parallelism().map_or(1, NonZeroUsize::get),
+    };
+    for_each_in_parallel(
+        documents,
+        thread_count,
+        Highlighter::new,
+        |highlighter, (scope_name, source_code, output, error)| {
+            *error = match scope_name {
+                Ok(scope_name) => this.highlight(
+                    source_code,
+                    scope_name,
+                    highlighter,
+                    &mut output.renderer,
+                    cancellation_flag,
+                ),
+                Err(_) => ErrorCode::InvalidUtf8,
+            };
+        },
+    );
+}
+
+// Process the items on up to `thread_count` threads, each of which takes the next
+// unprocessed item until there are none left. `init` creates each thread's state.
+fn for_each_in_parallel<T: Send, S>(
+    items: Vec<T>,
+    thread_count: usize,
+    init: impl Fn() -> S + Sync,
+    process: impl Fn(&mut S, T) + Sync,
+) {
+    let thread_count = thread_count.min(items.len());
+    let items = Mutex::new(items.into_iter());
+    let process_items = || {
+        let mut state = init();
+        loop {
+            // Release the lock before processing the item, so that the other threads
+            // can take items in the meantime.
+            let next = items.lock().unwrap().next();
+            let Some(item) = next else { break };
+            process(&mut state, item);
+        }
+    };
+
+    if thread_count <= 1 {
+        process_items();
+    } else {
+        thread::scope(|scope| {
+            for _ in 0..thread_count {
+                scope.spawn(process_items);
+            }
+        });
+    }
 }
 
 impl TSHighlighter {
@@ -272,7 +397,8 @@ impl TSHighlighter {
         &self,
         source_code: &[u8],
         scope_name: &str,
-        output: &mut TSHighlightBuffer,
+        highlighter: &mut Highlighter,
+        renderer: &mut HtmlRenderer,
         cancellation_flag: Option<&AtomicUsize>,
     ) -> ErrorCode {
         let entry = self.languages.get(scope_name);
@@ -282,7 +408,7 @@ impl TSHighlighter {
         let (_, configuration) = entry.unwrap();
         let languages = &self.languages;
 
-        let highlights = output.highlighter.highlight(
+        let highlights = highlighter.highlight(
             configuration,
             source_code,
             cancellation_flag,
@@ -300,13 +426,9 @@ impl TSHighlighter {
         );
 
         if let Ok(highlights) = highlights {
-            output.renderer.reset();
-            output
-                .renderer
-                .set_carriage_return_highlight(self.carriage_return_index.map(Highlight));
-            let result = output
-                .renderer
-                .render(highlights, source_code, &|s| self.attribute_strings[s.0]);
+            renderer.reset();
+            renderer.set_carriage_return_highlight(self.carriage_return_index.map(Highlight));
+            let result = renderer.render(highlights, source_code, &|s| self.attribute_strings[s.0]);
             match result {
                 Err(Error::Cancelled | Error::Unknown) => ErrorCode::Timeout,
                 Err(Error::InvalidLanguage) => ErrorCode::InvalidLanguage,
@@ -338,3 +460,39 @@ fn unwrap<T, E: fmt::Display>(result: Result<T, E>) -> T {
         abort();
     })
 }
+
+#[cfg(test)]
+mod tests {
+    use std::{
+        sync::atomic::Ordering,
+        time::{Duration, Instant},
+    };
+
+    use super::*;
+
+    #[test]
+    fn test_for_each_in_parallel_processes_items_concurrently() {
+        // Each item waits for the other one to start. If the items were processed one at a
+        // time, the first one would give up waiting and report that it ran alone.
+        let started = AtomicUsize::new(0);
+        let overlapped = Mutex::new(Vec::new());
+        for_each_in_parallel(
+            vec![0, 1],
+            2,
+            || (),
+            |(), item| {
+                started.fetch_add(1, Ordering::SeqCst);
+                let deadline = Instant::now() + Duration::from_secs(10);
+                while started.load(Ordering::SeqCst) < 2 && Instant::now() < deadline {
+                    thread::yield_now();
+                }
+                let both_started = started.load(Ordering::SeqCst) == 2;
+                overlapped.lock().unwrap().push((item, both_started));
+            },
+        );
+
+        let mut overlapped = overlapped.into_inner().unwrap();
+        overlapped.sort_unstable();
+        assert_eq!(overlapped, vec![(0, true), (1, true)]);
+    }
+}
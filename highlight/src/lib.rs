@@ -2,22 +2,31 @@
 
 pub mod c_lib;
 use std::{
-    collections::HashSet,
-    iter, mem, ops, str,
-    sync::atomic::{AtomicUsize, Ordering},
+    collections::{HashMap, HashSet, VecDeque},
+    io, iter, mem,
+    num::NonZeroUsize,
+    ops, ptr, str,
+    sync::{
+        atomic::{AtomicUsize, Ordering},
+        OnceLock,
+    },
+    thread,
 };
 
 pub use c_lib as c;
 use lazy_static::lazy_static;
 use thiserror::Error;
 use tree_sitter::{
-    Language, LossyUtf8, Node, Parser, Point, Query, QueryCaptures, QueryCursor, QueryError,
-    QueryMatch, Range, Tree,
+    InputEdit, Language, LossyUtf8, Node, Parser, Point, Query, QueryCaptures, QueryCursor,
+    QueryError, QueryMatch, Range, Tree,
 };
 
 const CANCELLATION_CHECK_INTERVAL: usize = 100;
 const BUFFER_HTML_RESERVE_CAPACITY: usize = 10 * 1024;
 const BUFFER_LINES_RESERVE_CAPACITY: usize = 1000;
+const HTML_WRITER_BUFFER_CAPACITY: usize = 8 * 1024;
+const CONFIGURATION_MAGIC: &[u8] = b"TSHLCONF";
+const CONFIGURATION_VERSION: u32 = 1;
 
 lazy_static! {
     static ref STANDARD_CAPTURE_NAMES: HashSet<&'static str> = vec![
@@ -109,6 +118,8 @@ pub struct HighlightConfiguration {
     pub language_name: String,
     pub query: Query,
     combined_injections_query: Option<Query>,
+    injections_query: OnceLock<Option<Query>>,
+    injections_query_source: Option<(String, Vec<usize>)>,
     locals_pattern_index: usize,
     highlights_pattern_index: usize,
     highlight_indices: Vec<Option<Highlight>>,
@@ -129,6 +140,31 @@ pub struct HighlightConfiguration {
 pub struct Highlighter {
     pub parser: Parser,
     cursors: Vec<QueryCursor>,
+    thread_count: usize,
+    workers: Vec<InjectionWorker>,
+    parsed_layers: HashMap<(usize, Vec<Range>), Tree>,
+}
+
+struct InjectionWorker {
+    parser: Parser,
+    cursor: QueryCursor,
+}
+
+// A layer that has been parsed ahead of time, along with the injections that it contains.
+type ParsedLayer = (Tree, Vec<(String, Vec<Range>)>);
+
+/// Keeps the syntax trees of a document and of all of its injections, so that the
+/// document can be re-highlighted incrementally after it is edited.
+///
+/// Call [`edit`](HighlightSession::edit) for every change to the source code, then
+/// [`update`](HighlightSession::update) to reparse the affected layers and find the
+/// byte ranges whose highlighting may have changed. Those ranges can then be
+/// re-highlighted with [`highlight`](HighlightSession::highlight).
+pub struct HighlightSession<'a> {
+    config: &'a HighlightConfiguration,
+    layers: Vec<SessionLayer<'a>>,
+    edited_ranges: Vec<ops::Range<usize>>,
+    changed_ranges: Vec<ops::Range<usize>>,
 }
 
 /// Converts a general-purpose syntax highlighting iterator into a sequence of lines of HTML.
@@ -138,18 +174,69 @@ pub struct HtmlRenderer {
     carriage_return_highlight: Option<Highlight>,
 }
 
+/// Writes the HTML for a syntax-highlighted document directly to an [`io::Write`] sink.
+///
+/// The output is the same as the [`html`](HtmlRenderer::html) produced by an [`HtmlRenderer`],
+/// but it is written through a fixed-size buffer instead of being accumulated in memory, and
+/// each highlight's opening tag is built once, when the writer is created.
+pub struct HtmlWriter<W: io::Write> {
+    writer: W,
+    buffer: Vec<u8>,
+    start_tags: Vec<Box<[u8]>>,
+    carriage_return_tag: Option<Box<[u8]>>,
+    highlights: Vec<Highlight>,
+}
+
+/// The stack of local scopes that enclose the current position in a layer, along with
+/// the local variables that they define.
+///
+/// The definitions from every scope on the stack are stored together, in the order in
+/// which they were found, and are indexed by name. Each definition also refers to the
+/// definition with the same name that it shadows, so references are resolved by following
+/// that chain rather than by searching through every scope.
+#[derive(Debug)]
+struct LocalScopes<'a> {
+    scopes: Vec<LocalScope>,
+    defs: Vec<LocalDef<'a>>,
+    latest_defs: HashMap<&'a str, usize>,
+}
+
 #[derive(Debug)]
 struct LocalDef<'a> {
     name: &'a str,
     value_range: ops::Range<usize>,
     highlight: Option<Highlight>,
+    shadowed_def: Option<usize>,
 }
 
 #[derive(Debug)]
-struct LocalScope<'a> {
-    inherits: bool,
+struct LocalScope {
     range: ops::Range<usize>,
-    local_defs: Vec<LocalDef<'a>>,
+    defs_start: usize,
+    // The index of the first definition that is visible within this scope. This is the
+    // first definition of the innermost enclosing scope that doesn't inherit definitions
+    // from its parent.
+    visible_defs_start: usize,
+}
+
+struct SessionLayer<'a> {
+    config: &'a HighlightConfiguration,
+    tree: Tree,
+    ranges: Vec<Range>,
+    depth: usize,
+    parent: Option<usize>,
+    content_range: ops::Range<usize>,
+    combined: bool,
+}
+
+struct SessionLayerUpdate<'a> {
+    config: &'a HighlightConfiguration,
+    ranges: Vec<Range>,
+    depth: usize,
+    parent: Option<usize>,
+    content_range: ops::Range<usize>,
+    combined: bool,
+    old_layer: Option<usize>,
 }
 
 struct HighlightIter<'a, F>
@@ -159,6 +246,7 @@ where
     source: &'a [u8],
     language_name: &'a str,
     byte_offset: usize,
+    byte_range: ops::Range<usize>,
     highlighter: &'a mut Highlighter,
     injection_callback: F,
     cancellation_flag: Option<&'a AtomicUsize>,
@@ -174,7 +262,7 @@ struct HighlightIterLayer<'a> {
     captures: iter::Peekable<QueryCaptures<'a, 'a, &'a [u8], &'a [u8]>>,
     config: &'a HighlightConfiguration,
     highlight_end_stack: Vec<usize>,
-    scope_stack: Vec<LocalScope<'a>>,
+    local_scopes: LocalScopes<'a>,
     ranges: Vec<Range>,
     depth: usize,
 }
@@ -191,9 +279,35 @@ impl Highlighter {
         Self {
             parser: Parser::new(),
             cursors: Vec::new(),
+            thread_count: 1,
+            workers: Vec::new(),
+            parsed_layers: HashMap::new(),
         }
     }
 
+    /// Set the number of threads that are used to parse injected languages.
+    ///
+    /// When this is greater than one, the injections that intersect the highlighted range
+    /// are found and parsed before highlighting begins, by worker threads that each have
+    /// their own parser and query cursor. The injections at each level of nesting are
+    /// parsed concurrently. The resulting highlight events are the same as when using a
+    /// single thread.
+    ///
+    /// The parsers and cursors are kept between calls, but the threads are not: every
+    /// level of nesting spawns up to this many new threads, on every call to
+    /// [`highlight`](Highlighter::highlight) or
+    /// [`highlight_range`](Highlighter::highlight_range). Spawning a thread typically
+    /// takes tens of microseconds, so this only pays off for documents whose injections
+    /// take much longer than that to parse.
+    ///
+    /// The worker threads' parsers use the same timeout as the highlighter's own
+    /// [`parser`](Highlighter::parser), but they don't use its logger, because a logger
+    /// can't be shared between threads.
+    pub fn set_thread_count(&mut self, thread_count: NonZeroUsize) {
+        self.thread_count = thread_count.get();
+        self.workers.truncate(self.thread_count);
+    }
+
     pub fn parser(&mut self) -> &mut Parser {
         &mut self.parser
     }
@@ -204,8 +318,50 @@ impl Highlighter {
         config: &'a HighlightConfiguration,
         source: &'a [u8],
         cancellation_flag: Option<&'a AtomicUsize>,
+        injection_callback: impl FnMut(&str) -> Option<&'a HighlightConfiguration> + 'a,
+    ) -> Result<impl Iterator<Item = Result<HighlightEvent, Error>> + 'a, Error> {
+        self.highlight_range(
+            config,
+            source,
+            0..usize::MAX,
+            cancellation_flag,
+            injection_callback,
+        )
+    }
+
+    /// Iterate over the highlighted regions within a given byte range of a slice of
+    /// source code, such as the part of a document that is visible in an editor.
+    ///
+    /// The whole document is parsed, but only the syntax nodes that intersect the range
+    /// are queried, and only the injections that intersect the range are parsed. To
+    /// resolve local variables, each layer is queried starting from the outermost local
+    /// scope (other than the entire document) that encloses the start of the range, and
+    /// the top-level definitions before that scope are collected with a separate query
+    /// that doesn't produce any highlights. So the cost of that query grows with the
+    /// distance of the range from the start of the document.
+    ///
+    /// The events are balanced: highlights that begin before the range and extend into it
+    /// are started at the beginning of the range, and highlights that are still open at
+    /// the end of the range are ended there.
+    pub fn highlight_range<'a>(
+        &'a mut self,
+        config: &'a HighlightConfiguration,
+        source: &'a [u8],
+        range: ops::Range<usize>,
+        cancellation_flag: Option<&'a AtomicUsize>,
         mut injection_callback: impl FnMut(&str) -> Option<&'a HighlightConfiguration> + 'a,
     ) -> Result<impl Iterator<Item = Result<HighlightEvent, Error>> + 'a, Error> {
+        let byte_range = highlight_byte_range(range, source.len());
+        self.parsed_layers.clear();
+        if self.thread_count > 1 {
+            self.parse_layers_in_parallel(
+                config,
+                source,
+                &byte_range,
+                cancellation_flag,
+                &mut injection_callback,
+            )?;
+        }
         let layers = HighlightIterLayer::new(
             source,
             None,
@@ -220,12 +376,14 @@ impl Highlighter {
                 start_point: Point::new(0, 0),
                 end_point: Point::new(usize::MAX, usize::MAX),
             }],
+            &byte_range,
         )?;
         assert_ne!(layers.len(), 0);
         let mut result = HighlightIter {
             source,
             language_name: &config.language_name,
-            byte_offset: 0,
+            byte_offset: byte_range.start,
+            byte_range,
             injection_callback,
             cancellation_flag,
             highlighter: self,
@@ -237,6 +395,137 @@ impl Highlighter {
         result.sort_layers();
         Ok(result)
     }
+
+    // Parse the document and its injections ahead of time, one level of nesting at a
+    // time, distributing each level's layers across worker threads that are spawned for
+    // that level and joined before the next one.
+    fn parse_layers_in_parallel<'a>(
+        &mut self,
+        config: &'a HighlightConfiguration,
+        source: &[u8],
+        byte_range: &ops::Range<usize>,
+        cancellation_flag: Option<&AtomicUsize>,
+        injection_callback: &mut impl FnMut(&str) -> Option<&'a HighlightConfiguration>,
+    ) -> Result<(), Error> {
+        while self.workers.len() < self.thread_count {
+            self.workers.push(InjectionWorker {
+                parser: Parser::new(),
+                cursor: QueryCursor::new(),
+            });
+        }
+        let timeout_micros = self.parser.timeout_micros();
+        for worker in &mut self.workers {
+            worker.parser.set_timeout_micros(timeout_micros);
+        }
+
+        // The document itself is parsed on the calling thread, using the highlighter's
+        // own parser, so that its logger is used for the document. The injections are
+        // parsed with the workers' parsers, which only share its timeout.
+        let parent_name = config.language_name.as_str();
+        let root_ranges = vec![Range {
+            start_byte: 0,
+            end_byte: usize::MAX,
+            start_point: Point::new(0, 0),
+            end_point: Point::new(usize::MAX, usize::MAX),
+        }];
+        let mut cursor = self.cursors.pop().unwrap_or_default();
+        let root = parse_layer(
+            &mut self.parser,
+            &mut cursor,
+            source,
+            config,
+            &root_ranges,
+            parent_name,
+            byte_range,
+            cancellation_flag,
+        );
+        self.cursors.push(cursor);
+
+        let mut layers = vec![(config, root_ranges)];
+        let mut results = vec![root?];
+        loop {
+            let mut next_layers = Vec::<(&HighlightConfiguration, Vec<Range>)>::new();
+            for ((config, ranges), result) in layers.into_iter().zip(results) {
+                let Some((tree, injections)) = result else {
+                    continue;
+                };
+                self.parsed_layers
+                    .insert((config_key(config), ranges), tree);
+                for (language_name, ranges) in injections {
+                    if let Some(config) = injection_callback(&language_name) {
+                        let key = (config_key(config), ranges);
+                        if !self.parsed_layers.contains_key(&key)
+                            && !next_layers
+                                .iter()
+                                .any(|(c, r)| (config_key(c), r) == (key.0, &key.1))
+                        {
+                            next_layers.push((config, key.1));
+                        }
+                    }
+                }
+            }
+            if next_layers.is_empty() {
+                return Ok(());
+            }
+
+            let next_index = AtomicUsize::new(0);
+            let worker_count = self.thread_count.min(next_layers.len());
+            let parse_layers = |worker: &mut InjectionWorker| {
+                let mut results = Vec::new();
+                loop {
+                    let index = next_index.fetch_add(1, Ordering::Relaxed);
+                    let Some((config, ranges)) = next_layers.get(index) else {
+                        break;
+                    };
+                    results.push((
+                        index,
+                        parse_layer(
+                            &mut worker.parser,
+                            &mut worker.cursor,
+                            source,
+                            config,
+                            ranges,
+                            parent_name,
+                            byte_range,
+                            cancellation_flag,
+                        ),
+                    ));
+                }
+                results
+            };
+            let mut next_results = (0..next_layers.len()).map(|_| None).collect::<Vec<_>>();
+            thread::scope(|scope| {
+                let workers = self.workers[0..worker_count]
+                    .iter_mut()
+                    .map(|worker| scope.spawn(|| parse_layers(worker)))
+                    .collect::<Vec<_>>();
+                for worker in workers {
+                    for (index, result) in worker.join().unwrap() {
+                        next_results[index] = Some(result);
+                    }
+                }
+            });
+            results = next_results
+                .into_iter()
+                .map(Option::unwrap)
+                .collect::<Result<_, _>>()?;
+            layers = next_layers;
+        }
+    }
+
+    // Take a layer's syntax tree from the layers that were parsed ahead of time. If the
+    // same layer is injected again, it's parsed again like any other layer.
+    fn take_parsed_layer(
+        &mut self,
+        config: &HighlightConfiguration,
+        ranges: &[Range],
+    ) -> Option<Tree> {
+        if self.parsed_layers.is_empty() {
+            return None;
+        }
+        self.parsed_layers
+            .remove(&(config_key(config), ranges.to_vec()))
+    }
 }
 
 impl HighlightConfiguration {
@@ -289,22 +578,49 @@ impl HighlightConfiguration {
         // Construct a separate query just for dealing with the 'combined injections'.
         // Disable the combined injection patterns in the main query.
         let mut combined_injections_query = Query::new(&language, injection_query)?;
-        let mut has_combined_queries = false;
+        let mut combined_pattern_indices = Vec::new();
         for pattern_index in 0..locals_pattern_index {
             let settings = query.property_settings(pattern_index);
             if settings.iter().any(|s| &*s.key == "injection.combined") {
-                has_combined_queries = true;
+                combined_pattern_indices.push(pattern_index);
                 query.disable_pattern(pattern_index);
             } else {
                 combined_injections_query.disable_pattern(pattern_index);
             }
         }
+        let has_combined_queries = !combined_pattern_indices.is_empty();
+
+        // Another query with just the remaining injection patterns is used for finding
+        // injections without running the rest of the main query. It's only needed when
+        // injections are parsed ahead of time, so it's compiled on first use.
+        let injections_query_source = (combined_pattern_indices.len() < locals_pattern_index)
+            .then(|| (injection_query.to_string(), combined_pattern_indices));
         let combined_injections_query = if has_combined_queries {
             Some(combined_injections_query)
         } else {
             None
         };
 
+        let mut result = Self::from_queries(
+            language,
+            name.into(),
+            query,
+            combined_injections_query,
+            locals_pattern_index,
+            highlights_pattern_index,
+        );
+        result.injections_query_source = injections_query_source;
+        Ok(result)
+    }
+
+    fn from_queries(
+        language: Language,
+        language_name: String,
+        query: Query,
+        combined_injections_query: Option<Query>,
+        locals_pattern_index: usize,
+        highlights_pattern_index: usize,
+    ) -> Self {
         // Find all of the highlighting patterns that are disabled for nodes that
         // have been identified as local variables.
         let non_local_variable_patterns = (0..query.pattern_count())
@@ -337,11 +653,13 @@ impl HighlightConfiguration {
         }
 
         let highlight_indices = vec![None; query.capture_names().len()];
-        Ok(Self {
+        Self {
             language,
-            language_name: name.into(),
+            language_name,
             query,
             combined_injections_query,
+            injections_query: OnceLock::new(),
+            injections_query_source: None,
             locals_pattern_index,
             highlights_pattern_index,
             highlight_indices,
@@ -352,7 +670,102 @@ impl HighlightConfiguration {
             local_def_value_capture_index,
             local_ref_capture_index,
             local_scope_capture_index,
-        })
+        }
+    }
+
+    /// Serialize the configuration, including its compiled queries and the highlight
+    /// names that it was configured with, so that it can be recreated with
+    /// [`HighlightConfiguration::deserialize`] without compiling its queries again.
+    ///
+    /// The data is only valid for the same version of the Tree-sitter library, and the
+    /// same build of the language.
+    #[must_use]
+    pub fn serialize(&self) -> Vec<u8> {
+        let mut data = Vec::new();
+        data.extend_from_slice(CONFIGURATION_MAGIC);
+        write_u32(&mut data, CONFIGURATION_VERSION);
+        write_bytes(&mut data, Some(self.language_name.as_bytes()));
+        write_u32(&mut data, self.locals_pattern_index as u32);
+        write_u32(&mut data, self.highlights_pattern_index as u32);
+        write_u32(&mut data, self.highlight_indices.len() as u32);
+        for highlight in &self.highlight_indices {
+            write_u32(&mut data, highlight.map_or(u32::MAX, |h| h.0 as u32));
+        }
+        write_bytes(&mut data, Some(&self.query.serialize()));
+        let combined_injections_query = self
+            .combined_injections_query
+            .as_ref()
+            .map(Query::serialize);
+        write_bytes(&mut data, combined_injections_query.as_deref());
+        let injections_query = self.injections_query().map(Query::serialize);
+        write_bytes(&mut data, injections_query.as_deref());
+        data
+    }
+
+    /// Recreate a configuration from data that was produced by
+    /// [`HighlightConfiguration::serialize`] for the same language.
+    ///
+    /// Returns `None` if the data is malformed or corrupted, or if it was produced for a
+    /// different language, or in a different version of the serialization format. The data
+    /// doesn't record which version of the Tree-sitter library produced it, so it should only
+    /// be deserialized by the same version.
+    #[must_use]
+    pub fn deserialize(language: Language, data: &[u8]) -> Option<Self> {
+        let mut data = data.strip_prefix(CONFIGURATION_MAGIC)?;
+        if read_u32(&mut data)? != CONFIGURATION_VERSION {
+            return None;
+        }
+        let language_name = String::from_utf8(read_bytes(&mut data)??.to_vec()).ok()?;
+        let locals_pattern_index = read_u32(&mut data)? as usize;
+        let highlights_pattern_index = read_u32(&mut data)? as usize;
+        let highlight_count = read_u32(&mut data)? as usize;
+        let mut highlight_indices = Vec::with_capacity(highlight_count.min(data.len() / 4));
+        for _ in 0..highlight_count {
+            let highlight = read_u32(&mut data)?;
+            highlight_indices
+                .push((highlight != u32::MAX).then_some(Highlight(highlight as usize)));
+        }
+        let read_query = |data: &mut &[u8]| match read_bytes(data)? {
+            Some(query) => Query::deserialize(&language, query).map(Some),
+            None => Some(None),
+        };
+        let query = read_query(&mut data)??;
+        let combined_injections_query = read_query(&mut data)?;
+        let injections_query = read_query(&mut data)?;
+        if !data.is_empty()
+            || highlight_indices.len() != query.capture_names().len()
+            || highlights_pattern_index > query.pattern_count()
+            || locals_pattern_index > highlights_pattern_index
+        {
+            return None;
+        }
+
+        let mut result = Self::from_queries(
+            language,
+            language_name,
+            query,
+            combined_injections_query,
+            locals_pattern_index,
+            highlights_pattern_index,
+        );
+        result.injections_query = OnceLock::from(injections_query);
+        result.highlight_indices = highlight_indices;
+        Some(result)
+    }
+
+    // Get the query for the injections that aren't combined, compiling it on first use.
+    fn injections_query(&self) -> Option<&Query> {
+        self.injections_query
+            .get_or_init(|| {
+                let (source, combined_pattern_indices) = self.injections_query_source.as_ref()?;
+                let mut query = Query::new(&self.language, source)
+                    .expect("the injections query was already compiled successfully");
+                for pattern_index in combined_pattern_indices {
+                    query.disable_pattern(*pattern_index);
+                }
+                Some(query)
+            })
+            .as_ref()
     }
 
     /// Get a slice containing all of the highlight names used in the configuration.
@@ -416,6 +829,526 @@ impl HighlightConfiguration {
             .copied()
             .collect()
     }
+
+    // Find where a layer's query should start in order to resolve the local variables
+    // that are referenced at the given offset: the start of the outermost local scope,
+    // other than the entire document, that encloses the offset.
+    fn local_scope_context_start(
+        &self,
+        tree: &Tree,
+        source: &[u8],
+        cursor: &mut QueryCursor,
+        offset: usize,
+    ) -> usize {
+        let Some(scope_capture_index) = self.local_scope_capture_index else {
+            return offset;
+        };
+        if offset == 0 {
+            return offset;
+        }
+
+        let mut result = offset;
+        let root = tree.root_node();
+        cursor.set_byte_range(offset..offset + 1);
+        for mat in cursor.matches(&self.query, root, source) {
+            if mat.pattern_index < self.locals_pattern_index
+                || mat.pattern_index >= self.highlights_pattern_index
+            {
+                continue;
+            }
+            for capture in mat.captures {
+                let node = capture.node;
+                if capture.index == scope_capture_index
+                    && node != root
+                    && node.start_byte() < result
+                    && node.end_byte() > offset
+                {
+                    result = node.start_byte();
+                }
+            }
+        }
+        cursor.set_byte_range(0..usize::MAX);
+        result
+    }
+}
+
+impl<'a> HighlightSession<'a> {
+    /// Create a session for highlighting a document with the given configuration.
+    ///
+    /// The document is not parsed until the first call to
+    /// [`update`](HighlightSession::update).
+    #[must_use]
+    pub const fn new(config: &'a HighlightConfiguration) -> Self {
+        Self {
+            config,
+            layers: Vec::new(),
+            edited_ranges: Vec::new(),
+            changed_ranges: Vec::new(),
+        }
+    }
+
+    /// Edit the syntax trees of every layer to keep them in sync with source code that
+    /// has been edited.
+    pub fn edit(&mut self, edit: &InputEdit) {
+        for layer in &mut self.layers {
+            layer.tree.edit(edit);
+            layer.ranges = layer.tree.included_ranges();
+            layer.content_range = edit_range(&layer.content_range, edit);
+        }
+        for range in &mut self.edited_ranges {
+            *range = edit_range(range, edit);
+        }
+        self.edited_ranges.push(edit.start_byte..edit.new_end_byte);
+    }
+
+    /// Reparse the document after it has been edited, and return the byte ranges whose
+    /// highlighting may have changed.
+    ///
+    /// Each layer is reparsed using its previous syntax tree. Injections are only searched
+    /// for within the ranges where a layer's syntax tree has changed, and the other
+    /// injected layers are kept. The returned ranges include the changes within every
+    /// layer, along with the ranges of any injections that were added or removed. On the
+    /// first call, they cover the whole document.
+    ///
+    /// Highlights that depend on local variable definitions may also change outside of
+    /// these ranges.
+    pub fn update(
+        &mut self,
+        highlighter: &mut Highlighter,
+        source: &[u8],
+        cancellation_flag: Option<&AtomicUsize>,
+        mut injection_callback: impl FnMut(&str) -> Option<&'a HighlightConfiguration>,
+    ) -> Result<&[ops::Range<usize>], Error> {
+        let mut old_layers = mem::take(&mut self.layers)
+            .into_iter()
+            .map(Some)
+            .collect::<Vec<_>>();
+        let edited_ranges = mem::take(&mut self.edited_ranges);
+        let mut changed_ranges = Vec::new();
+        if old_layers.is_empty() {
+            changed_ranges.push(0..source.len());
+        }
+
+        let mut queue = VecDeque::new();
+        queue.push_back(SessionLayerUpdate {
+            config: self.config,
+            ranges: vec![Range {
+                start_byte: 0,
+                end_byte: usize::MAX,
+                start_point: Point::new(0, 0),
+                end_point: Point::new(usize::MAX, usize::MAX),
+            }],
+            depth: 0,
+            parent: None,
+            content_range: 0..usize::MAX,
+            combined: false,
+            old_layer: if old_layers.is_empty() { None } else { Some(0) },
+        });
+
+        let parent_name = Some(self.config.language_name.as_str());
+        let mut cursor = highlighter.cursors.pop().unwrap_or_default();
+        while let Some(update) = queue.pop_front() {
+            let old_layer = update.old_layer.and_then(|i| old_layers[i].take());
+            if highlighter
+                .parser
+                .set_included_ranges(&update.ranges)
+                .is_err()
+            {
+                if let Some(old_layer) = old_layer {
+                    changed_ranges.push(old_layer.content_range);
+                }
+                continue;
+            }
+            highlighter
+                .parser
+                .set_language(&update.config.language)
+                .map_err(|_| Error::InvalidLanguage)?;
+            unsafe { highlighter.parser.set_cancellation_flag(cancellation_flag) };
+            let tree = highlighter
+                .parser
+                .parse(source, old_layer.as_ref().map(|layer| &layer.tree));
+            unsafe { highlighter.parser.set_cancellation_flag(None) };
+            let tree = tree.ok_or(Error::Cancelled)?;
+
+            // Determine which parts of this layer need to be searched for injections.
+            let mut changes = Vec::new();
+            if let Some(old_layer) = &old_layer {
+                changes.extend(
+                    old_layer
+                        .tree
+                        .changed_ranges(&tree)
+                        .map(|range| range.start_byte..range.end_byte),
+                );
+                changes.extend(edited_ranges.iter().cloned());
+            } else {
+                changes
+                    .push(update.content_range.start..update.content_range.end.min(source.len()));
+            }
+            changed_ranges.extend(changes.iter().cloned());
+
+            let index = self.layers.len();
+            let mut children = Vec::new();
+            if !changes.is_empty() {
+                for range in &changes {
+                    let Some(injections_query) = update.config.injections_query() else {
+                        break;
+                    };
+                    cursor.set_byte_range(range.clone());
+                    let matches = cursor.matches(injections_query, tree.root_node(), source);
+                    for mat in matches {
+                        let (language_name, content_node, include_children) = injection_for_match(
+                            update.config,
+                            parent_name,
+                            injections_query,
+                            &mat,
+                            source,
+                        );
+                        let (Some(language_name), Some(content_node)) =
+                            (language_name, content_node)
+                        else {
+                            continue;
+                        };
+                        let content_range = content_node.byte_range();
+                        if children
+                            .iter()
+                            .any(|child: &SessionLayerUpdate| child.content_range == content_range)
+                        {
+                            continue;
+                        }
+                        if let Some(config) = injection_callback(language_name) {
+                            let ranges = HighlightIterLayer::intersect_ranges(
+                                &update.ranges,
+                                &[content_node],
+                                include_children,
+                            );
+                            if !ranges.is_empty() {
+                                children.push(SessionLayerUpdate {
+                                    config,
+                                    ranges,
+                                    depth: update.depth + 1,
+                                    parent: Some(index),
+                                    content_range,
+                                    combined: false,
+                                    old_layer: None,
+                                });
+                            }
+                        }
+                    }
+                }
+
+                cursor.set_byte_range(0..usize::MAX);
+                for (config, ranges) in HighlightIterLayer::combined_injections(
+                    source,
+                    parent_name,
+                    &mut injection_callback,
+                    update.config,
+                    &tree,
+                    &mut cursor,
+                    &update.ranges,
+                ) {
+                    let content_range = ranges[0].start_byte..ranges[ranges.len() - 1].end_byte;
+                    children.push(SessionLayerUpdate {
+                        config,
+                        ranges,
+                        depth: update.depth + 1,
+                        parent: Some(index),
+                        content_range,
+                        combined: true,
+                        old_layer: None,
+                    });
+                }
+            }
+
+            // Reuse the trees of the injections that were found again, and keep the
+            // injections that lie outside of the changed ranges. Combined injections
+            // span the whole layer, so they are only kept if nothing in it changed.
+            if let Some(old_index) = update.old_layer {
+                for (i, old_child) in old_layers.iter().enumerate() {
+                    let Some(old_child) = old_child else { continue };
+                    if old_child.parent != Some(old_index) {
+                        continue;
+                    }
+                    let unchanged = if old_child.combined {
+                        changes.is_empty()
+                    } else {
+                        !changes
+                            .iter()
+                            .any(|range| ranges_intersect(range, &old_child.content_range))
+                    };
+                    let found = children.iter_mut().find(|child| {
+                        child.old_layer.is_none()
+                            && child.combined == old_child.combined
+                            && child.content_range == old_child.content_range
+                            && ptr::eq(child.config, old_child.config)
+                    });
+                    if let Some(child) = found {
+                        child.old_layer = Some(i);
+                    } else if unchanged {
+                        children.push(SessionLayerUpdate {
+                            config: old_child.config,
+                            ranges: old_child.ranges.clone(),
+                            depth: old_child.depth,
+                            parent: Some(index),
+                            content_range: old_child.content_range.clone(),
+                            combined: old_child.combined,
+                            old_layer: Some(i),
+                        });
+                    }
+                }
+            }
+            for child in &children {
+                if child.old_layer.is_none() {
+                    changed_ranges.push(child.content_range.clone());
+                }
+            }
+            queue.extend(children);
+
+            self.layers.push(SessionLayer {
+                config: update.config,
+                tree,
+                ranges: update.ranges,
+                depth: update.depth,
+                parent: update.parent,
+                content_range: update.content_range,
+                combined: update.combined,
+            });
+        }
+        highlighter.cursors.push(cursor);
+
+        // Any old layers that were not reused have been removed from the document.
+        for old_layer in old_layers.into_iter().flatten() {
+            changed_ranges.push(old_layer.content_range);
+        }
+
+        changed_ranges.sort_unstable_by_key(|range| (range.start, range.end));
+        self.changed_ranges.clear();
+        for range in changed_ranges {
+            let range = range.start.min(source.len())..range.end.min(source.len());
+            if let Some(last) = self.changed_ranges.last_mut() {
+                if range.start <= last.end {
+                    last.end = last.end.max(range.end);
+                    continue;
+                }
+            }
+            self.changed_ranges.push(range);
+        }
+        Ok(&self.changed_ranges)
+    }
+
+    /// Iterate over the highlighted regions within the given byte range of the
+    /// document, using the syntax trees from the most recent call to
+    /// [`update`](HighlightSession::update).
+    ///
+    /// See [`Highlighter::highlight_range`].
+    pub fn highlight<'b>(
+        &'b self,
+        highlighter: &'b mut Highlighter,
+        source: &'b [u8],
+        range: ops::Range<usize>,
+        cancellation_flag: Option<&'b AtomicUsize>,
+    ) -> impl Iterator<Item = Result<HighlightEvent, Error>> + 'b {
+        let byte_range = highlight_byte_range(range, source.len());
+        let mut layers = Vec::with_capacity(self.layers.len());
+        for layer in &self.layers {
+            let mut cursor = highlighter.cursors.pop().unwrap_or_default();
+            let context_start = layer.config.local_scope_context_start(
+                &layer.tree,
+                source,
+                &mut cursor,
+                byte_range.start,
+            );
+            let local_scopes = LocalScopes::preceding(
+                layer.config,
+                &layer.tree,
+                source,
+                &mut cursor,
+                context_start,
+            );
+            cursor.set_byte_range(context_start..byte_range.end);
+            let mut layer = HighlightIterLayer::from_tree(
+                source,
+                layer.tree.clone(),
+                cursor,
+                layer.config,
+                layer.depth,
+                layer.ranges.clone(),
+                local_scopes,
+            );
+            if let Some(sort_key) = layer.sort_key(byte_range.end) {
+                layers.push((sort_key, layer));
+            } else {
+                highlighter.cursors.push(layer.cursor);
+            }
+        }
+        layers.sort_by_key(|(sort_key, _)| *sort_key);
+
+        HighlightIter {
+            source,
+            language_name: &self.config.language_name,
+            byte_offset: byte_range.start,
+            byte_range,
+            injection_callback: |_: &str| None,
+            cancellation_flag,
+            highlighter,
+            iter_count: 0,
+            layers: layers.into_iter().map(|(_, layer)| layer).collect(),
+            next_event: None,
+            last_highlight_range: None,
+        }
+    }
+
+    /// Get the byte ranges that were returned by the most recent call to
+    /// [`update`](HighlightSession::update).
+    #[must_use]
+    pub fn changed_ranges(&self) -> &[ops::Range<usize>] {
+        &self.changed_ranges
+    }
+}
+
+impl<'a> LocalScopes<'a> {
+    fn new() -> Self {
+        Self {
+            scopes: vec![LocalScope {
+                range: 0..usize::MAX,
+                defs_start: 0,
+                visible_defs_start: 0,
+            }],
+            defs: Vec::new(),
+            latest_defs: HashMap::new(),
+        }
+    }
+
+    fn push(&mut self, range: ops::Range<usize>, inherits: bool) {
+        let defs_start = self.defs.len();
+        let visible_defs_start = if inherits {
+            self.scopes.last().unwrap().visible_defs_start
+        } else {
+            defs_start
+        };
+        self.scopes.push(LocalScope {
+            range,
+            defs_start,
+            visible_defs_start,
+        });
+    }
+
+    // Pop the scopes that end before the given offset, restoring any definitions that were
+    // shadowed by their own definitions.
+    fn pop_ended(&mut self, offset: usize) {
+        while offset > self.scopes.last().unwrap().range.end {
+            let scope = self.scopes.pop().unwrap();
+            for def in self.defs.drain(scope.defs_start..).rev() {
+                if let Some(shadowed_def) = def.shadowed_def {
+                    self.latest_defs.insert(def.name, shadowed_def);
+                } else {
+                    self.latest_defs.remove(def.name);
+                }
+            }
+        }
+    }
+
+    // Add a definition to the innermost scope, and return its highlight so that it can be
+    // assigned once the definition's own highlight is known.
+    fn define(&mut self, name: &'a str, value_range: ops::Range<usize>) -> &mut Option<Highlight> {
+        let index = self.defs.len();
+        let shadowed_def = self.latest_defs.insert(name, index);
+        self.defs.push(LocalDef {
+            name,
+            value_range,
+            highlight: None,
+            shadowed_def,
+        });
+        &mut self.defs[index].highlight
+    }
+
+    // Record the local scopes and definitions of the nodes that end before the given offset,
+    // the same way that highlighting the layer from the start of the document would. The
+    // scopes among them have all ended by that offset, so the definitions that remain are
+    // those of the top-level scope, which are still visible after the offset.
+    fn preceding(
+        config: &HighlightConfiguration,
+        tree: &Tree,
+        source: &'a [u8],
+        cursor: &mut QueryCursor,
+        offset: usize,
+    ) -> Self {
+        let mut result = Self::new();
+        if offset == 0 || config.local_def_capture_index.is_none() {
+            return result;
+        }
+
+        // The definition on the current node, and whether a highlight has been found for it.
+        let mut definition: Option<(Node, usize, bool)> = None;
+        cursor.set_byte_range(0..offset);
+        for (mat, capture_index) in cursor.captures(&config.query, tree.root_node(), source) {
+            let capture = mat.captures[capture_index];
+            let range = capture.node.byte_range();
+            if range.start >= offset {
+                break;
+            }
+            // Nodes that extend past the offset are visited when highlighting the range.
+            if range.end > offset || mat.pattern_index < config.locals_pattern_index {
+                continue;
+            }
+            if definition.is_some_and(|(node, _, _)| node != capture.node) {
+                definition = None;
+            }
+
+            // As when highlighting, the first highlight of a definition is used, unless a later
+            // pattern that isn't disabled for local variables also matches it.
+            if mat.pattern_index >= config.highlights_pattern_index {
+                if let Some((_, index, found)) = &mut definition {
+                    if !*found || !config.non_local_variable_patterns[mat.pattern_index] {
+                        result.defs[*index].highlight =
+                            config.highlight_indices[capture.index as usize];
+                        *found = true;
+                    }
+                }
+                continue;
+            }
+
+            result.pop_ended(range.start);
+            if Some(capture.index) == config.local_scope_capture_index {
+                definition = None;
+                let mut inherits = true;
+                for prop in config.query.property_settings(mat.pattern_index) {
+                    if prop.key.as_ref() == "local.scope-inherits" {
+                        inherits = prop.value.as_ref().map_or(true, |r| r.as_ref() == "true");
+                    }
+                }
+                result.push(range, inherits);
+            } else if Some(capture.index) == config.local_def_capture_index {
+                definition = None;
+                let mut value_range = 0..0;
+                for capture in mat.captures {
+                    if Some(capture.index) == config.local_def_value_capture_index {
+                        value_range = capture.node.byte_range();
+                    }
+                }
+                if let Ok(name) = str::from_utf8(&source[range]) {
+                    result.define(name, value_range);
+                    definition = Some((capture.node, result.defs.len() - 1, false));
+                }
+            }
+        }
+        result.pop_ended(usize::MAX);
+        result
+    }
+
+    // Find the highlight of the innermost visible definition of the given name, skipping
+    // definitions whose values contain the reference.
+    fn resolve(&self, name: &str, offset: usize) -> Option<Highlight> {
+        let visible_defs_start = self.scopes.last().unwrap().visible_defs_start;
+        let mut index = self.latest_defs.get(name).copied();
+        while let Some(i) = index.filter(|i| *i >= visible_defs_start) {
+            let def = &self.defs[i];
+            if offset >= def.value_range.end {
+                return def.highlight;
+            }
+            index = def.shadowed_def;
+        }
+        None
+    }
 }
 
 impl<'a> HighlightIterLayer<'a> {
@@ -434,88 +1367,62 @@ impl<'a> HighlightIterLayer<'a> {
         mut config: &'a HighlightConfiguration,
         mut depth: usize,
         mut ranges: Vec<Range>,
+        byte_range: &ops::Range<usize>,
     ) -> Result<Vec<Self>, Error> {
         let mut result = Vec::with_capacity(1);
         let mut queue = Vec::new();
         loop {
-            if highlighter.parser.set_included_ranges(&ranges).is_ok() {
+            let mut tree = highlighter.take_parsed_layer(config, &ranges);
+            if tree.is_none() && highlighter.parser.set_included_ranges(&ranges).is_ok() {
                 highlighter
                     .parser
                     .set_language(&config.language)
                     .map_err(|_| Error::InvalidLanguage)?;
 
                 unsafe { highlighter.parser.set_cancellation_flag(cancellation_flag) };
-                let tree = highlighter
-                    .parser
-                    .parse(source, None)
-                    .ok_or(Error::Cancelled)?;
+                tree = Some(
+                    highlighter
+                        .parser
+                        .parse(source, None)
+                        .ok_or(Error::Cancelled)?,
+                );
                 unsafe { highlighter.parser.set_cancellation_flag(None) };
+            }
+            if let Some(tree) = tree {
                 let mut cursor = highlighter.cursors.pop().unwrap_or_default();
+                cursor.set_byte_range(0..usize::MAX);
 
                 // Process combined injections.
-                if let Some(combined_injections_query) = &config.combined_injections_query {
-                    let mut injections_by_pattern_index =
-                        vec![(None, Vec::new(), false); combined_injections_query.pattern_count()];
-                    let matches =
-                        cursor.matches(combined_injections_query, tree.root_node(), source);
-                    for mat in matches {
-                        let entry = &mut injections_by_pattern_index[mat.pattern_index];
-                        let (language_name, content_node, include_children) = injection_for_match(
-                            config,
-                            parent_name,
-                            combined_injections_query,
-                            &mat,
-                            source,
-                        );
-                        if language_name.is_some() {
-                            entry.0 = language_name;
-                        }
-                        if let Some(content_node) = content_node {
-                            entry.1.push(content_node);
-                        }
-                        entry.2 = include_children;
-                    }
-                    for (lang_name, content_nodes, includes_children) in injections_by_pattern_index
-                    {
-                        if let (Some(lang_name), false) = (lang_name, content_nodes.is_empty()) {
-                            if let Some(next_config) = (injection_callback)(lang_name) {
-                                let ranges = Self::intersect_ranges(
-                                    &ranges,
-                                    &content_nodes,
-                                    includes_children,
-                                );
-                                if !ranges.is_empty() {
-                                    queue.push((next_config, depth + 1, ranges));
-                                }
-                            }
-                        }
+                for (next_config, next_ranges) in Self::combined_injections(
+                    source,
+                    parent_name,
+                    injection_callback,
+                    config,
+                    &tree,
+                    &mut cursor,
+                    &ranges,
+                ) {
+                    if next_ranges.iter().any(|range| {
+                        range.start_byte < byte_range.end && range.end_byte > byte_range.start
+                    }) {
+                        queue.push((next_config, depth + 1, next_ranges));
                     }
                 }
 
-                // The `captures` iterator borrows the `Tree` and the `QueryCursor`, which
-                // prevents them from being moved. But both of these values are really just
-                // pointers, so it's actually ok to move them.
-                let tree_ref = unsafe { mem::transmute::<_, &'static Tree>(&tree) };
-                let cursor_ref =
-                    unsafe { mem::transmute::<_, &'static mut QueryCursor>(&mut cursor) };
-                let captures = cursor_ref
-                    .captures(&config.query, tree_ref.root_node(), source)
-                    .peekable();
-
-                result.push(HighlightIterLayer {
-                    highlight_end_stack: Vec::new(),
-                    scope_stack: vec![LocalScope {
-                        inherits: false,
-                        range: 0..usize::MAX,
-                        local_defs: Vec::new(),
-                    }],
+                let context_start =
+                    config.local_scope_context_start(&tree, source, &mut cursor, byte_range.start);
+                let local_scopes =
+                    LocalScopes::preceding(config, &tree, source, &mut cursor, context_start);
+                cursor.set_byte_range(context_start..byte_range.end);
+                result.push(Self::from_tree(
+                    source,
+                    tree,
                     cursor,
-                    depth,
-                    _tree: tree,
-                    captures,
                     config,
+                    depth,
                     ranges,
-                });
+                    local_scopes,
+                ));
             }
 
             if queue.is_empty() {
@@ -531,6 +1438,80 @@ impl<'a> HighlightIterLayer<'a> {
         Ok(result)
     }
 
+    /// Create a layer that highlights an already-parsed syntax tree.
+    fn from_tree(
+        source: &'a [u8],
+        tree: Tree,
+        mut cursor: QueryCursor,
+        config: &'a HighlightConfiguration,
+        depth: usize,
+        ranges: Vec<Range>,
+        local_scopes: LocalScopes<'a>,
+    ) -> Self {
+        // The `captures` iterator borrows the `Tree` and the `QueryCursor`, which
+        // prevents them from being moved. But both of these values are really just
+        // pointers, so it's actually ok to move them.
+        let tree_ref = unsafe { mem::transmute::<_, &'static Tree>(&tree) };
+        let cursor_ref = unsafe { mem::transmute::<_, &'static mut QueryCursor>(&mut cursor) };
+        let captures = cursor_ref
+            .captures(&config.query, tree_ref.root_node(), source)
+            .peekable();
+
+        HighlightIterLayer {
+            highlight_end_stack: Vec::new(),
+            local_scopes,
+            cursor,
+            depth,
+            _tree: tree,
+            captures,
+            config,
+            ranges,
+        }
+    }
+
+    /// Find the languages and ranges of the combined injections in a layer's syntax tree.
+    #[allow(clippy::too_many_arguments)]
+    fn combined_injections<F: FnMut(&str) -> Option<&'a HighlightConfiguration>>(
+        source: &[u8],
+        parent_name: Option<&str>,
+        injection_callback: &mut F,
+        config: &'a HighlightConfiguration,
+        tree: &Tree,
+        cursor: &mut QueryCursor,
+        ranges: &[Range],
+    ) -> Vec<(&'a HighlightConfiguration, Vec<Range>)> {
+        let mut result = Vec::new();
+        let Some(combined_injections_query) = &config.combined_injections_query else {
+            return result;
+        };
+        let mut injections_by_pattern_index =
+            vec![(None, Vec::new(), false); combined_injections_query.pattern_count()];
+        let matches = cursor.matches(combined_injections_query, tree.root_node(), source);
+        for mat in matches {
+            let entry = &mut injections_by_pattern_index[mat.pattern_index];
+            let (language_name, content_node, include_children) =
+                injection_for_match(config, parent_name, combined_injections_query, &mat, source);
+            if language_name.is_some() {
+                entry.0 = language_name;
+            }
+            if let Some(content_node) = content_node {
+                entry.1.push(content_node);
+            }
+            entry.2 = include_children;
+        }
+        for (lang_name, content_nodes, includes_children) in injections_by_pattern_index {
+            if let (Some(lang_name), false) = (lang_name, content_nodes.is_empty()) {
+                if let Some(next_config) = (injection_callback)(lang_name) {
+                    let ranges = Self::intersect_ranges(ranges, &content_nodes, includes_children);
+                    if !ranges.is_empty() {
+                        result.push((next_config, ranges));
+                    }
+                }
+            }
+        }
+        result
+    }
+
     // Compute the ranges that should be included when parsing an injection.
     // This takes into account three things:
     // * `parent_ranges` - The ranges must all fall within the *current* layer's ranges.
@@ -628,12 +1609,15 @@ impl<'a> HighlightIterLayer<'a> {
     // First, sort scope boundaries by their byte offset in the document. At a
     // given position, emit scope endings before scope beginnings. Finally, emit
     // scope boundaries from deeper layers first.
-    fn sort_key(&mut self) -> Option<(usize, bool, isize)> {
+    //
+    // Captures that start at or after `end_byte` are ignored.
+    fn sort_key(&mut self, end_byte: usize) -> Option<(usize, bool, isize)> {
         let depth = -(self.depth as isize);
         let next_start = self
             .captures
             .peek()
-            .map(|(m, i)| m.captures[*i].node.start_byte());
+            .map(|(m, i)| m.captures[*i].node.start_byte())
+            .filter(|start| *start < end_byte);
         let next_end = self.highlight_end_stack.last().copied();
         match (next_start, next_end) {
             (Some(start), Some(end)) => {
@@ -659,6 +1643,7 @@ where
         offset: usize,
         event: Option<HighlightEvent>,
     ) -> Option<Result<HighlightEvent, Error>> {
+        let offset = offset.min(self.byte_range.end);
         let result;
         if self.byte_offset < offset {
             result = Some(Ok(HighlightEvent::Source {
@@ -676,10 +1661,10 @@ where
 
     fn sort_layers(&mut self) {
         while !self.layers.is_empty() {
-            if let Some(sort_key) = self.layers[0].sort_key() {
+            if let Some(sort_key) = self.layers[0].sort_key(self.byte_range.end) {
                 let mut i = 0;
                 while i + 1 < self.layers.len() {
-                    if let Some(next_offset) = self.layers[i + 1].sort_key() {
+                    if let Some(next_offset) = self.layers[i + 1].sort_key(self.byte_range.end) {
                         if next_offset < sort_key {
                             i += 1;
                             continue;
@@ -698,10 +1683,10 @@ where
     }
 
     fn insert_layer(&mut self, mut layer: HighlightIterLayer<'a>) {
-        if let Some(sort_key) = layer.sort_key() {
+        if let Some(sort_key) = layer.sort_key(self.byte_range.end) {
             let mut i = 1;
             while i < self.layers.len() {
-                if let Some(sort_key_i) = self.layers[i].sort_key() {
+                if let Some(sort_key_i) = self.layers[i].sort_key(self.byte_range.end) {
                     if sort_key_i > sort_key {
                         self.layers.insert(i, layer);
                         return;
@@ -716,6 +1701,18 @@ where
     }
 }
 
+// The trees that were parsed ahead of time and haven't been used by the time highlighting
+// stops, such as those of injections after the end of the range, are dropped along with
+// the iterator, rather than when the highlighter is next used.
+impl<'a, F> Drop for HighlightIter<'a, F>
+where
+    F: FnMut(&str) -> Option<&'a HighlightConfiguration> + 'a,
+{
+    fn drop(&mut self) {
+        self.highlighter.parsed_layers.clear();
+    }
+}
+
 impl<'a, F> Iterator for HighlightIter<'a, F>
 where
     F: FnMut(&str) -> Option<&'a HighlightConfiguration> + 'a,
@@ -743,12 +1740,13 @@ where
 
             // If none of the layers have any more highlight boundaries, terminate.
             if self.layers.is_empty() {
-                return if self.byte_offset < self.source.len() {
+                let end_byte = self.source.len().min(self.byte_range.end);
+                return if self.byte_offset < end_byte {
                     let result = Some(Ok(HighlightEvent::Source {
                         start: self.byte_offset,
-                        end: self.source.len(),
+                        end: end_byte,
                     }));
-                    self.byte_offset = self.source.len();
+                    self.byte_offset = end_byte;
                     result
                 } else {
                     None
@@ -758,7 +1756,12 @@ where
             // Get the next capture from whichever layer has the earliest highlight boundary.
             let range;
             let layer = &mut self.layers[0];
-            if let Some((next_match, capture_index)) = layer.captures.peek() {
+            let end_byte = self.byte_range.end;
+            if let Some((next_match, capture_index)) = layer
+                .captures
+                .peek()
+                .filter(|(m, i)| m.captures[*i].node.start_byte() < end_byte)
+            {
                 let next_capture = next_match.captures[*capture_index];
                 range = next_capture.node.byte_range();
 
@@ -800,8 +1803,12 @@ where
                 match_.remove();
 
                 // If a language is found with the given name, then add a new language layer
-                // to the highlighted document.
-                if let (Some(language_name), Some(content_node)) = (language_name, content_node) {
+                // to the highlighted document. Injections that end before the highlighted
+                // range are skipped.
+                if let (Some(language_name), Some(content_node)) = (
+                    language_name,
+                    content_node.filter(|node| node.end_byte() > self.byte_range.start),
+                ) {
                     if let Some(config) = (self.injection_callback)(language_name) {
                         let ranges = HighlightIterLayer::intersect_ranges(
                             &self.layers[0].ranges,
@@ -818,6 +1825,7 @@ where
                                 config,
                                 self.layers[0].depth + 1,
                                 ranges,
+                                &self.byte_range,
                             ) {
                                 Ok(layers) => {
                                     for layer in layers {
@@ -835,9 +1843,7 @@ where
             }
 
             // Remove from the local scope stack any local scopes that have already ended.
-            while range.start > layer.scope_stack.last().unwrap().range.end {
-                layer.scope_stack.pop();
-            }
+            layer.local_scopes.pop_ended(range.start);
 
             // If this capture is for tracking local variables, then process the
             // local variable info.
@@ -848,25 +1854,19 @@ where
                 // the scope stack.
                 if Some(capture.index) == layer.config.local_scope_capture_index {
                     definition_highlight = None;
-                    let mut scope = LocalScope {
-                        inherits: true,
-                        range: range.clone(),
-                        local_defs: Vec::new(),
-                    };
+                    let mut inherits = true;
                     for prop in layer.config.query.property_settings(match_.pattern_index) {
                         if prop.key.as_ref() == "local.scope-inherits" {
-                            scope.inherits =
-                                prop.value.as_ref().map_or(true, |r| r.as_ref() == "true");
+                            inherits = prop.value.as_ref().map_or(true, |r| r.as_ref() == "true");
                         }
                     }
-                    layer.scope_stack.push(scope);
+                    layer.local_scopes.push(range.clone(), inherits);
                 }
                 // If the node represents a definition, add a new definition to the
                 // local scope at the top of the scope stack.
                 else if Some(capture.index) == layer.config.local_def_capture_index {
                     reference_highlight = None;
                     definition_highlight = None;
-                    let scope = layer.scope_stack.last_mut().unwrap();
 
                     let mut value_range = 0..0;
                     for capture in match_.captures {
@@ -876,13 +1876,7 @@ where
                     }
 
                     if let Ok(name) = str::from_utf8(&self.source[range.clone()]) {
-                        scope.local_defs.push(LocalDef {
-                            name,
-                            value_range,
-                            highlight: None,
-                        });
-                        definition_highlight =
-                            scope.local_defs.last_mut().map(|s| &mut s.highlight);
+                        definition_highlight = Some(layer.local_scopes.define(name, value_range));
                     }
                 }
                 // If the node represents a reference, then try to find the corresponding
@@ -892,21 +1886,7 @@ where
                 {
                     definition_highlight = None;
                     if let Ok(name) = str::from_utf8(&self.source[range.clone()]) {
-                        for scope in layer.scope_stack.iter().rev() {
-                            if let Some(highlight) = scope.local_defs.iter().rev().find_map(|def| {
-                                if def.name == name && range.start >= def.value_range.end {
-                                    Some(def.highlight)
-                                } else {
-                                    None
-                                }
-                            }) {
-                                reference_highlight = highlight;
-                                break;
-                            }
-                            if !scope.inherits {
-                                break;
-                            }
-                        }
+                        reference_highlight = layer.local_scopes.resolve(name, range.start);
                     }
                 }
 
@@ -967,6 +1947,13 @@ where
                 *definition_highlight = current_highlight;
             }
 
+            // Nodes that end before the highlighted range are only visited so that their
+            // local variable definitions are recorded.
+            if range.start < self.byte_range.start && range.end <= self.byte_range.start {
+                self.sort_layers();
+                continue 'main;
+            }
+
             // Emit a scope start event and push the node's end position to the stack.
             if let Some(highlight) = reference_highlight.or(current_highlight) {
                 self.last_highlight_range = Some((range.start, range.end, layer.depth));
@@ -1136,6 +2123,206 @@ impl HtmlRenderer {
     }
 }
 
+impl<W: io::Write> HtmlWriter<W> {
+    /// Create a writer, given the HTML attributes for each highlight, indexed by
+    /// [`Highlight`] value.
+    pub fn new(writer: W, attributes: &[impl AsRef<[u8]>]) -> Self {
+        let start_tags = attributes
+            .iter()
+            .map(|attributes| {
+                let attributes = attributes.as_ref();
+                let mut tag = Vec::with_capacity(attributes.len() + 7);
+                tag.extend(b"<span");
+                if !attributes.is_empty() {
+                    tag.push(b' ');
+                    tag.extend(attributes);
+                }
+                tag.push(b'>');
+                tag.into_boxed_slice()
+            })
+            .collect();
+        Self {
+            writer,
+            buffer: Vec::with_capacity(HTML_WRITER_BUFFER_CAPACITY),
+            start_tags,
+            carriage_return_tag: None,
+            highlights: Vec::new(),
+        }
+    }
+
+    /// Set the highlight that is used to style lone carriage returns, which are otherwise
+    /// omitted from the output. See [`HtmlRenderer::set_carriage_return_highlight`].
+    pub fn set_carriage_return_highlight(&mut self, highlight: Option<Highlight>) {
+        self.carriage_return_tag = highlight.and_then(|highlight| {
+            let start_tag = &self.start_tags[highlight.0];
+            if start_tag.len() > b"<span>".len() {
+                let mut tag = start_tag.to_vec();
+                tag.extend(b"</span>");
+                Some(tag.into_boxed_slice())
+            } else {
+                None
+            }
+        });
+    }
+
+    /// Write the HTML for a sequence of highlight events.
+    ///
+    /// A highlighting error is returned as an [`io::Error`] that wraps the [`Error`].
+    pub fn render(
+        &mut self,
+        highlighter: impl Iterator<Item = Result<HighlightEvent, Error>>,
+        source: &[u8],
+    ) -> io::Result<()> {
+        for event in highlighter {
+            match event.map_err(io::Error::other)? {
+                HighlightEvent::HighlightStart(h) => {
+                    self.highlights.push(h);
+                    self.start_highlight(h)?;
+                }
+                HighlightEvent::HighlightEnd => {
+                    self.highlights.pop();
+                    self.write(b"</span>")?;
+                }
+                HighlightEvent::Source { start, end } => self.add_text(&source[start..end])?,
+            }
+        }
+        Ok(())
+    }
+
+    /// End the document with a line break, if it doesn't already end with one, and flush
+    /// the output. Returns the underlying writer.
+    pub fn finish(mut self) -> io::Result<W> {
+        if self.buffer.last() != Some(&b'\n') {
+            self.write(b"\n")?;
+        }
+        self.writer.write_all(&self.buffer)?;
+        self.writer.flush()?;
+        Ok(self.writer)
+    }
+
+    fn write(&mut self, bytes: &[u8]) -> io::Result<()> {
+        if self.buffer.len() + bytes.len() > HTML_WRITER_BUFFER_CAPACITY {
+            self.writer.write_all(&self.buffer)?;
+            self.buffer.clear();
+            if bytes.len() > HTML_WRITER_BUFFER_CAPACITY {
+                // Keep the last byte in the buffer, so that `finish` can check it.
+                let (head, tail) = bytes.split_at(bytes.len() - 1);
+                self.writer.write_all(head)?;
+                self.buffer.extend_from_slice(tail);
+                return Ok(());
+            }
+        }
+        self.buffer.extend_from_slice(bytes);
+        Ok(())
+    }
+
+    fn start_highlight(&mut self, h: Highlight) -> io::Result<()> {
+        if self.buffer.len() + self.start_tags[h.0].len() > HTML_WRITER_BUFFER_CAPACITY {
+            self.writer.write_all(&self.buffer)?;
+            self.buffer.clear();
+        }
+        self.buffer.extend_from_slice(&self.start_tags[h.0]);
+        Ok(())
+    }
+
+    fn add_text(&mut self, src: &[u8]) -> io::Result<()> {
+        let mut last_char_was_cr = false;
+        for part in LossyUtf8::new(src) {
+            let mut text = part.as_bytes();
+            while !text.is_empty() {
+                let i = find_html_special_byte(text).unwrap_or(text.len());
+                if i > 0 {
+                    // Don't render carriage return characters, but allow lone carriage
+                    // returns (not followed by line feeds) to be styled.
+                    if last_char_was_cr {
+                        self.add_carriage_return()?;
+                        last_char_was_cr = false;
+                    }
+                    self.write(&text[..i])?;
+                }
+                let Some(&c) = text.get(i) else { break };
+                text = &text[i + 1..];
+
+                if c == b'\r' {
+                    last_char_was_cr = true;
+                    continue;
+                }
+                if last_char_was_cr {
+                    if c != b'\n' {
+                        self.add_carriage_return()?;
+                    }
+                    last_char_was_cr = false;
+                }
+
+                // At line boundaries, close and re-open all of the open tags.
+                if c == b'\n' {
+                    for _ in 0..self.highlights.len() {
+                        self.write(b"</span>")?;
+                    }
+                    self.write(b"\n")?;
+                    for i in 0..self.highlights.len() {
+                        self.start_highlight(self.highlights[i])?;
+                    }
+                } else {
+                    self.write(html_escape(c))?;
+                }
+            }
+        }
+        Ok(())
+    }
+
+    fn add_carriage_return(&mut self) -> io::Result<()> {
+        if let Some(tag) = self.carriage_return_tag.take() {
+            let result = self.write(&tag);
+            self.carriage_return_tag = Some(tag);
+            result?;
+        }
+        Ok(())
+    }
+}
+
+const fn html_escape(c: u8) -> &'static [u8] {
+    match c {
+        b'>' => b"&gt;",
+        b'<' => b"&lt;",
+        b'&' => b"&amp;",
+        b'\'' => b"&#39;",
+        b'"' => b"&quot;",
+        _ => &[],
+    }
+}
+
+// Find the first byte that needs to be escaped in HTML, or that is a line break. Eight
+// bytes are checked at a time, by testing each of them for equality with every special
+// byte using word-sized arithmetic.
+fn find_html_special_byte(bytes: &[u8]) -> Option<usize> {
+    const SPECIAL_BYTES: [u8; 7] = [b'<', b'>', b'&', b'\'', b'"', b'\r', b'\n'];
+    const LOW_BITS: u64 = 0x0101_0101_0101_0101;
+    const HIGH_BITS: u64 = 0x8080_8080_8080_8080;
+
+    let mut chunks = bytes.chunks_exact(8);
+    let mut offset = 0;
+    for chunk in chunks.by_ref() {
+        let word = u64::from_le_bytes(chunk.try_into().unwrap());
+        let mut found = 0;
+        for byte in SPECIAL_BYTES {
+            // A byte of `diff` is zero where `word` contains `byte`. The lowest byte that
+            // is flagged here is always a true match.
+            let diff = word ^ (LOW_BITS * u64::from(byte));
+            found |= diff.wrapping_sub(LOW_BITS) & !diff & HIGH_BITS;
+        }
+        if found != 0 {
+            return Some(offset + found.trailing_zeros() as usize / 8);
+        }
+        offset += 8;
+    }
+    chunks
+        .remainder()
+        .iter()
+        .position(|byte| SPECIAL_BYTES.contains(byte))
+        .map(|i| offset + i)
+}
+
 fn injection_for_match<'a>(
     config: &'a HighlightConfiguration,
     parent_name: Option<&'a str>,
@@ -1200,6 +2387,122 @@ fn injection_for_match<'a>(
     (language_name, content_node, include_children)
 }
 
+// Parse a single layer of a document, and find the injections within the highlighted range.
+#[allow(clippy::too_many_arguments)]
+fn parse_layer(
+    parser: &mut Parser,
+    cursor: &mut QueryCursor,
+    source: &[u8],
+    config: &HighlightConfiguration,
+    ranges: &[Range],
+    parent_name: &str,
+    byte_range: &ops::Range<usize>,
+    cancellation_flag: Option<&AtomicUsize>,
+) -> Result<Option<ParsedLayer>, Error> {
+    if parser.set_included_ranges(ranges).is_err() {
+        return Ok(None);
+    }
+    parser
+        .set_language(&config.language)
+        .map_err(|_| Error::InvalidLanguage)?;
+    unsafe { parser.set_cancellation_flag(cancellation_flag) };
+    let tree = parser.parse(source, None);
+    unsafe { parser.set_cancellation_flag(None) };
+    let tree = tree.ok_or(Error::Cancelled)?;
+
+    let mut injections = Vec::new();
+    if let Some(injections_query) = config.injections_query() {
+        cursor.set_byte_range(byte_range.clone());
+        for mat in cursor.matches(injections_query, tree.root_node(), source) {
+            let (language_name, content_node, include_children) =
+                injection_for_match(config, Some(parent_name), injections_query, &mat, source);
+            if let (Some(language_name), Some(content_node)) = (
+                language_name,
+                content_node.filter(|node| node.end_byte() > byte_range.start),
+            ) {
+                let ranges =
+                    HighlightIterLayer::intersect_ranges(ranges, &[content_node], include_children);
+                if !ranges.is_empty() {
+                    injections.push((language_name.to_string(), ranges));
+                }
+            }
+        }
+        cursor.set_byte_range(0..usize::MAX);
+    }
+    Ok(Some((tree, injections)))
+}
+
+fn config_key(config: &HighlightConfiguration) -> usize {
+    config as *const HighlightConfiguration as usize
+}
+
+// Normalize the byte range that is passed to a highlighting iterator, so that a range which
+// extends to the end of the source code remains unbounded.
+fn highlight_byte_range(range: ops::Range<usize>, source_len: usize) -> ops::Range<usize> {
+    if range.end < source_len {
+        range.start.min(range.end)..range.end
+    } else {
+        range.start.min(source_len)..usize::MAX
+    }
+}
+
+// Compute the position of a range after an edit, in the same way that the included
+// ranges of a syntax tree are edited.
+fn edit_range(range: &ops::Range<usize>, edit: &InputEdit) -> ops::Range<usize> {
+    let edit_offset = |offset: usize| {
+        if offset >= edit.old_end_byte {
+            edit.new_end_byte.saturating_add(offset - edit.old_end_byte)
+        } else if offset > edit.start_byte {
+            edit.start_byte
+        } else {
+            offset
+        }
+    };
+    edit_offset(range.start)..edit_offset(range.end)
+}
+
+fn write_u32(data: &mut Vec<u8>, value: u32) {
+    data.extend_from_slice(&value.to_le_bytes());
+}
+
+// Write a length-prefixed byte string, using the maximum length to represent `None`.
+fn write_bytes(data: &mut Vec<u8>, bytes: Option<&[u8]>) {
+    match bytes {
+        Some(bytes) => {
+            write_u32(data, bytes.len() as u32);
+            data.extend_from_slice(bytes);
+        }
+        None => write_u32(data, u32::MAX),
+    }
+}
+
+fn read_u32(data: &mut &[u8]) -> Option<u32> {
+    if data.len() < 4 {
+        return None;
+    }
+    let (bytes, rest) = data.split_at(4);
+    *data = rest;
+    Some(u32::from_le_bytes(bytes.try_into().unwrap()))
+}
+
+fn read_bytes<'a>(data: &mut &'a [u8]) -> Option<Option<&'a [u8]>> {
+    let len = read_u32(data)?;
+    if len == u32::MAX {
+        return Some(None);
+    }
+    let len = len as usize;
+    if len > data.len() {
+        return None;
+    }
+    let (bytes, rest) = data.split_at(len);
+    *data = rest;
+    Some(Some(bytes))
+}
+
+const fn ranges_intersect(a: &ops::Range<usize>, b: &ops::Range<usize>) -> bool {
+    a.start <= b.end && b.start <= a.end
+}
+
 fn shrink_and_clear<T>(vec: &mut Vec<T>, capacity: usize) {
     if vec.len() > capacity {
         vec.truncate(capacity);
@@ -37,6 +37,8 @@ pub struct TSLookaheadIterator {
 }
 pub const TSInputEncodingUTF8: TSInputEncoding = 0;
 pub const TSInputEncodingUTF16: TSInputEncoding = 1;
+pub const TSInputEncodingLatin1: TSInputEncoding = 2;
+pub const TSInputEncodingUTF16BE: TSInputEncoding = 3;
 pub type TSInputEncoding = ::std::os::raw::c_uint;
 pub const TSSymbolTypeRegular: TSSymbolType = 0;
 pub const TSSymbolTypeAnonymous: TSSymbolType = 1;
@@ -70,6 +72,13 @@ pub struct TSInput {
     >,
     pub encoding: TSInputEncoding,
 }
+#[repr(C)]
+#[derive(Debug, Copy, Clone)]
+pub struct TSInputSegment {
+    pub start_byte: u32,
+    pub string: *const ::std::os::raw::c_char,
+    pub length: u32,
+}
 pub const TSLogTypeParse: TSLogType = 0;
 pub const TSLogTypeLex: TSLogType = 1;
 pub type TSLogType = ::std::os::raw::c_uint;
@@ -109,6 +118,26 @@ pub struct TSTreeCursor {
     pub id: *const ::std::os::raw::c_void,
     pub context: [u32; 3usize],
 }
+pub const TSFlatNodeFlagNamed: TSFlatNodeFlag = 1;
+pub const TSFlatNodeFlagExtra: TSFlatNodeFlag = 2;
+pub const TSFlatNodeFlagMissing: TSFlatNodeFlag = 4;
+pub const TSFlatNodeFlagError: TSFlatNodeFlag = 8;
+pub const TSFlatNodeFlagHasError: TSFlatNodeFlag = 16;
+pub const TSFlatNodeFlagHasChanges: TSFlatNodeFlag = 32;
+pub type TSFlatNodeFlag = ::std::os::raw::c_uint;
+#[repr(C)]
+#[derive(Debug, Copy, Clone)]
+pub struct TSFlatNode {
+    pub symbol: TSSymbol,
+    pub field_id: TSFieldId,
+    pub flags: u32,
+    pub start_byte: u32,
+    pub end_byte: u32,
+    pub start_point: TSPoint,
+    pub end_point: TSPoint,
+    pub parent_index: u32,
+    pub descendant_count: u32,
+}
 #[repr(C)]
 #[derive(Debug)]
 pub struct TSQueryCapture {
@@ -176,7 +205,7 @@ extern "C" {
     pub fn ts_parser_included_ranges(self_: *const TSParser, count: *mut u32) -> *const TSRange;
 }
 extern "C" {
-    #[doc = " Use the parser to parse some source code and create a syntax tree.\n\n If you are parsing this document for the first time, pass `NULL` for the\n `old_tree` parameter. Otherwise, if you have already parsed an earlier\n version of this document and the document has since been edited, pass the\n previous syntax tree so that the unchanged parts of it can be reused.\n This will save time and memory. For this to work correctly, you must have\n already edited the old syntax tree using the [`ts_tree_edit`] function in a\n way that exactly matches the source code changes.\n\n The [`TSInput`] parameter lets you specify how to read the text. It has the\n following three fields:\n 1. [`read`]: A function to retrieve a chunk of text at a given byte offset\n    and (row, column) position. The function should return a pointer to the\n    text and write its length to the [`bytes_read`] pointer. The parser does\n    not take ownership of this buffer; it just borrows it until it has\n    finished reading it. The function should write a zero value to the\n    [`bytes_read`] pointer to indicate the end of the document.\n 2. [`payload`]: An arbitrary pointer that will be passed to each invocation\n    of the [`read`] function.\n 3. [`encoding`]: An indication of how the text is encoded. Either\n    `TSInputEncodingUTF8` or `TSInputEncodingUTF16`.\n\n This function returns a syntax tree on success, and `NULL` on failure. There\n are three possible reasons for failure:\n 1. The parser does not have a language assigned. Check for this using the\n[`ts_parser_language`] function.\n 2. Parsing was cancelled due to a timeout that was set by an earlier call to\n    the [`ts_parser_set_timeout_micros`] function. You can resume parsing from\n    where the parser left out by calling [`ts_parser_parse`] again with the\n    same arguments. Or you can start parsing from scratch by first calling\n    [`ts_parser_reset`].\n 3. Parsing was cancelled using a cancellation flag that was set by an\n    earlier call to [`ts_parser_set_cancellation_flag`]. You can resume parsing\n    from where the parser left out by calling [`ts_parser_parse`] again with\n    the same arguments.\n\n [`read`]: TSInput::read\n [`payload`]: TSInput::payload\n [`encoding`]: TSInput::encoding\n [`bytes_read`]: TSInput::read"]
+    #[doc = " Use the parser to parse some source code and create a syntax tree.\n\n If you are parsing this document for the first time, pass `NULL` for the\n `old_tree` parameter. Otherwise, if you have already parsed an earlier\n version of this document and the document has since been edited, pass the\n previous syntax tree so that the unchanged parts of it can be reused.\n This will save time and memory. For this to work correctly, you must have\n already edited the old syntax tree using the [`ts_tree_edit`] function in a\n way that exactly matches the source code changes.\n\n The [`TSInput`] parameter lets you specify how to read the text. It has the\n following three fields:\n 1. [`read`]: A function to retrieve a chunk of text at a given byte offset\n    and (row, column) position. The function should return a pointer to the\n    text and write its length to the [`bytes_read`] pointer. The parser does\n    not take ownership of this buffer; it just borrows it until it has\n    finished reading it. The function should write a zero value to the\n    [`bytes_read`] pointer to indicate the end of the document.\n 2. [`payload`]: An arbitrary pointer that will be passed to each invocation\n    of the [`read`] function.\n 3. [`encoding`]: An indication of how the text is encoded. Either\n    `TSInputEncodingUTF8`, `TSInputEncodingUTF16` (little-endian),\n    `TSInputEncodingUTF16BE` or `TSInputEncodingLatin1` (ISO-8859-1). Byte\n    offsets always refer to the text in its original encoding.\n\n This function returns a syntax tree on success, and `NULL` on failure. There\n are three possible reasons for failure:\n 1. The parser does not have a language assigned. Check for this using the\n[`ts_parser_language`] function.\n 2. Parsing was cancelled due to a timeout that was set by an earlier call to\n    the [`ts_parser_set_timeout_micros`] function. You can resume parsing from\n    where the parser left out by calling [`ts_parser_parse`] again with the\n    same arguments. Or you can start parsing from scratch by first calling\n    [`ts_parser_reset`].\n 3. Parsing was cancelled using a cancellation flag that was set by an\n    earlier call to [`ts_parser_set_cancellation_flag`]. You can resume parsing\n    from where the parser left out by calling [`ts_parser_parse`] again with\n    the same arguments.\n\n [`read`]: TSInput::read\n [`payload`]: TSInput::payload\n [`encoding`]: TSInput::encoding\n [`bytes_read`]: TSInput::read"]
     pub fn ts_parser_parse(
         self_: *mut TSParser,
         old_tree: *const TSTree,
@@ -193,7 +222,7 @@ extern "C" {
     ) -> *mut TSTree;
 }
 extern "C" {
-    #[doc = " Use the parser to parse some source code stored in one contiguous buffer with\n a given encoding. The first four parameters work the same as in the\n [`ts_parser_parse_string`] method above. The final parameter indicates whether\n the text is encoded as UTF8 or UTF16."]
+    #[doc = " Use the parser to parse some source code stored in one contiguous buffer with\n a given encoding. The first four parameters work the same as in the\n [`ts_parser_parse_string`] method above. The final parameter indicates whether\n the text is encoded as UTF8, UTF16, UTF16BE or Latin1."]
     pub fn ts_parser_parse_string_encoding(
         self_: *mut TSParser,
         old_tree: *const TSTree,
@@ -202,6 +231,16 @@ extern "C" {
         encoding: TSInputEncoding,
     ) -> *mut TSTree;
 }
+extern "C" {
+    #[doc = " Use the parser to parse some source code that is stored in several separate\n buffers, such as the chunks of a rope. The first two parameters are the same\n as in the [`ts_parser_parse`] function above.\n\n The segments must be ordered by their start byte, and each segment must\n begin where the previous one ends. The parser reads the segments in order\n while it lexes, and only searches for a segment when it needs to move back\n to an earlier position, so this avoids looking up the text for every chunk\n that the parser reads through a [`TSInput`] callback."]
+    pub fn ts_parser_parse_segments(
+        self_: *mut TSParser,
+        old_tree: *const TSTree,
+        segments: *const TSInputSegment,
+        segment_count: u32,
+        encoding: TSInputEncoding,
+    ) -> *mut TSTree;
+}
 extern "C" {
     #[doc = " Instruct the parser to start the next parse from the beginning.\n\n If the parser previously failed because of a timeout or a cancellation, then\n by default, it will resume where it left off on the next call to\n [`ts_parser_parse`] or other parsing functions. If you don't want to resume,\n and instead intend to use this parser to parse some other document, you must\n call [`ts_parser_reset`] first."]
     pub fn ts_parser_reset(self_: *mut TSParser);
@@ -385,6 +424,24 @@ extern "C" {
     #[doc = " Get the node's number of *named* children.\n\n See also [`ts_node_is_named`]."]
     pub fn ts_node_named_child_count(self_: TSNode) -> u32;
 }
+extern "C" {
+    #[doc = " Write up to `capacity` of the node's children into `children`, starting\n with the child at `start_index`. Returns the number of nodes written.\n\n Fetching a range of children this way finds the starting child once and\n then advances through its siblings, so reading every child costs time\n proportional to the child count, unlike repeated calls to [`ts_node_child`]."]
+    pub fn ts_node_children(
+        self_: TSNode,
+        start_index: u32,
+        children: *mut TSNode,
+        capacity: u32,
+    ) -> u32;
+}
+extern "C" {
+    #[doc = " Write up to `capacity` of the node's *named* children into `children`,\n starting with the named child at `start_index`. Returns the number of nodes\n written.\n\n See also [`ts_node_children`]."]
+    pub fn ts_node_named_children(
+        self_: TSNode,
+        start_index: u32,
+        children: *mut TSNode,
+        capacity: u32,
+    ) -> u32;
+}
 extern "C" {
     #[doc = " Get the node's child with the given field name."]
     pub fn ts_node_child_by_field_name(
@@ -397,6 +454,10 @@ extern "C" {
     #[doc = " Get the node's child with the given numerical field id.\n\n You can convert a field name to an id using the\n [`ts_language_field_id_for_name`] function."]
     pub fn ts_node_child_by_field_id(self_: TSNode, field_id: TSFieldId) -> TSNode;
 }
+extern "C" {
+    #[doc = " Get the node's child for every field in a single pass over its children.\n\n The `children` array is indexed by field id and must have room for\n `length` nodes. Each entry is set to the same node that\n [`ts_node_child_by_field_id`] would return for that field, or to a null\n node if the field is not present. Fields whose ids are not less than\n `length` are ignored, so passing [`ts_language_field_count`] + 1 covers\n every field. Returns the number of fields that were found."]
+    pub fn ts_node_field_children(self_: TSNode, children: *mut TSNode, length: u32) -> u32;
+}
 extern "C" {
     #[doc = " Get the node's next / previous sibling."]
     pub fn ts_node_next_sibling(self_: TSNode) -> TSNode;
@@ -453,6 +514,25 @@ extern "C" {
     #[doc = " Check if two nodes are identical."]
     pub fn ts_node_eq(self_: TSNode, other: TSNode) -> bool;
 }
+extern "C" {
+    #[doc = " Write the node and its descendants into a caller-provided array, in\n pre-order, using a single traversal.\n\n The node itself is always written first. Each entry records the node's\n symbol, the field id under which it appears in its parent, a bitmask of\n [`TSFlatNodeFlag`] values, its byte and point range, the index of its\n parent entry, and the number of entries that follow it in the array\n which belong to its subtree. The first entry's `parent_index` is\n `UINT32_MAX`, and its `field_id` is zero.\n\n If `named_only` is true, anonymous nodes are omitted, and their named\n descendants are attached to the nearest written ancestor. Nodes deeper than\n `max_depth` levels below the given node are omitted along with their\n subtrees. Pass `UINT32_MAX` to visit the entire subtree.\n\n At most `capacity` entries are written, and the number of entries written\n is returned. The result of [`ts_node_descendant_count`] is always a\n sufficient capacity. If the capacity is too small, the array contains a\n prefix of the full traversal."]
+    pub fn ts_node_flatten(
+        self_: TSNode,
+        named_only: bool,
+        max_depth: u32,
+        nodes: *mut TSFlatNode,
+        capacity: u32,
+    ) -> u32;
+}
+extern "C" {
+    #[doc = " Split the node's subtree into units of work that can be traversed\n independently, for example on separate threads.\n\n Each unit is the root of a subtree with at most `max_unit_size` nodes,\n as counted by [`ts_node_descendant_count`]. Units are chosen as high in\n the tree as possible, so every node in the subtree either belongs to\n exactly one unit or is an ancestor of one. The units are written to\n `units` in document order.\n\n At most `capacity` units are written, but the total number of units is\n always returned, so a caller can retry with a larger buffer."]
+    pub fn ts_node_partition(
+        self_: TSNode,
+        max_unit_size: u32,
+        units: *mut TSNode,
+        capacity: u32,
+    ) -> u32;
+}
 extern "C" {
     #[doc = " Create a new tree cursor starting from the given node.\n\n A tree cursor allows you to walk a syntax tree more efficiently than is\n possible using the [`TSNode`] functions. It is a mutable object that is always\n on a certain syntax node, and can be moved imperatively to different nodes."]
     pub fn ts_tree_cursor_new(node: TSNode) -> TSTreeCursor;
@@ -507,6 +587,17 @@ extern "C" {
     #[doc = " Move the cursor to the node that is the nth descendant of\n the original node that the cursor was constructed with, where\n zero represents the original node itself."]
     pub fn ts_tree_cursor_goto_descendant(self_: *mut TSTreeCursor, goal_descendant_index: u32);
 }
+extern "C" {
+    #[doc = " Move the cursor to the deepest node that contains the given byte offset or\n point, out of the descendants of the original node that the cursor was\n constructed with.\n\n This lands on the same node as [`ts_node_descendant_for_byte_range`] or\n [`ts_node_descendant_for_point_range`] with an empty range. The cursor only\n climbs as far as the lowest ancestor of its current node that contains the\n goal, so moving to a nearby position is cheaper than starting from the\n original node."]
+    pub fn ts_tree_cursor_goto_descendant_for_byte(self_: *mut TSTreeCursor, goal_byte: u32);
+}
+extern "C" {
+    pub fn ts_tree_cursor_goto_descendant_for_point(self_: *mut TSTreeCursor, goal_point: TSPoint);
+}
+extern "C" {
+    #[doc = " Move the cursor to the next node in a pre-order traversal of the original\n node that the cursor was constructed with. This is the node whose\n descendant index is one greater than the current node's.\n\n This returns `true` if the cursor successfully moved, and returns `false`\n once every descendant has been visited, leaving the cursor on the original\n node. This visits the same nodes as combining\n [`ts_tree_cursor_goto_first_child`], [`ts_tree_cursor_goto_next_sibling`]\n and [`ts_tree_cursor_goto_parent`], but takes a single call per node."]
+    pub fn ts_tree_cursor_goto_next_descendant(self_: *mut TSTreeCursor) -> bool;
+}
 extern "C" {
     #[doc = " Get the index of the cursor's current node out of all of the\n descendants of the original node that the cursor was constructed with."]
     pub fn ts_tree_cursor_current_descendant_index(self_: *const TSTreeCursor) -> u32;
@@ -545,6 +636,21 @@ extern "C" {
     #[doc = " Delete a query, freeing all of the memory that it used."]
     pub fn ts_query_delete(self_: *mut TSQuery);
 }
+extern "C" {
+    #[doc = " Serialize a query into a buffer, so that it can be recreated later with\n [`ts_query_deserialize`] without recompiling its source.\n\n The buffer is allocated with the library's allocator, so it should be freed\n with the same `free` function that the library is using. Its length is\n written to the `length` parameter."]
+    pub fn ts_query_serialize(
+        self_: *const TSQuery,
+        length: *mut u32,
+    ) -> *mut ::std::os::raw::c_char;
+}
+extern "C" {
+    #[doc = " Recreate a query from a buffer that was written by [`ts_query_serialize`],\n using the same language.\n\n This returns `NULL` if the buffer is malformed, or if it was written for a\n language with a different ABI version or number of symbols or fields, or in\n a different version of the serialization format. The buffer doesn't record\n which version of the library wrote it, so a buffer should only be used with\n the version of the library that wrote it. Every index that the buffer\n contains is checked against the query's own arrays and the language, so a\n corrupted buffer is rejected rather than read out of bounds."]
+    pub fn ts_query_deserialize(
+        language: *const TSLanguage,
+        data: *const ::std::os::raw::c_char,
+        length: u32,
+    ) -> *mut TSQuery;
+}
 extern "C" {
     #[doc = " Get the number of patterns, captures, or string literals in the query."]
     pub fn ts_query_pattern_count(self_: *const TSQuery) -> u32;
@@ -1,6 +1,8 @@
 #![doc = include_str!("./README.md")]
 
 pub mod ffi;
+mod parallel;
+mod pool;
 mod util;
 
 #[cfg(any(unix, target_os = "wasi"))]
@@ -22,6 +24,9 @@ use std::{
     sync::atomic::AtomicUsize,
 };
 
+pub use parallel::ParallelVisitor;
+pub use pool::{ParserPool, PooledParser};
+
 #[cfg(feature = "wasm")]
 mod wasm_language;
 #[cfg(feature = "wasm")]
@@ -95,6 +100,12 @@ pub struct InputEdit {
 #[repr(transparent)]
 pub struct Node<'tree>(ffi::TSNode, PhantomData<&'tree ()>);
 
+/// A summary of a single node, produced by [`Node::flatten`].
+#[doc(alias = "TSFlatNode")]
+#[derive(Clone, Copy)]
+#[repr(transparent)]
+pub struct FlatNode(ffi::TSFlatNode);
+
 /// A stateful object that this is used to produce a [`Tree`] based on some
 /// source code.
 #[doc(alias = "TSParser")]
@@ -705,6 +716,108 @@ impl Parser {
         }
     }
 
+    /// Parse a slice of Latin-1 (ISO-8859-1) text.
+    ///
+    /// Each byte of the text is decoded as a single character, and the byte
+    /// offsets of the resulting nodes refer to the original text.
+    ///
+    /// # Arguments:
+    /// * `text` The Latin-1-encoded text to parse.
+    /// * `old_tree` A previous syntax tree parsed from the same document. If the text of the
+    ///   document has changed since `old_tree` was created, then you must edit `old_tree` to match
+    ///   the new text using [`Tree::edit`].
+    #[doc(alias = "ts_parser_parse_string_encoding")]
+    pub fn parse_latin1(
+        &mut self,
+        text: impl AsRef<[u8]>,
+        old_tree: Option<&Tree>,
+    ) -> Option<Tree> {
+        self.parse_encoding(text.as_ref(), old_tree, ffi::TSInputEncodingLatin1)
+    }
+
+    /// Parse a slice of big-endian UTF16 text, without converting it to the
+    /// platform's byte order.
+    ///
+    /// # Arguments:
+    /// * `text` The bytes of the UTF16BE-encoded text to parse.
+    /// * `old_tree` A previous syntax tree parsed from the same document. If the text of the
+    ///   document has changed since `old_tree` was created, then you must edit `old_tree` to match
+    ///   the new text using [`Tree::edit`].
+    #[doc(alias = "ts_parser_parse_string_encoding")]
+    pub fn parse_utf16_be(
+        &mut self,
+        text: impl AsRef<[u8]>,
+        old_tree: Option<&Tree>,
+    ) -> Option<Tree> {
+        self.parse_encoding(text.as_ref(), old_tree, ffi::TSInputEncodingUTF16BE)
+    }
+
+    fn parse_encoding(
+        &mut self,
+        text: &[u8],
+        old_tree: Option<&Tree>,
+        encoding: ffi::TSInputEncoding,
+    ) -> Option<Tree> {
+        let c_old_tree = old_tree.map_or(ptr::null_mut(), |t| t.0.as_ptr());
+        unsafe {
+            let c_new_tree = ffi::ts_parser_parse_string_encoding(
+                self.0.as_ptr(),
+                c_old_tree,
+                text.as_ptr().cast::<c_char>(),
+                text.len() as u32,
+                encoding,
+            );
+            NonNull::new(c_new_tree).map(Tree)
+        }
+    }
+
+    /// Parse UTF8 text that is stored in several separate buffers, such as the
+    /// chunks of a rope.
+    ///
+    /// This is equivalent to calling [`parse`](Parser::parse) with the
+    /// concatenation of `segments`, but avoids both copying the text and
+    /// looking up the segment for every chunk that the parser reads, as
+    /// [`parse_with`](Parser::parse_with) would.
+    ///
+    /// # Arguments:
+    /// * `segments` The UTF8-encoded text to parse, in order.
+    /// * `old_tree` A previous syntax tree parsed from the same document. If the text of the
+    ///   document has changed since `old_tree` was created, then you must edit `old_tree` to match
+    ///   the new text using [`Tree::edit`].
+    #[doc(alias = "ts_parser_parse_segments")]
+    pub fn parse_segments<T: AsRef<[u8]>>(
+        &mut self,
+        segments: &[T],
+        old_tree: Option<&Tree>,
+    ) -> Option<Tree> {
+        let mut start_byte = 0;
+        let c_segments = segments
+            .iter()
+            .map(|segment| {
+                let segment = segment.as_ref();
+                let c_segment = ffi::TSInputSegment {
+                    start_byte,
+                    string: segment.as_ptr().cast::<c_char>(),
+                    length: segment.len() as u32,
+                };
+                start_byte += segment.len() as u32;
+                c_segment
+            })
+            .collect::<Vec<_>>();
+
+        let c_old_tree = old_tree.map_or(ptr::null_mut(), |t| t.0.as_ptr());
+        unsafe {
+            let c_new_tree = ffi::ts_parser_parse_segments(
+                self.0.as_ptr(),
+                c_old_tree,
+                c_segments.as_ptr(),
+                c_segments.len() as u32,
+                ffi::TSInputEncodingUTF8,
+            );
+            NonNull::new(c_new_tree).map(Tree)
+        }
+    }
+
     /// Instruct the parser to start the next parse from the beginning.
     ///
     /// If the parser previously failed because of a timeout or a cancellation,
@@ -1218,6 +1331,24 @@ impl<'tree> Node<'tree> {
         Self::new(unsafe { ffi::ts_node_child_by_field_id(self.0, field_id) })
     }
 
+    /// Get this node's child for every field, indexed by field id.
+    ///
+    /// The returned vector has [`Language::field_count`] + 1 entries, and
+    /// each entry holds the node that [`Node::child_by_field_id`] would return
+    /// for that id. All of the fields are resolved in a single pass over the
+    /// node's children, which is cheaper than looking them up one at a time.
+    #[doc(alias = "ts_node_field_children")]
+    #[must_use]
+    pub fn field_children(&self) -> Vec<Option<Self>> {
+        let length = self.language().field_count() + 1;
+        let mut children = Vec::<ffi::TSNode>::with_capacity(length);
+        unsafe {
+            ffi::ts_node_field_children(self.0, children.as_mut_ptr(), length as u32);
+            children.set_len(length);
+        }
+        children.into_iter().map(Self::new).collect()
+    }
+
     /// Get the field name of this node's child at the given index.
     #[doc(alias = "ts_node_field_name_for_child")]
     #[must_use]
@@ -1271,6 +1402,55 @@ impl<'tree> Node<'tree> {
         })
     }
 
+    /// Get the children of this node whose indices fall within the given range.
+    ///
+    /// Unlike calling [`Node::child`] for each index, this locates the first
+    /// child once and then moves through its siblings, so it stays cheap for
+    /// nodes with a very large number of children.
+    #[doc(alias = "ts_node_children")]
+    #[must_use]
+    pub fn child_range(&self, range: ops::Range<usize>) -> Vec<Self> {
+        let capacity = range
+            .end
+            .min(self.child_count())
+            .saturating_sub(range.start);
+        let mut result = Vec::<Self>::with_capacity(capacity);
+        unsafe {
+            let count = ffi::ts_node_children(
+                self.0,
+                range.start as u32,
+                result.as_mut_ptr().cast::<ffi::TSNode>(),
+                capacity as u32,
+            );
+            result.set_len(count as usize);
+        }
+        result
+    }
+
+    /// Get the *named* children of this node whose named indices fall within
+    /// the given range.
+    ///
+    /// See also [`Node::child_range`].
+    #[doc(alias = "ts_node_named_children")]
+    #[must_use]
+    pub fn named_child_range(&self, range: ops::Range<usize>) -> Vec<Self> {
+        let capacity = range
+            .end
+            .min(self.named_child_count())
+            .saturating_sub(range.start);
+        let mut result = Vec::<Self>::with_capacity(capacity);
+        unsafe {
+            let count = ffi::ts_node_named_children(
+                self.0,
+                range.start as u32,
+                result.as_mut_ptr().cast::<ffi::TSNode>(),
+                capacity as u32,
+            );
+            result.set_len(count as usize);
+        }
+        result
+    }
+
     /// Iterate over this node's children with a given field name.
     ///
     /// See also [`Node::children`].
@@ -1445,6 +1625,34 @@ impl<'tree> Node<'tree> {
         TreeCursor(unsafe { ffi::ts_tree_cursor_new(self.0) }, PhantomData)
     }
 
+    /// Summarize this node and its descendants in pre-order, using a single
+    /// traversal.
+    ///
+    /// The first element describes this node. Each element records the index
+    /// of its parent element and the number of elements that make up its
+    /// subtree, so the result can be used as a compact table of the tree.
+    ///
+    /// If `named_only` is true, anonymous nodes are left out. Nodes more than
+    /// `max_depth` levels below this node are left out, along with their
+    /// subtrees.
+    #[doc(alias = "ts_node_flatten")]
+    #[must_use]
+    pub fn flatten(&self, named_only: bool, max_depth: Option<u32>) -> Vec<FlatNode> {
+        let capacity = self.descendant_count();
+        let mut result = Vec::<FlatNode>::with_capacity(capacity);
+        unsafe {
+            let count = ffi::ts_node_flatten(
+                self.0,
+                named_only,
+                max_depth.unwrap_or(u32::MAX),
+                result.as_mut_ptr().cast::<ffi::TSFlatNode>(),
+                capacity as u32,
+            );
+            result.set_len(count as usize);
+        }
+        result
+    }
+
     /// Edit this node to keep it in-sync with source code that has been edited.
     ///
     /// This function is only rarely needed. When you edit a syntax tree with
@@ -1502,6 +1710,104 @@ impl fmt::Display for Node<'_> {
     }
 }
 
+impl FlatNode {
+    /// Get the numerical id of this node's type.
+    #[must_use]
+    pub const fn kind_id(&self) -> u16 {
+        self.0.symbol
+    }
+
+    /// Get the id of the field under which this node appears in its parent.
+    #[must_use]
+    pub const fn field_id(&self) -> Option<FieldId> {
+        FieldId::new(self.0.field_id)
+    }
+
+    /// Get the index of this node's parent within the flattened array.
+    #[must_use]
+    pub const fn parent_index(&self) -> Option<usize> {
+        if self.0.parent_index == u32::MAX {
+            None
+        } else {
+            Some(self.0.parent_index as usize)
+        }
+    }
+
+    /// Get the number of elements following this one in the flattened array
+    /// that belong to this node's subtree.
+    #[must_use]
+    pub const fn descendant_count(&self) -> usize {
+        self.0.descendant_count as usize
+    }
+
+    #[must_use]
+    pub const fn is_named(&self) -> bool {
+        self.0.flags & ffi::TSFlatNodeFlagNamed != 0
+    }
+
+    #[must_use]
+    pub const fn is_extra(&self) -> bool {
+        self.0.flags & ffi::TSFlatNodeFlagExtra != 0
+    }
+
+    #[must_use]
+    pub const fn is_missing(&self) -> bool {
+        self.0.flags & ffi::TSFlatNodeFlagMissing != 0
+    }
+
+    #[must_use]
+    pub const fn is_error(&self) -> bool {
+        self.0.flags & ffi::TSFlatNodeFlagError != 0
+    }
+
+    #[must_use]
+    pub const fn has_error(&self) -> bool {
+        self.0.flags & ffi::TSFlatNodeFlagHasError != 0
+    }
+
+    #[must_use]
+    pub const fn has_changes(&self) -> bool {
+        self.0.flags & ffi::TSFlatNodeFlagHasChanges != 0
+    }
+
+    #[must_use]
+    pub const fn start_byte(&self) -> usize {
+        self.0.start_byte as usize
+    }
+
+    #[must_use]
+    pub const fn end_byte(&self) -> usize {
+        self.0.end_byte as usize
+    }
+
+    #[must_use]
+    pub const fn byte_range(&self) -> std::ops::Range<usize> {
+        self.start_byte()..self.end_byte()
+    }
+
+    #[must_use]
+    pub fn start_position(&self) -> Point {
+        self.0.start_point.into()
+    }
+
+    #[must_use]
+    pub fn end_position(&self) -> Point {
+        self.0.end_point.into()
+    }
+}
+
+impl fmt::Debug for FlatNode {
+    fn fmt(&self, f: &mut fmt::Formatter) -> fmt::Result {
+        write!(
+            f,
+            "{{FlatNode {} {} - {}}}",
+            self.kind_id(),
+            self.start_position(),
+            self.end_position()
+        )
+    }
+}
+
 impl<'cursor> TreeCursor<'cursor> {
     /// Get the tree cursor's current [`Node`].
     #[doc(alias = "ts_tree_cursor_current_node")]
@@ -1599,6 +1905,42 @@ impl<'cursor> TreeCursor<'cursor> {
         unsafe { ffi::ts_tree_cursor_goto_descendant(&mut self.0, descendant_index as u32) }
     }
 
+    /// Move this cursor to the deepest node that contains the given byte
+    /// offset, out of the descendants of the original node that the cursor
+    /// was constructed with.
+    ///
+    /// This lands on the same node as
+    /// [`Node::descendant_for_byte_range`] with an empty range, but only
+    /// climbs as far as the lowest ancestor of the current node that contains
+    /// the offset, so moving to a nearby position is cheap.
+    #[doc(alias = "ts_tree_cursor_goto_descendant_for_byte")]
+    pub fn goto_descendant_for_byte(&mut self, byte: usize) {
+        unsafe { ffi::ts_tree_cursor_goto_descendant_for_byte(&mut self.0, byte as u32) }
+    }
+
+    /// Move this cursor to the deepest node that contains the given point.
+    ///
+    /// See [`goto_descendant_for_byte`](TreeCursor::goto_descendant_for_byte).
+    #[doc(alias = "ts_tree_cursor_goto_descendant_for_point")]
+    pub fn goto_descendant_for_point(&mut self, point: Point) {
+        unsafe { ffi::ts_tree_cursor_goto_descendant_for_point(&mut self.0, point.into()) }
+    }
+
+    /// Move this cursor to the next node in a pre-order traversal of the
+    /// original node that the cursor was constructed with.
+    ///
+    /// This returns `true` if the cursor successfully moved, and returns
+    /// `false` once every descendant has been visited, leaving the cursor on
+    /// the original node. This visits the same nodes as combining
+    /// [`goto_first_child`](TreeCursor::goto_first_child),
+    /// [`goto_next_sibling`](TreeCursor::goto_next_sibling) and
+    /// [`goto_parent`](TreeCursor::goto_parent), but takes a single call per
+    /// node.
+    #[doc(alias = "ts_tree_cursor_goto_next_descendant")]
+    pub fn goto_next_descendant(&mut self) -> bool {
+        unsafe { ffi::ts_tree_cursor_goto_next_descendant(&mut self.0) }
+    }
+
     /// Move this cursor to the previous sibling of its current node.
     ///
     /// This returns `true` if the cursor successfully moved, and returns
@@ -1844,6 +2186,70 @@ impl Query {
         unsafe { Self::from_raw_parts(ptr, source) }
     }
 
+    /// Serialize the query, so that it can be recreated with [`Query::deserialize`]
+    /// without compiling its source again.
+    #[doc(alias = "ts_query_serialize")]
+    #[must_use]
+    pub fn serialize(&self) -> Vec<u8> {
+        let mut length = 0u32;
+        unsafe {
+            let ptr = ffi::ts_query_serialize(self.ptr.as_ptr(), std::ptr::addr_of_mut!(length));
+            let result = slice::from_raw_parts(ptr.cast::<u8>(), length as usize).to_vec();
+            (FREE_FN)(ptr.cast::<c_void>());
+            result
+        }
+    }
+
+    /// Recreate a query from data that was produced by [`Query::serialize`] for the same
+    /// language.
+    ///
+    /// Returns `None` if the data is malformed or corrupted, or if it was produced for a
+    /// language with a different ABI version or set of symbols, or in a different version
+    /// of the serialization format. The data doesn't record which version of this library
+    /// produced it, so it should only be deserialized by the same version.
+    #[doc(alias = "ts_query_deserialize")]
+    #[must_use]
+    pub fn deserialize(language: &Language, data: &[u8]) -> Option<Self> {
+        let length = u32::try_from(data.len()).ok()?;
+        let ptr = unsafe {
+            ffi::ts_query_deserialize(language.0, data.as_ptr().cast::<c_char>(), length)
+        };
+        if ptr.is_null() {
+            return None;
+        }
+
+        // Capture names and strings are assumed to be UTF-8 when the query is built,
+        // because they normally come from the query's source.
+        unsafe fn names_are_utf8(
+            ptr: *const ffi::TSQuery,
+            count: u32,
+            name_for_id: unsafe extern "C" fn(*const ffi::TSQuery, u32, *mut u32) -> *const c_char,
+        ) -> bool {
+            (0..count).all(|i| {
+                let mut length = 0u32;
+                let name = name_for_id(ptr, i, std::ptr::addr_of_mut!(length));
+                str::from_utf8(slice::from_raw_parts(name.cast::<u8>(), length as usize)).is_ok()
+            })
+        }
+        let is_utf8 = unsafe {
+            names_are_utf8(
+                ptr,
+                ffi::ts_query_capture_count(ptr),
+                ffi::ts_query_capture_name_for_id,
+            ) && names_are_utf8(
+                ptr,
+                ffi::ts_query_string_count(ptr),
+                ffi::ts_query_string_value_for_id,
+            )
+        };
+        if !is_utf8 {
+            unsafe { ffi::ts_query_delete(ptr) };
+            return None;
+        }
+
+        unsafe { Self::from_raw_parts(ptr, "") }.ok()
+    }
+
     #[doc(hidden)]
     unsafe fn from_raw_parts(ptr: *mut ffi::TSQuery, source: &str) -> Result<Self, QueryError> {
         let ptr = {
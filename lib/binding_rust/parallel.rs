@@ -0,0 +1,210 @@
+use std::{
+    num::NonZeroUsize,
+    ops,
+    sync::atomic::{AtomicUsize, Ordering},
+    thread,
+};
+
+use crate::{ffi, Node, TreeCursor};
+
+/// A set of callbacks for visiting a syntax tree on several threads.
+///
+/// See [`Node::visit_parallel`]. Every node is entered before its descendants
+/// and left after them, but disjoint subtrees are visited on different
+/// threads, so the callbacks for unrelated nodes can run concurrently and in
+/// any order. Each part of the tree is accumulated into its own
+/// [`Output`](ParallelVisitor::Output), and the partial outputs are then
+/// combined with [`reduce`](ParallelVisitor::reduce) in document order.
+pub trait ParallelVisitor<'tree>: Sync {
+    type Output: Default + Send;
+
+    /// Called for each node before any of its descendants are visited.
+    fn enter(&self, _node: Node<'tree>, _output: &mut Self::Output) {}
+
+    /// Called for each node after all of its descendants have been visited.
+    fn leave(&self, _node: Node<'tree>, _output: &mut Self::Output) {}
+
+    /// Combine the outputs of two consecutive parts of the tree, where `left`
+    /// precedes `right` in the document.
+    fn reduce(&self, left: Self::Output, right: Self::Output) -> Self::Output;
+}
+
+/// The number of work units to create for each thread, so that threads
+/// which finish early can pick up the remaining work.
+const UNITS_PER_THREAD: usize = 16;
+
+enum Part<T> {
+    Done(T),
+    Unit(usize),
+}
+
+impl<'tree> Node<'tree> {
+    /// Split this node's subtree into units of work that can be visited
+    /// independently.
+    ///
+    /// Each unit is the root of a subtree with at most `max_unit_size` nodes,
+    /// and the units are returned in document order. Every node of the
+    /// subtree either belongs to exactly one unit or is an ancestor of one.
+    #[doc(alias = "ts_node_partition")]
+    #[must_use]
+    pub fn partition(&self, max_unit_size: usize) -> Vec<Self> {
+        let max_unit_size = max_unit_size.clamp(1, u32::MAX as usize);
+        let mut units = Vec::<Self>::with_capacity(self.descendant_count() / max_unit_size + 1);
+        loop {
+            let count = unsafe {
+                ffi::ts_node_partition(
+                    self.0,
+                    max_unit_size as u32,
+                    units.as_mut_ptr().cast::<ffi::TSNode>(),
+                    units.capacity() as u32,
+                )
+            } as usize;
+            if count <= units.capacity() {
+                unsafe { units.set_len(count) };
+                return units;
+            }
+            units.reserve_exact(count);
+        }
+    }
+
+    /// Visit this node and all of its descendants using up to `thread_count`
+    /// threads, and return the combined output of the visitor.
+    ///
+    /// The subtree is split into many more units than there are threads
+    /// using [`Node::partition`], and each thread repeatedly claims the next
+    /// unvisited unit, so that the work stays balanced even if some subtrees
+    /// are much more expensive to visit than others. The nodes above the
+    /// units are visited on the calling thread.
+    pub fn visit_parallel<V: ParallelVisitor<'tree>>(
+        &self,
+        visitor: &V,
+        thread_count: NonZeroUsize,
+    ) -> V::Output {
+        let thread_count = thread_count.get();
+        let max_unit_size = self.descendant_count() / (thread_count * UNITS_PER_THREAD);
+        let units = self.partition(max_unit_size);
+        let chunks = chunk_units(&units, max_unit_size);
+
+        // Visit the nodes that enclose the units, recording where each unit's
+        // output belongs relative to theirs.
+        let mut parts = Vec::new();
+        let mut cursor = self.walk();
+        let mut next_unit = 0;
+        'walk: loop {
+            let node = cursor.node();
+            if units.get(next_unit) == Some(&node) {
+                parts.push(Part::Unit(next_unit));
+                next_unit += 1;
+            } else {
+                let mut output = V::Output::default();
+                visitor.enter(node, &mut output);
+                parts.push(Part::Done(output));
+                if cursor.goto_first_child() {
+                    continue;
+                }
+                let mut output = V::Output::default();
+                visitor.leave(node, &mut output);
+                parts.push(Part::Done(output));
+            }
+
+            while !cursor.goto_next_sibling() {
+                if !cursor.goto_parent() {
+                    break 'walk;
+                }
+                let mut output = V::Output::default();
+                visitor.leave(cursor.node(), &mut output);
+                parts.push(Part::Done(output));
+            }
+        }
+
+        let mut unit_outputs = (0..units.len()).map(|_| None).collect::<Vec<_>>();
+        let next_chunk = AtomicUsize::new(0);
+        let visit_chunks = || {
+            let mut cursor = self.walk();
+            let mut outputs = Vec::new();
+            loop {
+                let Some(chunk) = chunks.get(next_chunk.fetch_add(1, Ordering::Relaxed)) else {
+                    break;
+                };
+                for index in chunk.clone() {
+                    let mut output = V::Output::default();
+                    visit_subtree(visitor, &mut cursor, units[index], &mut output);
+                    outputs.push((index, output));
+                }
+            }
+            outputs
+        };
+
+        let worker_count = thread_count.min(chunks.len());
+        let outputs = if worker_count <= 1 {
+            visit_chunks()
+        } else {
+            thread::scope(|scope| {
+                let workers = (0..worker_count)
+                    .map(|_| scope.spawn(visit_chunks))
+                    .collect::<Vec<_>>();
+                workers
+                    .into_iter()
+                    .flat_map(|worker| worker.join().unwrap())
+                    .collect()
+            })
+        };
+        for (index, output) in outputs {
+            unit_outputs[index] = Some(output);
+        }
+
+        parts
+            .into_iter()
+            .map(|part| match part {
+                Part::Done(output) => output,
+                Part::Unit(index) => unit_outputs[index].take().unwrap(),
+            })
+            .reduce(|left, right| visitor.reduce(left, right))
+            .unwrap_or_default()
+    }
+}
+
+/// Group consecutive units into chunks of roughly `max_unit_size` nodes, so
+/// that small units are not claimed one at a time.
+fn chunk_units(units: &[Node], max_unit_size: usize) -> Vec<ops::Range<usize>> {
+    let mut chunks = Vec::new();
+    let mut start = 0;
+    let mut size = 0;
+    for (index, unit) in units.iter().enumerate() {
+        let unit_size = unit.descendant_count();
+        if size > 0 && size + unit_size > max_unit_size {
+            chunks.push(start..index);
+            start = index;
+            size = 0;
+        }
+        size += unit_size;
+    }
+    if start < units.len() {
+        chunks.push(start..units.len());
+    }
+    chunks
+}
+
+fn visit_subtree<'tree, V: ParallelVisitor<'tree>>(
+    visitor: &V,
+    cursor: &mut TreeCursor<'tree>,
+    node: Node<'tree>,
+    output: &mut V::Output,
+) {
+    cursor.reset(node);
+    loop {
+        visitor.enter(cursor.node(), output);
+        if cursor.goto_first_child() {
+            continue;
+        }
+        loop {
+            visitor.leave(cursor.node(), output);
+            if cursor.goto_next_sibling() {
+                break;
+            }
+            if !cursor.goto_parent() {
+                return;
+            }
+        }
+    }
+}
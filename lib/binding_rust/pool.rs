@@ -0,0 +1,178 @@
+use std::{
+    collections::HashMap,
+    mem::ManuallyDrop,
+    ops::{Deref, DerefMut},
+    sync::Mutex,
+};
+
+use crate::{ffi, Language, LanguageError, Parser};
+
+/// A thread-safe collection of idle parsers, grouped by language.
+///
+/// Creating a parser allocates its parse stack, lexer and various scratch
+/// buffers, and these allocations grow to fit the documents that it parses.
+/// A pool lets many threads share a set of parsers whose buffers have already
+/// grown, instead of creating a new parser for every document.
+pub struct ParserPool {
+    idle: Mutex<IdleParsers>,
+    max_idle_count: usize,
+}
+
+#[derive(Default)]
+struct IdleParsers {
+    parsers: HashMap<usize, Vec<Parser>>,
+    count: usize,
+}
+
+/// A parser that has been borrowed from a [`ParserPool`].
+///
+/// The parser is reset and returned to the pool when this is dropped.
+pub struct PooledParser<'pool> {
+    parser: ManuallyDrop<Parser>,
+    pool: &'pool ParserPool,
+}
+
+impl ParserPool {
+    /// Create a new pool that retains at most `max_idle_count` idle parsers,
+    /// across all languages.
+    ///
+    /// Parsers that are returned to a full pool are deleted.
+    #[must_use]
+    pub fn new(max_idle_count: usize) -> Self {
+        Self {
+            idle: Mutex::new(IdleParsers::default()),
+            max_idle_count,
+        }
+    }
+
+    /// Take an idle parser for the given language from the pool, or create a
+    /// new one if there are none.
+    ///
+    /// Returns an error if a new parser was needed and the language could not
+    /// be assigned to it. See [`Parser::set_language`].
+    pub fn get(&self, language: &Language) -> Result<PooledParser<'_>, LanguageError> {
+        let parser = self.idle.lock().unwrap().take(language.0 as usize);
+        let parser = match parser {
+            Some(parser) => parser,
+            None => new_parser(language)?,
+        };
+        Ok(PooledParser {
+            parser: ManuallyDrop::new(parser),
+            pool: self,
+        })
+    }
+
+    /// Add idle parsers for the given language until there are at least
+    /// `count` of them, or until the pool is full.
+    pub fn reserve(&self, language: &Language, count: usize) -> Result<(), LanguageError> {
+        let key = language.0 as usize;
+        loop {
+            {
+                let idle = self.idle.lock().unwrap();
+                let language_count = idle.parsers.get(&key).map_or(0, Vec::len);
+                if language_count >= count || idle.count >= self.max_idle_count {
+                    return Ok(());
+                }
+            }
+            let parser = new_parser(language)?;
+            let rejected = self
+                .idle
+                .lock()
+                .unwrap()
+                .put(key, parser, self.max_idle_count);
+            if rejected.is_some() {
+                return Ok(());
+            }
+        }
+    }
+
+    /// Get the number of idle parsers that are currently in the pool.
+    #[must_use]
+    pub fn idle_count(&self) -> usize {
+        self.idle.lock().unwrap().count
+    }
+
+    /// Delete all of the idle parsers in the pool.
+    pub fn clear(&self) {
+        let parsers = std::mem::take(&mut *self.idle.lock().unwrap());
+        drop(parsers);
+    }
+
+    fn put(&self, mut parser: Parser) {
+        let language = unsafe { ffi::ts_parser_language(parser.0.as_ptr()) };
+        if language.is_null() {
+            return;
+        }
+
+        // Undo any configuration that the borrower may have applied, so
+        // that the next borrower receives a parser in its initial state.
+        parser.reset();
+        parser.set_timeout_micros(0);
+        parser.set_included_ranges(&[]).unwrap();
+        parser.set_logger(None);
+        parser.stop_printing_dot_graphs();
+        unsafe { parser.set_cancellation_flag(None) };
+
+        // Delete a parser that doesn't fit only after releasing the lock.
+        let rejected =
+            self.idle
+                .lock()
+                .unwrap()
+                .put(language as usize, parser, self.max_idle_count);
+        drop(rejected);
+    }
+}
+
+impl IdleParsers {
+    fn take(&mut self, key: usize) -> Option<Parser> {
+        let parser = self.parsers.get_mut(&key)?.pop()?;
+        self.count -= 1;
+        Some(parser)
+    }
+
+    fn put(&mut self, key: usize, parser: Parser, max_count: usize) -> Option<Parser> {
+        if self.count >= max_count {
+            return Some(parser);
+        }
+        self.parsers.entry(key).or_default().push(parser);
+        self.count += 1;
+        None
+    }
+}
+
+fn new_parser(language: &Language) -> Result<Parser, LanguageError> {
+    let mut parser = Parser::new();
+    parser.set_language(language)?;
+    Ok(parser)
+}
+
+impl PooledParser<'_> {
+    /// Take ownership of the parser, so that it is not returned to the pool.
+    #[must_use]
+    pub fn into_inner(mut self) -> Parser {
+        let parser = unsafe { ManuallyDrop::take(&mut self.parser) };
+        std::mem::forget(self);
+        parser
+    }
+}
+
+impl Deref for PooledParser<'_> {
+    type Target = Parser;
+
+    fn deref(&self) -> &Self::Target {
+        &self.parser
+    }
+}
+
+impl DerefMut for PooledParser<'_> {
+    fn deref_mut(&mut self) -> &mut Self::Target {
+        &mut self.parser
+    }
+}
+
+impl Drop for PooledParser<'_> {
+    fn drop(&mut self) {
+        let parser = unsafe { ManuallyDrop::take(&mut self.parser) };
+        self.pool.put(parser);
+    }
+}
@@ -738,6 +738,60 @@ void ts_node_descendants_of_type_wasm(
   TRANSFER_BUFFER[1] = result.contents;
 }
 
+// Each entry in a node batch starts with the five marshaled node slots,
+// followed by the node's end index and end position (already converted to
+// code units), its symbol, its field id, the index of its parent entry and
+// the number of entries that belong to its subtree.
+#define NODE_BATCH_STRIDE 12
+
+// Write the slots that node batches and query batches have in common.
+static void marshal_batch_node(const void **entry, TSNode node) {
+  TSPoint end_point = ts_node_end_point(node);
+  marshal_node(entry, node);
+  entry[5] = (const void *)byte_to_code_unit(ts_node_end_byte(node));
+  entry[6] = (const void *)end_point.row;
+  entry[7] = (const void *)byte_to_code_unit(end_point.column);
+  entry[8] = (const void *)(uint32_t)ts_node_symbol(node);
+}
+
+void ts_node_descendants_wasm(const TSTree *tree, uint32_t max_depth) {
+  TSNode node = unmarshal_node(tree);
+  Array(const void *) result = array_new();
+  Array(uint32_t) ancestors = array_new();
+  array_reserve(&result, NODE_BATCH_STRIDE * ts_node_descendant_count(node));
+
+  ts_tree_cursor_reset(&scratch_cursor, node);
+  for (;;) {
+    TSNode descendant = ts_tree_cursor_current_node(&scratch_cursor);
+    uint32_t index = result.size / NODE_BATCH_STRIDE;
+    array_grow_by(&result, NODE_BATCH_STRIDE);
+    const void **entry = result.contents + index * NODE_BATCH_STRIDE;
+    marshal_batch_node(entry, descendant);
+    entry[9] = (const void *)(uint32_t)ts_tree_cursor_current_field_id(&scratch_cursor);
+    entry[10] = (const void *)(ancestors.size > 0 ? *array_back(&ancestors) : UINT32_MAX);
+    entry[11] = (const void *)0;
+
+    if (ancestors.size < max_depth && ts_tree_cursor_goto_first_child(&scratch_cursor)) {
+      array_push(&ancestors, index);
+      continue;
+    }
+
+    // Close every ancestor whose children have all been visited.
+    while (ancestors.size > 0 && !ts_tree_cursor_goto_next_sibling(&scratch_cursor)) {
+      uint32_t parent_index = array_pop(&ancestors);
+      uint32_t count = result.size / NODE_BATCH_STRIDE;
+      result.contents[parent_index * NODE_BATCH_STRIDE + 11] =
+        (const void *)(count - parent_index - 1);
+      ts_tree_cursor_goto_parent(&scratch_cursor);
+    }
+    if (ancestors.size == 0) break;
+  }
+
+  array_delete(&ancestors);
+  TRANSFER_BUFFER[0] = (const void *)(result.size / NODE_BATCH_STRIDE);
+  TRANSFER_BUFFER[1] = result.contents;
+}
+
 int ts_node_is_named_wasm(const TSTree *tree) {
   TSNode node = unmarshal_node(tree);
   return ts_node_is_named(node);
@@ -895,3 +949,111 @@ void ts_query_captures_wasm(
   TRANSFER_BUFFER[1] = result.contents;
   TRANSFER_BUFFER[2] = (const void *)(did_exceed_match_limit);
 }
+
+// Each entry in a query batch starts with the same nine slots as a node batch
+// entry, followed by the pattern index, the capture index, the match id, the
+// index of the first entry of the match and whether the entry is a result.
+// Every capture of a match is written so that text predicates can be checked
+// on the JS side, but in a captures batch only the capture that was reached
+// is a result.
+#define QUERY_BATCH_STRIDE 14
+
+static void ts_query_batch_wasm(
+  const TSQuery *self,
+  const TSTree *tree,
+  uint32_t start_row,
+  uint32_t start_column,
+  uint32_t end_row,
+  uint32_t end_column,
+  uint32_t start_index,
+  uint32_t end_index,
+  uint32_t match_limit,
+  uint32_t max_start_depth,
+  bool by_capture
+) {
+  if (!scratch_query_cursor) {
+    scratch_query_cursor = ts_query_cursor_new();
+  }
+
+  TSNode node = unmarshal_node(tree);
+  TSPoint start_point = {start_row, code_unit_to_byte(start_column)};
+  TSPoint end_point = {end_row, code_unit_to_byte(end_column)};
+  ts_query_cursor_set_point_range(scratch_query_cursor, start_point, end_point);
+  ts_query_cursor_set_byte_range(scratch_query_cursor, start_index, end_index);
+  ts_query_cursor_set_match_limit(scratch_query_cursor, match_limit);
+  ts_query_cursor_set_max_start_depth(scratch_query_cursor, max_start_depth);
+  ts_query_cursor_exec(scratch_query_cursor, self, node);
+
+  Array(const void *) result = array_new();
+
+  TSQueryMatch match;
+  uint32_t capture_index = 0;
+  for (;;) {
+    if (by_capture) {
+      if (!ts_query_cursor_next_capture(scratch_query_cursor, &match, &capture_index)) break;
+    } else {
+      if (!ts_query_cursor_next_match(scratch_query_cursor, &match)) break;
+    }
+
+    uint32_t first_index = result.size / QUERY_BATCH_STRIDE;
+    array_grow_by(&result, QUERY_BATCH_STRIDE * match.capture_count);
+    for (unsigned i = 0; i < match.capture_count; i++) {
+      const TSQueryCapture *capture = &match.captures[i];
+      const void **entry = result.contents + (first_index + i) * QUERY_BATCH_STRIDE;
+      marshal_batch_node(entry, capture->node);
+      entry[9] = (const void *)(uint32_t)match.pattern_index;
+      entry[10] = (const void *)capture->index;
+      entry[11] = (const void *)match.id;
+      entry[12] = (const void *)first_index;
+      entry[13] = (const void *)(uint32_t)(!by_capture || i == capture_index);
+    }
+  }
+
+  bool did_exceed_match_limit =
+    ts_query_cursor_did_exceed_match_limit(scratch_query_cursor);
+  TRANSFER_BUFFER[0] = (const void *)(result.size / QUERY_BATCH_STRIDE);
+  TRANSFER_BUFFER[1] = result.contents;
+  TRANSFER_BUFFER[2] = (const void *)(did_exceed_match_limit);
+}
+
+void ts_query_matches_batch_wasm(
+  const TSQuery *self,
+  const TSTree *tree,
+  uint32_t start_row,
+  uint32_t start_column,
+  uint32_t end_row,
+  uint32_t end_column,
+  uint32_t start_index,
+  uint32_t end_index,
+  uint32_t match_limit,
+  uint32_t max_start_depth
+) {
+  ts_query_batch_wasm(
+    self, tree,
+    start_row, start_column, end_row, end_column,
+    start_index, end_index,
+    match_limit, max_start_depth,
+    false
+  );
+}
+
+void ts_query_captures_batch_wasm(
+  const TSQuery *self,
+  const TSTree *tree,
+  uint32_t start_row,
+  uint32_t start_column,
+  uint32_t end_row,
+  uint32_t end_column,
+  uint32_t start_index,
+  uint32_t end_index,
+  uint32_t match_limit,
+  uint32_t max_start_depth
+) {
+  ts_query_batch_wasm(
+    self, tree,
+    start_row, start_column, end_row, end_column,
+    start_index, end_index,
+    match_limit, max_start_depth,
+    true
+  );
+}
@@ -10,6 +10,8 @@ const SIZE_OF_CURSOR = 4 * SIZE_OF_INT;
 const SIZE_OF_NODE = 5 * SIZE_OF_INT;
 const SIZE_OF_POINT = 2 * SIZE_OF_INT;
 const SIZE_OF_RANGE = 2 * SIZE_OF_INT + 2 * SIZE_OF_POINT;
+const NODE_BATCH_STRIDE = 12;
+const QUERY_BATCH_STRIDE = 14;
 const ZERO_POINT = {row: 0, column: 0};
 const QUERY_WORD_REGEX = /[\w-.]*/g;
 
@@ -609,6 +611,14 @@ class Node {
     return new TreeCursor(INTERNAL, this.tree);
   }
 
+  descendantBatch(maxDepth = -1) {
+    marshalNode(this);
+    C._ts_node_descendants_wasm(this.tree[0], maxDepth);
+    const count = getValue(TRANSFER_BUFFER, 'i32');
+    const buffer = getValue(TRANSFER_BUFFER + SIZE_OF_INT, 'i32');
+    return new NodeBatch(INTERNAL, this.tree, buffer, count);
+  }
+
   toString() {
     marshalNode(this);
     const address = C._ts_node_to_string_wasm(this.tree[0]);
@@ -786,6 +796,191 @@ class TreeCursor {
   }
 }
 
+class NodeBatch {
+  constructor(internal, tree, address, length) {
+    assertInternal(internal);
+    this.tree = tree;
+    this[0] = address;
+    this.length = length;
+    this._nodes = new Array(length);
+  }
+
+  delete() {
+    C._free(this[0]);
+    this[0] = 0;
+  }
+
+  // The entries live in wasm memory, so they are read through `HEAPU32`
+  // on every access. The view is replaced whenever the memory grows.
+  _slot(index, offset) {
+    if (this[0] === 0) throw new Error('NodeBatch has been deleted');
+    if (index < 0 || index >= this.length) {
+      throw new RangeError(`Index ${index} is out of bounds`);
+    }
+    return HEAPU32[(this[0] >> 2) + index * NODE_BATCH_STRIDE + offset];
+  }
+
+  node(index) {
+    if (!this._nodes[index]) {
+      const id = this._slot(index, 0);
+      const base = (this[0] >> 2) + index * NODE_BATCH_STRIDE;
+      const result = new Node(INTERNAL, this.tree);
+      result.id = id;
+      result.startIndex = HEAPU32[base + 1];
+      result.startPosition = {row: HEAPU32[base + 2], column: HEAPU32[base + 3]};
+      result[0] = HEAPU32[base + 4];
+      this._nodes[index] = result;
+    }
+    return this._nodes[index];
+  }
+
+  startIndex(index) {
+    return this._slot(index, 1);
+  }
+
+  startPosition(index) {
+    return {row: this._slot(index, 2), column: this._slot(index, 3)};
+  }
+
+  endIndex(index) {
+    return this._slot(index, 5);
+  }
+
+  endPosition(index) {
+    return {row: this._slot(index, 6), column: this._slot(index, 7)};
+  }
+
+  typeId(index) {
+    return this._slot(index, 8);
+  }
+
+  type(index) {
+    return this.tree.language.types[this.typeId(index)] || 'ERROR';
+  }
+
+  fieldId(index) {
+    return this._slot(index, 9);
+  }
+
+  fieldName(index) {
+    return this.tree.language.fields[this.fieldId(index)];
+  }
+
+  parentIndex(index) {
+    return this._slot(index, 10) | 0;
+  }
+
+  descendantCount(index) {
+    return this._slot(index, 11);
+  }
+}
+
+class QueryBatch {
+  // Text predicates are checked up front. Only the captures of matches whose
+  // pattern has text predicates need to be unmarshaled to do so.
+  constructor(internal, query, tree, address, entryCount) {
+    assertInternal(internal);
+    this.query = query;
+    this.tree = tree;
+    this[0] = address;
+
+    const entries = [];
+    const base = address >> 2;
+    for (let start = 0; start < entryCount;) {
+      let end = start + 1;
+      while (end < entryCount && HEAPU32[base + end * QUERY_BATCH_STRIDE + 12] === start) end++;
+
+      const pattern = HEAPU32[base + start * QUERY_BATCH_STRIDE + 9];
+      const predicates = query.textPredicates[pattern];
+      let passes = true;
+      if (predicates.length > 0) {
+        const captures = new Array(end - start);
+        for (let i = start; i < end; i++) {
+          const entry = base + i * QUERY_BATCH_STRIDE;
+          captures[i - start] = {
+            name: query.captureNames[HEAPU32[entry + 10]],
+            node: unmarshalNode(tree, entry << 2),
+          };
+        }
+        passes = predicates.every((p) => p(captures));
+      }
+
+      if (passes) {
+        for (let i = start; i < end; i++) {
+          if (HEAPU32[base + i * QUERY_BATCH_STRIDE + 13]) entries.push(i);
+        }
+      }
+      start = end;
+    }
+
+    this._entries = Uint32Array.from(entries);
+    this.length = entries.length;
+    this._nodes = new Array(this.length);
+  }
+
+  delete() {
+    C._free(this[0]);
+    this[0] = 0;
+  }
+
+  _slot(index, offset) {
+    if (this[0] === 0) throw new Error('QueryBatch has been deleted');
+    if (index < 0 || index >= this.length) {
+      throw new RangeError(`Index ${index} is out of bounds`);
+    }
+    return HEAPU32[(this[0] >> 2) + this._entries[index] * QUERY_BATCH_STRIDE + offset];
+  }
+
+  node(index) {
+    if (!this._nodes[index]) {
+      this._slot(index, 0);
+      const address = this[0] + this._entries[index] * QUERY_BATCH_STRIDE * SIZE_OF_INT;
+      this._nodes[index] = unmarshalNode(this.tree, address);
+    }
+    return this._nodes[index];
+  }
+
+  name(index) {
+    return this.query.captureNames[this.captureIndex(index)];
+  }
+
+  captureIndex(index) {
+    return this._slot(index, 10);
+  }
+
+  patternIndex(index) {
+    return this._slot(index, 9);
+  }
+
+  matchId(index) {
+    return this._slot(index, 11);
+  }
+
+  startIndex(index) {
+    return this._slot(index, 1);
+  }
+
+  startPosition(index) {
+    return {row: this._slot(index, 2), column: this._slot(index, 3)};
+  }
+
+  endIndex(index) {
+    return this._slot(index, 5);
+  }
+
+  endPosition(index) {
+    return {row: this._slot(index, 6), column: this._slot(index, 7)};
+  }
+
+  typeId(index) {
+    return this._slot(index, 8);
+  }
+
+  type(index) {
+    return this.tree.language.types[this.typeId(index)] || 'ERROR';
+  }
+}
+
 class Language {
   constructor(internal, address) {
     assertInternal(internal);
@@ -1398,6 +1593,52 @@ class Query {
     return result;
   }
 
+  matchesBatch(node, options) {
+    return this._batch(node, options, C._ts_query_matches_batch_wasm);
+  }
+
+  capturesBatch(node, options) {
+    return this._batch(node, options, C._ts_query_captures_batch_wasm);
+  }
+
+  _batch(
+    node,
+    {
+      startPosition = ZERO_POINT,
+      endPosition = ZERO_POINT,
+      startIndex = 0,
+      endIndex = 0,
+      matchLimit = 0xFFFFFFFF,
+      maxStartDepth = 0xFFFFFFFF,
+    } = {},
+    batchFunction,
+  ) {
+    if (typeof matchLimit !== 'number') {
+      throw new Error('Arguments must be numbers');
+    }
+
+    marshalNode(node);
+
+    batchFunction(
+      this[0],
+      node.tree[0],
+      startPosition.row,
+      startPosition.column,
+      endPosition.row,
+      endPosition.column,
+      startIndex,
+      endIndex,
+      matchLimit,
+      maxStartDepth,
+    );
+
+    const count = getValue(TRANSFER_BUFFER, 'i32');
+    const startAddress = getValue(TRANSFER_BUFFER + SIZE_OF_INT, 'i32');
+    const didExceedMatchLimit = getValue(TRANSFER_BUFFER + 2 * SIZE_OF_INT, 'i32');
+    this.exceededMatchLimit = Boolean(didExceedMatchLimit);
+    return new QueryBatch(INTERNAL, this, node.tree, startAddress, count);
+  }
+
   predicatesForPattern(patternIndex) {
     return this.predicates[patternIndex];
   }
@@ -437,6 +437,69 @@ describe('Node', () => {
     });
   });
 
+  describe('.descendantBatch(maxDepth)', () => {
+    it('returns every descendant in depth-first order', () => {
+      parser.setLanguage(JSON);
+      tree = parser.parse(JSON_EXAMPLE);
+      const allNodes = getAllNodes(tree);
+      const batch = tree.rootNode.descendantBatch();
+
+      assert.equal(batch.length, allNodes.length);
+      assert.equal(batch.parentIndex(0), -1);
+      assert.equal(batch.descendantCount(0), allNodes.length - 1);
+      for (let i = 0; i < allNodes.length; i++) {
+        const node = allNodes[i];
+        assert.equal(batch.node(i).id, node.id, `index ${i}`);
+        assert.equal(batch.type(i), node.type);
+        assert.equal(batch.startIndex(i), node.startIndex);
+        assert.equal(batch.endIndex(i), node.endIndex);
+        assert.deepEqual(batch.startPosition(i), node.startPosition);
+        assert.deepEqual(batch.endPosition(i), node.endPosition);
+        if (i > 0) {
+          assert.equal(batch.node(batch.parentIndex(i)).id, node.parent.id);
+        }
+      }
+
+      const pairIndex = allNodes.findIndex((node) => node.type === 'pair');
+      const keyIndex = pairIndex + 1;
+      const valueIndex = keyIndex + batch.descendantCount(keyIndex) + 2;
+      assert.equal(batch.fieldName(keyIndex), 'key');
+      assert.equal(batch.fieldName(valueIndex), 'value');
+      assert.equal(batch.type(valueIndex), 'null');
+      batch.delete();
+    });
+
+    it('stops descending at the given depth', () => {
+      tree = parser.parse('a(b, c); d;');
+      const batch = tree.rootNode.descendantBatch(1);
+      assert.deepEqual(
+        Array.from({length: batch.length}, (_, i) => batch.type(i)),
+        ['program', 'expression_statement', 'expression_statement'],
+      );
+      assert.equal(batch.descendantCount(0), 2);
+      batch.delete();
+    });
+
+    it('reports indices in UTF16 code units', () => {
+      tree = parser.parse('"αβγ" + "δ"');
+      const batch = tree.rootNode.descendantBatch();
+      for (let i = 0; i < batch.length; i++) {
+        const node = batch.node(i);
+        assert.equal(batch.endIndex(i), node.endIndex);
+        assert.deepEqual(batch.endPosition(i), node.endPosition);
+      }
+      batch.delete();
+    });
+
+    it('throws when it is accessed after being deleted', () => {
+      tree = parser.parse('a; b;');
+      const batch = tree.rootNode.descendantBatch();
+      batch.delete();
+      assert.throws(() => batch.type(0), 'NodeBatch has been deleted');
+      assert.throws(() => batch.node(0), 'NodeBatch has been deleted');
+    });
+  });
+
   describe('.rootNodeWithOffset', () => {
     it('returns the root node of the tree, offset by the given byte offset', () => {
       tree = parser.parse('  if (a) b');
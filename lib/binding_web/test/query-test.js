@@ -363,6 +363,85 @@ describe('Query', () => {
     });
   });
 
+  describe('.capturesBatch', () => {
+    it('returns the same captures as .captures, after checking predicates', () => {
+      tree = parser.parse(`
+        lambda
+        panda
+        const ab = require('./ab');
+        new Cd(EF);
+        x = "αβγ" + EF;
+      `);
+      query = JavaScript.query(`
+        ((identifier) @variable
+         (#not-match? @variable "^(lambda|load)$"))
+
+        ((identifier) @constructor
+         (#match? @constructor "^[A-Z]"))
+
+        (string) @string
+      `);
+
+      const captures = query.captures(tree.rootNode);
+      const batch = query.capturesBatch(tree.rootNode);
+      assert.equal(batch.length, captures.length);
+      for (let i = 0; i < captures.length; i++) {
+        const {name, node} = captures[i];
+        assert.equal(batch.name(i), name, `index ${i}`);
+        assert.equal(batch.captureIndex(i), query.captureNames.indexOf(name));
+        assert.equal(batch.node(i).id, node.id);
+        assert.equal(batch.type(i), node.type);
+        assert.equal(batch.startIndex(i), node.startIndex);
+        assert.equal(batch.endIndex(i), node.endIndex);
+        assert.deepEqual(batch.startPosition(i), node.startPosition);
+        assert.deepEqual(batch.endPosition(i), node.endPosition);
+      }
+      batch.delete();
+    });
+
+    it('throws when it is accessed after being deleted', () => {
+      tree = parser.parse('a; b;');
+      query = JavaScript.query('(identifier) @id');
+      const batch = query.capturesBatch(tree.rootNode);
+      assert.equal(batch.length, 2);
+      batch.delete();
+      assert.throws(() => batch.name(0), 'QueryBatch has been deleted');
+      assert.throws(() => batch.node(0), 'QueryBatch has been deleted');
+    });
+  });
+
+  describe('.matchesBatch', () => {
+    it('returns the captures of every match, grouped by match id', () => {
+      tree = parser.parse(`
+        giraffe(1, 2, []);
+        helment([false]);
+        goat(false);
+        gross(3, []);
+      `);
+      query = JavaScript.query(`
+        (call_expression
+          function: (identifier) @name
+          arguments: (arguments (array) @array)
+          (#match? @name "^g"))
+      `);
+
+      const batch = query.matchesBatch(tree.rootNode);
+      const matches = [];
+      for (let i = 0; i < batch.length; i++) {
+        if (i === 0 || batch.matchId(i) !== batch.matchId(i - 1)) {
+          matches.push({pattern: batch.patternIndex(i), captures: []});
+        }
+        matches[matches.length - 1].captures.push({name: batch.name(i), text: batch.node(i).text});
+      }
+      assert.deepEqual(matches, formatMatches(query.matches(tree.rootNode)));
+      assert.deepEqual(matches, [
+        {pattern: 0, captures: [{name: 'name', text: 'giraffe'}, {name: 'array', text: '[]'}]},
+        {pattern: 0, captures: [{name: 'name', text: 'gross'}, {name: 'array', text: '[]'}]},
+      ]);
+      batch.delete();
+    });
+  });
+
   describe('.predicatesForPattern(index)', () => {
     it('returns all of the predicates as objects', () => {
       query = JavaScript.query(`
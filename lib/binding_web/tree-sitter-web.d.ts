@@ -111,6 +111,24 @@ declare module 'web-tree-sitter' {
       descendantsOfType(types: String | Array<String>, startPosition?: Point, endPosition?: Point): Array<SyntaxNode>;
 
       walk(): TreeCursor;
+      descendantBatch(maxDepth?: number): NodeBatch;
+    }
+
+    export interface NodeBatch {
+      readonly length: number;
+
+      delete(): void;
+      node(index: number): SyntaxNode;
+      startIndex(index: number): number;
+      startPosition(index: number): Point;
+      endIndex(index: number): number;
+      endPosition(index: number): Point;
+      typeId(index: number): number;
+      type(index: number): string;
+      fieldId(index: number): number;
+      fieldName(index: number): string | null;
+      parentIndex(index: number): number;
+      descendantCount(index: number): number;
     }
 
     export interface TreeCursor {
@@ -172,6 +190,23 @@ declare module 'web-tree-sitter' {
       captures: QueryCapture[];
     }
 
+    export interface QueryBatch {
+      readonly length: number;
+
+      delete(): void;
+      node(index: number): SyntaxNode;
+      name(index: number): string;
+      captureIndex(index: number): number;
+      patternIndex(index: number): number;
+      matchId(index: number): number;
+      startIndex(index: number): number;
+      startPosition(index: number): Point;
+      endIndex(index: number): number;
+      endPosition(index: number): Point;
+      typeId(index: number): number;
+      type(index: number): string;
+    }
+
     export type QueryOptions = {
       startPosition?: Point;
       endPosition?: Point;
@@ -197,6 +232,8 @@ declare module 'web-tree-sitter' {
       delete(): void;
       captures(node: SyntaxNode, options?: QueryOptions): QueryCapture[];
       matches(node: SyntaxNode, options?: QueryOptions): QueryMatch[];
+      capturesBatch(node: SyntaxNode, options?: QueryOptions): QueryBatch;
+      matchesBatch(node: SyntaxNode, options?: QueryOptions): QueryBatch;
       predicatesForPattern(patternIndex: number): PredicateResult[];
       disableCapture(captureName: string): void;
       disablePattern(patternIndex: number): void;
@@ -51,6 +51,8 @@ typedef struct TSLookaheadIterator TSLookaheadIterator;
 typedef enum TSInputEncoding {
   TSInputEncodingUTF8,
   TSInputEncodingUTF16,
+  TSInputEncodingLatin1,
+  TSInputEncodingUTF16BE,
 } TSInputEncoding;
 
 typedef enum TSSymbolType {
@@ -77,6 +79,12 @@ typedef struct TSInput {
   TSInputEncoding encoding;
 } TSInput;
 
+typedef struct TSInputSegment {
+  uint32_t start_byte;
+  const char *string;
+  uint32_t length;
+} TSInputSegment;
+
 typedef enum TSLogType {
   TSLogTypeParse,
   TSLogTypeLex,
@@ -108,6 +116,27 @@ typedef struct TSTreeCursor {
   uint32_t context[3];
 } TSTreeCursor;
 
+typedef enum TSFlatNodeFlag {
+  TSFlatNodeFlagNamed = 1 << 0,
+  TSFlatNodeFlagExtra = 1 << 1,
+  TSFlatNodeFlagMissing = 1 << 2,
+  TSFlatNodeFlagError = 1 << 3,
+  TSFlatNodeFlagHasError = 1 << 4,
+  TSFlatNodeFlagHasChanges = 1 << 5,
+} TSFlatNodeFlag;
+
+typedef struct TSFlatNode {
+  TSSymbol symbol;
+  TSFieldId field_id;
+  uint32_t flags;
+  uint32_t start_byte;
+  uint32_t end_byte;
+  TSPoint start_point;
+  TSPoint end_point;
+  uint32_t parent_index;
+  uint32_t descendant_count;
+} TSFlatNode;
+
 typedef struct TSQueryCapture {
   TSNode node;
   uint32_t index;
@@ -242,7 +271,9 @@ const TSRange *ts_parser_included_ranges(
  * 2. [`payload`]: An arbitrary pointer that will be passed to each invocation
  *    of the [`read`] function.
  * 3. [`encoding`]: An indication of how the text is encoded. Either
- *    `TSInputEncodingUTF8` or `TSInputEncodingUTF16`.
+ *    `TSInputEncodingUTF8`, `TSInputEncodingUTF16` (little-endian),
+ *    `TSInputEncodingUTF16BE` or `TSInputEncodingLatin1` (ISO-8859-1). Byte
+ *    offsets always refer to the text in its original encoding.
  *
  * This function returns a syntax tree on success, and `NULL` on failure. There
  * are three possible reasons for failure:
@@ -286,7 +317,7 @@ TSTree *ts_parser_parse_string(
  * Use the parser to parse some source code stored in one contiguous buffer with
  * a given encoding. The first four parameters work the same as in the
  * [`ts_parser_parse_string`] method above. The final parameter indicates whether
- * the text is encoded as UTF8 or UTF16.
+ * the text is encoded as UTF8, UTF16, UTF16BE or Latin1.
  */
 TSTree *ts_parser_parse_string_encoding(
   TSParser *self,
@@ -296,6 +327,25 @@ TSTree *ts_parser_parse_string_encoding(
   TSInputEncoding encoding
 );
 
+/**
+ * Use the parser to parse some source code that is stored in several separate
+ * buffers, such as the chunks of a rope. The first two parameters are the same
+ * as in the [`ts_parser_parse`] function above.
+ *
+ * The segments must be ordered by their start byte, and each segment must
+ * begin where the previous one ends. The parser reads the segments in order
+ * while it lexes, and only searches for a segment when it needs to move back
+ * to an earlier position, so this avoids looking up the text for every chunk
+ * that the parser reads through a [`TSInput`] callback.
+ */
+TSTree *ts_parser_parse_segments(
+  TSParser *self,
+  const TSTree *old_tree,
+  const TSInputSegment *segments,
+  uint32_t segment_count,
+  TSInputEncoding encoding
+);
+
 /**
  * Instruct the parser to start the next parse from the beginning.
  *
@@ -589,6 +639,35 @@ TSNode ts_node_named_child(TSNode self, uint32_t child_index);
  */
 uint32_t ts_node_named_child_count(TSNode self);
 
+/**
+ * Write up to `capacity` of the node's children into `children`, starting
+ * with the child at `start_index`. Returns the number of nodes written.
+ *
+ * Fetching a range of children this way finds the starting child once and
+ * then advances through its siblings, so reading every child costs time
+ * proportional to the child count, unlike repeated calls to [`ts_node_child`].
+ */
+uint32_t ts_node_children(
+  TSNode self,
+  uint32_t start_index,
+  TSNode *children,
+  uint32_t capacity
+);
+
+/**
+ * Write up to `capacity` of the node's *named* children into `children`,
+ * starting with the named child at `start_index`. Returns the number of nodes
+ * written.
+ *
+ * See also [`ts_node_children`].
+ */
+uint32_t ts_node_named_children(
+  TSNode self,
+  uint32_t start_index,
+  TSNode *children,
+  uint32_t capacity
+);
+
 /**
  * Get the node's child with the given field name.
  */
@@ -606,6 +685,18 @@ TSNode ts_node_child_by_field_name(
  */
 TSNode ts_node_child_by_field_id(TSNode self, TSFieldId field_id);
 
+/**
+ * Get the node's child for every field in a single pass over its children.
+ *
+ * The `children` array is indexed by field id and must have room for
+ * `length` nodes. Each entry is set to the same node that
+ * [`ts_node_child_by_field_id`] would return for that field, or to a null
+ * node if the field is not present. Fields whose ids are not less than
+ * `length` are ignored, so passing [`ts_language_field_count`] + 1 covers
+ * every field. Returns the number of fields that were found.
+ */
+uint32_t ts_node_field_children(TSNode self, TSNode *children, uint32_t length);
+
 /**
  * Get the node's next / previous sibling.
  */
@@ -663,6 +754,55 @@ void ts_node_edit(TSNode *self, const TSInputEdit *edit);
  */
 bool ts_node_eq(TSNode self, TSNode other);
 
+/**
+ * Write the node and its descendants into a caller-provided array, in
+ * pre-order, using a single traversal.
+ *
+ * The node itself is always written first. Each entry records the node's
+ * symbol, the field id under which it appears in its parent, a bitmask of
+ * [`TSFlatNodeFlag`] values, its byte and point range, the index of its
+ * parent entry, and the number of entries that follow it in the array
+ * which belong to its subtree. The first entry's `parent_index` is
+ * `UINT32_MAX`, and its `field_id` is zero.
+ *
+ * If `named_only` is true, anonymous nodes are omitted, and their named
+ * descendants are attached to the nearest written ancestor. Nodes deeper than
+ * `max_depth` levels below the given node are omitted along with their
+ * subtrees. Pass `UINT32_MAX` to visit the entire subtree.
+ *
+ * At most `capacity` entries are written, and the number of entries written
+ * is returned. The result of [`ts_node_descendant_count`] is always a
+ * sufficient capacity. If the capacity is too small, the array contains a
+ * prefix of the full traversal.
+ */
+uint32_t ts_node_flatten(
+  TSNode self,
+  bool named_only,
+  uint32_t max_depth,
+  TSFlatNode *nodes,
+  uint32_t capacity
+);
+
+/**
+ * Split the node's subtree into units of work that can be traversed
+ * independently, for example on separate threads.
+ *
+ * Each unit is the root of a subtree with at most `max_unit_size` nodes,
+ * as counted by [`ts_node_descendant_count`]. Units are chosen as high in
+ * the tree as possible, so every node in the subtree either belongs to
+ * exactly one unit or is an ancestor of one. The units are written to
+ * `units` in document order.
+ *
+ * At most `capacity` units are written, but the total number of units is
+ * always returned, so a caller can retry with a larger buffer.
+ */
+uint32_t ts_node_partition(
+  TSNode self,
+  uint32_t max_unit_size,
+  TSNode *units,
+  uint32_t capacity
+);
+
 /************************/
 /* Section - TreeCursor */
 /************************/
@@ -771,6 +911,33 @@ bool ts_tree_cursor_goto_last_child(TSTreeCursor *self);
  */
 void ts_tree_cursor_goto_descendant(TSTreeCursor *self, uint32_t goal_descendant_index);
 
+/**
+ * Move the cursor to the deepest node that contains the given byte offset or
+ * point, out of the descendants of the original node that the cursor was
+ * constructed with.
+ *
+ * This lands on the same node as [`ts_node_descendant_for_byte_range`] or
+ * [`ts_node_descendant_for_point_range`] with an empty range. The cursor only
+ * climbs as far as the lowest ancestor of its current node that contains the
+ * goal, so moving to a nearby position is cheaper than starting from the
+ * original node.
+ */
+void ts_tree_cursor_goto_descendant_for_byte(TSTreeCursor *self, uint32_t goal_byte);
+void ts_tree_cursor_goto_descendant_for_point(TSTreeCursor *self, TSPoint goal_point);
+
+/**
+ * Move the cursor to the next node in a pre-order traversal of the original
+ * node that the cursor was constructed with. This is the node whose
+ * descendant index is one greater than the current node's.
+ *
+ * This returns `true` if the cursor successfully moved, and returns `false`
+ * once every descendant has been visited, leaving the cursor on the original
+ * node. This visits the same nodes as combining
+ * [`ts_tree_cursor_goto_first_child`], [`ts_tree_cursor_goto_next_sibling`]
+ * and [`ts_tree_cursor_goto_parent`], but takes a single call per node.
+ */
+bool ts_tree_cursor_goto_next_descendant(TSTreeCursor *self);
+
 /**
  * Get the index of the cursor's current node out of all of the
  * descendants of the original node that the cursor was constructed with.
@@ -823,6 +990,34 @@ TSQuery *ts_query_new(
  */
 void ts_query_delete(TSQuery *self);
 
+/**
+ * Serialize a query into a buffer, so that it can be recreated later with
+ * [`ts_query_deserialize`] without recompiling its source.
+ *
+ * The buffer is allocated with the library's allocator, so it should be freed
+ * with the same `free` function that the library is using. Its length is
+ * written to the `length` parameter.
+ */
+char *ts_query_serialize(const TSQuery *self, uint32_t *length);
+
+/**
+ * Recreate a query from a buffer that was written by [`ts_query_serialize`],
+ * using the same language.
+ *
+ * This returns `NULL` if the buffer is malformed, or if it was written for a
+ * language with a different ABI version or number of symbols or fields, or in
+ * a different version of the serialization format. The buffer doesn't record
+ * which version of the library wrote it, so a buffer should only be used with
+ * the version of the library that wrote it. Every index that the buffer
+ * contains is checked against the query's own arrays and the language, so a
+ * corrupted buffer is rejected rather than read out of bounds.
+ */
+TSQuery *ts_query_deserialize(
+  const TSLanguage *language,
+  const char *data,
+  uint32_t length
+);
+
 /**
  * Get the number of patterns, captures, or string literals in the query.
  */
@@ -82,9 +82,21 @@ static void ts_lexer__get_lookahead(Lexer *self) {
   }
 
   const uint8_t *chunk = (const uint8_t *)self->chunk + position_in_chunk;
-  UnicodeDecodeFunction decode = self->input.encoding == TSInputEncodingUTF8
-    ? ts_decode_utf8
-    : ts_decode_utf16;
+  UnicodeDecodeFunction decode;
+  switch (self->input.encoding) {
+    case TSInputEncodingUTF16:
+      decode = ts_decode_utf16;
+      break;
+    case TSInputEncodingUTF16BE:
+      decode = ts_decode_utf16_be;
+      break;
+    case TSInputEncodingLatin1:
+      decode = ts_decode_latin1;
+      break;
+    default:
+      decode = ts_decode_utf8;
+      break;
+  }
 
   self->lookahead_size = decode(chunk, size, &self->data.lookahead);
 
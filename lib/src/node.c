@@ -170,6 +170,50 @@ static inline TSNode ts_node__child(
   return ts_node__null();
 }
 
+static void ts_node__collect_children(
+  TSNode self,
+  bool include_anonymous,
+  uint32_t *skip_count,
+  TSNode *children,
+  uint32_t *count,
+  uint32_t capacity
+) {
+  TSNode child;
+  NodeChildIterator iterator = ts_node_iterate_children(&self);
+  while (*count < capacity && ts_node_child_iterator_next(&iterator, &child)) {
+    if (ts_node__is_relevant(child, include_anonymous)) {
+      if (*skip_count > 0) {
+        (*skip_count)--;
+      } else {
+        children[(*count)++] = child;
+      }
+    } else {
+      // Skip over hidden nodes whose relevant children all come before the
+      // starting index, without visiting their children.
+      uint32_t grandchild_count = ts_node__relevant_child_count(child, include_anonymous);
+      if (*skip_count >= grandchild_count) {
+        *skip_count -= grandchild_count;
+      } else {
+        ts_node__collect_children(child, include_anonymous, skip_count, children, count, capacity);
+      }
+    }
+  }
+}
+
+static inline uint32_t ts_node__children(
+  TSNode self,
+  uint32_t start_index,
+  TSNode *children,
+  uint32_t capacity,
+  bool include_anonymous
+) {
+  uint32_t count = 0;
+  if (start_index < ts_node__relevant_child_count(self, include_anonymous)) {
+    ts_node__collect_children(self, include_anonymous, &start_index, children, &count, capacity);
+  }
+  return count;
+}
+
 static bool ts_subtree_has_trailing_empty_descendant(
   Subtree self,
   Subtree other
@@ -544,6 +588,24 @@ TSNode ts_node_named_child(TSNode self, uint32_t child_index) {
   return ts_node__child(self, child_index, false);
 }
 
+uint32_t ts_node_children(
+  TSNode self,
+  uint32_t start_index,
+  TSNode *children,
+  uint32_t capacity
+) {
+  return ts_node__children(self, start_index, children, capacity, true);
+}
+
+uint32_t ts_node_named_children(
+  TSNode self,
+  uint32_t start_index,
+  TSNode *children,
+  uint32_t capacity
+) {
+  return ts_node__children(self, start_index, children, capacity, false);
+}
+
 TSNode ts_node_child_by_field_id(TSNode self, TSFieldId field_id) {
 recur:
   if (!field_id || ts_node_child_count(self) == 0) return ts_node__null();
@@ -616,6 +678,59 @@ recur:
   return ts_node__null();
 }
 
+static uint32_t ts_node__field_children(TSNode self, TSNode *children, uint32_t length) {
+  if (ts_node_child_count(self) == 0) return 0;
+
+  const TSFieldMapEntry *field_map, *field_map_end;
+  ts_language_field_map(
+    self.tree->language,
+    ts_node__subtree(self).ptr->production_id,
+    &field_map,
+    &field_map_end
+  );
+  if (field_map == field_map_end) return 0;
+
+  uint32_t found_count = 0;
+  TSNode child;
+  NodeChildIterator iterator = ts_node_iterate_children(&self);
+  while (ts_node_child_iterator_next(&iterator, &child)) {
+    if (ts_subtree_extra(ts_node__subtree(child))) continue;
+    uint32_t index = iterator.structural_child_index - 1;
+
+    // A field can map to several children. Only the first one that yields
+    // a node is kept, matching `ts_node_child_by_field_id`. A hidden child
+    // passes on all of its fields, so it only needs to be visited once.
+    bool did_descend = false;
+    for (const TSFieldMapEntry *entry = field_map; entry != field_map_end; entry++) {
+      if (entry->child_index != index || entry->field_id >= length) continue;
+      TSNode *slot = &children[entry->field_id];
+      if (entry->inherited) {
+        if (!did_descend) {
+          found_count += ts_node__field_children(child, children, length);
+          did_descend = true;
+        }
+      } else if (slot->id) {
+        continue;
+      } else if (ts_node__is_relevant(child, true)) {
+        *slot = child;
+        found_count++;
+      } else if (ts_node_child_count(child) > 0) {
+        *slot = ts_node_child(child, 0);
+        found_count++;
+      }
+    }
+  }
+
+  return found_count;
+}
+
+uint32_t ts_node_field_children(TSNode self, TSNode *children, uint32_t length) {
+  for (uint32_t i = 0; i < length; i++) {
+    children[i] = ts_node__null();
+  }
+  return ts_node__field_children(self, children, length);
+}
+
 static inline const char *ts_node__field_name_from_language(TSNode self, uint32_t structural_child_index) {
     const TSFieldMapEntry *field_map, *field_map_end;
     ts_language_field_map(
@@ -777,3 +892,129 @@ void ts_node_edit(TSNode *self, const TSInputEdit *edit) {
   self->context[1] = start_point.row;
   self->context[2] = start_point.column;
 }
+
+static inline void ts_node__flatten_entry(
+  TSFlatNode *entry,
+  TSNode node,
+  TSFieldId field_id,
+  uint32_t parent_index
+) {
+  Subtree subtree = ts_node__subtree(node);
+  uint32_t flags = 0;
+  if (ts_node_is_named(node)) flags |= TSFlatNodeFlagNamed;
+  if (ts_subtree_extra(subtree)) flags |= TSFlatNodeFlagExtra;
+  if (ts_subtree_missing(subtree)) flags |= TSFlatNodeFlagMissing;
+  if (ts_node_is_error(node)) flags |= TSFlatNodeFlagError;
+  if (ts_subtree_error_cost(subtree) > 0) flags |= TSFlatNodeFlagHasError;
+  if (ts_subtree_has_changes(subtree)) flags |= TSFlatNodeFlagHasChanges;
+
+  Length size = ts_subtree_size(subtree);
+  uint32_t start_byte = ts_node_start_byte(node);
+  TSPoint start_point = ts_node_start_point(node);
+  *entry = (TSFlatNode) {
+    .symbol = ts_node_symbol(node),
+    .field_id = field_id,
+    .flags = flags,
+    .start_byte = start_byte,
+    .end_byte = start_byte + size.bytes,
+    .start_point = start_point,
+    .end_point = point_add(start_point, size.extent),
+    .parent_index = parent_index,
+    .descendant_count = 0,
+  };
+}
+
+uint32_t ts_node_flatten(
+  TSNode self,
+  bool named_only,
+  uint32_t max_depth,
+  TSFlatNode *nodes,
+  uint32_t capacity
+) {
+  if (ts_node_is_null(self) || capacity == 0) return 0;
+
+  // For each node on the cursor's path, store the index of the nearest
+  // written entry at or above it. A node was itself written if its value
+  // differs from its parent's.
+  Array(uint32_t) written_ancestors = array_new();
+  TSTreeCursor cursor = ts_tree_cursor_new(self);
+  uint32_t count = 0;
+
+  ts_node__flatten_entry(&nodes[count], self, 0, UINT32_MAX);
+  array_push(&written_ancestors, count++);
+
+  while (count < capacity) {
+    if (written_ancestors.size <= max_depth && ts_tree_cursor_goto_first_child(&cursor)) {
+      // Descended to the first child.
+    } else {
+      bool found_sibling = false;
+      while (written_ancestors.size > 1) {
+        uint32_t index = array_pop(&written_ancestors);
+        if (index != *array_back(&written_ancestors)) {
+          nodes[index].descendant_count = count - index - 1;
+        }
+        if (ts_tree_cursor_goto_next_sibling(&cursor)) {
+          found_sibling = true;
+          break;
+        }
+        ts_tree_cursor_goto_parent(&cursor);
+      }
+      if (!found_sibling) break;
+    }
+
+    uint32_t parent_index = *array_back(&written_ancestors);
+    TSNode node = ts_tree_cursor_current_node(&cursor);
+    if (!named_only || ts_node_is_named(node)) {
+      TSFieldId field_id = ts_tree_cursor_current_field_id(&cursor);
+      ts_node__flatten_entry(&nodes[count], node, field_id, parent_index);
+      array_push(&written_ancestors, count++);
+    } else {
+      array_push(&written_ancestors, parent_index);
+    }
+  }
+
+  // Finish the entries that are still open, either because the traversal
+  // completed or because the capacity was exhausted.
+  for (uint32_t i = 0; i < written_ancestors.size; i++) {
+    uint32_t index = written_ancestors.contents[i];
+    if (i == 0 || index != written_ancestors.contents[i - 1]) {
+      nodes[index].descendant_count = count - index - 1;
+    }
+  }
+
+  ts_tree_cursor_delete(&cursor);
+  array_delete(&written_ancestors);
+  return count;
+}
+
+uint32_t ts_node_partition(
+  TSNode self,
+  uint32_t max_unit_size,
+  TSNode *units,
+  uint32_t capacity
+) {
+  if (ts_node_is_null(self)) return 0;
+  if (max_unit_size == 0) max_unit_size = 1;
+
+  // Descend through every node that is too large to be a unit. Leaves
+  // always fit, so the walk ends at a unit on every path.
+  TSTreeCursor cursor = ts_tree_cursor_new(self);
+  uint32_t count = 0;
+  for (;;) {
+    TSNode node = ts_tree_cursor_current_node(&cursor);
+    if (ts_node_descendant_count(node) > max_unit_size) {
+      ts_tree_cursor_goto_first_child(&cursor);
+      continue;
+    }
+
+    if (count < capacity) units[count] = node;
+    count++;
+
+    while (!ts_tree_cursor_goto_next_sibling(&cursor)) {
+      if (!ts_tree_cursor_goto_parent(&cursor)) {
+        ts_tree_cursor_delete(&cursor);
+        return count;
+      }
+    }
+  }
+}
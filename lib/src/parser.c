@@ -133,6 +133,13 @@ typedef struct {
   uint32_t length;
 } TSStringInput;
 
+typedef struct {
+  const TSInputSegment *segments;
+  uint32_t segment_count;
+  uint32_t segment_index;
+  char boundary[4];
+} TSSegmentInput;
+
 // StringInput
 
 static const char *ts_string_input_read(
@@ -152,6 +159,76 @@ static const char *ts_string_input_read(
   }
 }
 
+// SegmentInput
+
+static inline bool ts_segment_input__contains(
+  const TSSegmentInput *self,
+  uint32_t index,
+  uint32_t byte
+) {
+  if (index >= self->segment_count) return false;
+  const TSInputSegment *segment = &self->segments[index];
+  return segment->start_byte <= byte && byte - segment->start_byte < segment->length;
+}
+
+static const char *ts_segment_input_read(
+  void *_self,
+  uint32_t byte,
+  TSPoint point,
+  uint32_t *length
+) {
+  (void)point;
+  TSSegmentInput *self = (TSSegmentInput *)_self;
+
+  // Most reads continue from the end of the previous chunk, so check the
+  // current segment and the next one before searching all of them.
+  uint32_t index = self->segment_index;
+  if (!ts_segment_input__contains(self, index, byte)) {
+    if (ts_segment_input__contains(self, index + 1, byte)) {
+      index++;
+    } else {
+      index = 0;
+      uint32_t size = self->segment_count;
+      while (size > 1) {
+        uint32_t half_size = size / 2;
+        uint32_t mid_index = index + half_size;
+        if (self->segments[mid_index].start_byte <= byte) index = mid_index;
+        size -= half_size;
+      }
+      if (!ts_segment_input__contains(self, index, byte)) {
+        *length = 0;
+        return "";
+      }
+    }
+  }
+  self->segment_index = index;
+
+  const TSInputSegment *segment = &self->segments[index];
+  uint32_t offset = byte - segment->start_byte;
+  uint32_t size = segment->length - offset;
+
+  // A multi-byte character may be split between this segment and the
+  // following ones, so join the bytes around the boundary.
+  if (size < sizeof(self->boundary) && index + 1 < self->segment_count) {
+    uint32_t boundary_size = 0;
+    const char *string = segment->string + offset;
+    for (;;) {
+      while (size > 0 && boundary_size < sizeof(self->boundary)) {
+        self->boundary[boundary_size++] = *string++;
+        size--;
+      }
+      if (boundary_size == sizeof(self->boundary) || ++index == self->segment_count) break;
+      string = self->segments[index].string;
+      size = self->segments[index].length;
+    }
+    *length = boundary_size;
+    return self->boundary;
+  }
+
+  *length = size;
+  return segment->string + offset;
+}
+
 // Parser - Private
 
 static void ts_parser__log(TSParser *self) {
@@ -2139,6 +2216,21 @@ TSTree *ts_parser_parse_string_encoding(
   });
 }
 
+TSTree *ts_parser_parse_segments(
+  TSParser *self,
+  const TSTree *old_tree,
+  const TSInputSegment *segments,
+  uint32_t segment_count,
+  TSInputEncoding encoding
+) {
+  TSSegmentInput input = {segments, segment_count, 0, {0}};
+  return ts_parser_parse(self, old_tree, (TSInput) {
+    &input,
+    ts_segment_input_read,
+    encoding,
+  });
+}
+
 void ts_parser_set_wasm_store(TSParser *self, TSWasmStore *store) {
   ts_wasm_store_delete(self->wasm_store);
   self->wasm_store = store;
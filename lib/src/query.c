@@ -2816,6 +2816,547 @@ void ts_query_delete(TSQuery *self) {
   }
 }
 
+/*
+ * Serialization - A query is stored as a header followed by each of its arrays,
+ * each preceded by its length. Arrays of integers and of predicate steps are
+ * stored as their raw contents. The steps, patterns, pattern map entries and
+ * step offsets contain padding and unused bitfield bits, so they are stored one
+ * field at a time, and the data only depends on the query. Integers are stored
+ * in the machine's byte order, so on a machine with a different byte order, the
+ * magic number doesn't match.
+ */
+
+#define QUERY_SERIALIZATION_MAGIC 0x51535354
+#define QUERY_SERIALIZATION_VERSION 2
+
+typedef struct {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t language_version;
+  uint32_t symbol_count;
+  uint32_t field_count;
+  uint16_t predicate_step_size;
+  uint16_t wildcard_root_pattern_count;
+} QuerySerializationHeader;
+
+typedef struct {
+  const char *data;
+  uint32_t length;
+  uint32_t offset;
+} QueryReader;
+
+static void ts_query__write(Array *buffer, const void *contents, uint32_t length) {
+  _array__splice(buffer, 1, buffer->size, 0, length, contents);
+}
+
+static void ts_query__write_array(
+  Array *buffer,
+  const void *contents,
+  uint32_t size,
+  size_t element_size
+) {
+  ts_query__write(buffer, &size, sizeof(size));
+  if (size > 0) ts_query__write(buffer, contents, size * element_size);
+}
+
+#define ts_query__write_array(buffer, array) \
+  ts_query__write_array(buffer, (array)->contents, (array)->size, array_elem_size(array))
+
+static void ts_query__write_u8(Array *buffer, uint8_t value) {
+  ts_query__write(buffer, &value, sizeof(value));
+}
+
+static void ts_query__write_u16(Array *buffer, uint16_t value) {
+  ts_query__write(buffer, &value, sizeof(value));
+}
+
+static void ts_query__write_u32(Array *buffer, uint32_t value) {
+  ts_query__write(buffer, &value, sizeof(value));
+}
+
+static void ts_query__write_step(Array *buffer, const void *element) {
+  const QueryStep *step = element;
+  ts_query__write_u16(buffer, step->symbol);
+  ts_query__write_u16(buffer, step->supertype_symbol);
+  ts_query__write_u16(buffer, step->field);
+  for (unsigned i = 0; i < MAX_STEP_CAPTURE_COUNT; i++) {
+    ts_query__write_u16(buffer, step->capture_ids[i]);
+  }
+  ts_query__write_u16(buffer, step->depth);
+  ts_query__write_u16(buffer, step->alternative_index);
+  ts_query__write_u16(buffer, step->negated_field_list_id);
+  ts_query__write_u16(buffer,
+    step->is_named << 0 |
+    step->is_immediate << 1 |
+    step->is_last_child << 2 |
+    step->is_pass_through << 3 |
+    step->is_dead_end << 4 |
+    step->alternative_is_immediate << 5 |
+    step->contains_captures << 6 |
+    step->root_pattern_guaranteed << 7 |
+    step->parent_pattern_guaranteed << 8
+  );
+}
+
+static void ts_query__write_pattern_entry(Array *buffer, const void *element) {
+  const PatternEntry *entry = element;
+  ts_query__write_u16(buffer, entry->step_index);
+  ts_query__write_u16(buffer, entry->pattern_index);
+  ts_query__write_u8(buffer, entry->is_rooted);
+}
+
+static void ts_query__write_pattern(Array *buffer, const void *element) {
+  const QueryPattern *pattern = element;
+  ts_query__write_u32(buffer, pattern->steps.offset);
+  ts_query__write_u32(buffer, pattern->steps.length);
+  ts_query__write_u32(buffer, pattern->predicate_steps.offset);
+  ts_query__write_u32(buffer, pattern->predicate_steps.length);
+  ts_query__write_u32(buffer, pattern->start_byte);
+  ts_query__write_u8(buffer, pattern->is_non_local);
+}
+
+static void ts_query__write_step_offset(Array *buffer, const void *element) {
+  const StepOffset *step_offset = element;
+  ts_query__write_u32(buffer, step_offset->byte_offset);
+  ts_query__write_u16(buffer, step_offset->step_index);
+}
+
+static void ts_query__write_fields(
+  Array *buffer,
+  const void *contents,
+  uint32_t size,
+  size_t element_size,
+  void (*write_element)(Array *, const void *)
+) {
+  ts_query__write_u32(buffer, size);
+  for (uint32_t i = 0; i < size; i++) {
+    write_element(buffer, (const char *)contents + i * element_size);
+  }
+}
+
+#define ts_query__write_fields(buffer, array, write_element) \
+  ts_query__write_fields( \
+    buffer, \
+    (array)->contents, \
+    (array)->size, \
+    array_elem_size(array), \
+    write_element \
+  )
+
+static bool ts_query__read(QueryReader *self, void *contents, uint32_t length) {
+  if (length > self->length - self->offset) return false;
+  memcpy(contents, &self->data[self->offset], length);
+  self->offset += length;
+  return true;
+}
+
+static bool ts_query__read_array(QueryReader *self, Array *array, size_t element_size) {
+  uint32_t size;
+  if (!ts_query__read(self, &size, sizeof(size))) return false;
+  if ((uint64_t)size * element_size > self->length - self->offset) return false;
+  if (size == 0) return true;
+  _array__reserve(array, element_size, size);
+  array->size = size;
+  return ts_query__read(self, array->contents, size * element_size);
+}
+
+#define ts_query__read_array(reader, array) \
+  ts_query__read_array(reader, (Array *)(array), array_elem_size(array))
+
+static bool ts_query__read_u16(QueryReader *self, uint16_t *value) {
+  return ts_query__read(self, value, sizeof(*value));
+}
+
+static bool ts_query__read_u32(QueryReader *self, uint32_t *value) {
+  return ts_query__read(self, value, sizeof(*value));
+}
+
+// Read a byte that stores a `bool`, rejecting any other value.
+static bool ts_query__read_bool(QueryReader *self, bool *value) {
+  uint8_t byte;
+  if (!ts_query__read(self, &byte, sizeof(byte)) || byte > 1) return false;
+  *value = byte;
+  return true;
+}
+
+#define QUERY_STEP_SERIALIZED_SIZE ((7 + MAX_STEP_CAPTURE_COUNT) * sizeof(uint16_t))
+#define PATTERN_ENTRY_SERIALIZED_SIZE (2 * sizeof(uint16_t) + 1)
+#define QUERY_PATTERN_SERIALIZED_SIZE (5 * sizeof(uint32_t) + 1)
+#define STEP_OFFSET_SERIALIZED_SIZE (sizeof(uint32_t) + sizeof(uint16_t))
+
+static bool ts_query__read_step(QueryReader *self, void *element) {
+  QueryStep *step = element;
+  uint16_t flags;
+  memset(step, 0, sizeof(*step));
+  if (
+    !ts_query__read_u16(self, &step->symbol) ||
+    !ts_query__read_u16(self, &step->supertype_symbol) ||
+    !ts_query__read_u16(self, &step->field)
+  ) return false;
+  for (unsigned i = 0; i < MAX_STEP_CAPTURE_COUNT; i++) {
+    if (!ts_query__read_u16(self, &step->capture_ids[i])) return false;
+  }
+  if (
+    !ts_query__read_u16(self, &step->depth) ||
+    !ts_query__read_u16(self, &step->alternative_index) ||
+    !ts_query__read_u16(self, &step->negated_field_list_id) ||
+    !ts_query__read_u16(self, &flags) ||
+    flags >> 9 != 0
+  ) return false;
+  step->is_named = flags & 1 << 0;
+  step->is_immediate = flags & 1 << 1;
+  step->is_last_child = flags & 1 << 2;
+  step->is_pass_through = flags & 1 << 3;
+  step->is_dead_end = flags & 1 << 4;
+  step->alternative_is_immediate = flags & 1 << 5;
+  step->contains_captures = flags & 1 << 6;
+  step->root_pattern_guaranteed = flags & 1 << 7;
+  step->parent_pattern_guaranteed = flags & 1 << 8;
+  return true;
+}
+
+static bool ts_query__read_pattern_entry(QueryReader *self, void *element) {
+  PatternEntry *entry = element;
+  memset(entry, 0, sizeof(*entry));
+  return
+    ts_query__read_u16(self, &entry->step_index) &&
+    ts_query__read_u16(self, &entry->pattern_index) &&
+    ts_query__read_bool(self, &entry->is_rooted);
+}
+
+static bool ts_query__read_pattern(QueryReader *self, void *element) {
+  QueryPattern *pattern = element;
+  memset(pattern, 0, sizeof(*pattern));
+  return
+    ts_query__read_u32(self, &pattern->steps.offset) &&
+    ts_query__read_u32(self, &pattern->steps.length) &&
+    ts_query__read_u32(self, &pattern->predicate_steps.offset) &&
+    ts_query__read_u32(self, &pattern->predicate_steps.length) &&
+    ts_query__read_u32(self, &pattern->start_byte) &&
+    ts_query__read_bool(self, &pattern->is_non_local);
+}
+
+static bool ts_query__read_step_offset(QueryReader *self, void *element) {
+  StepOffset *step_offset = element;
+  memset(step_offset, 0, sizeof(*step_offset));
+  return
+    ts_query__read_u32(self, &step_offset->byte_offset) &&
+    ts_query__read_u16(self, &step_offset->step_index);
+}
+
+static bool ts_query__read_fields(
+  QueryReader *self,
+  Array *array,
+  size_t element_size,
+  size_t serialized_element_size,
+  bool (*read_element)(QueryReader *, void *)
+) {
+  uint32_t size;
+  if (!ts_query__read_u32(self, &size)) return false;
+  if ((uint64_t)size * serialized_element_size > self->length - self->offset) return false;
+  if (size == 0) return true;
+  _array__reserve(array, element_size, size);
+  for (uint32_t i = 0; i < size; i++) {
+    if (!read_element(self, (char *)array->contents + i * element_size)) return false;
+    array->size++;
+  }
+  return true;
+}
+
+#define ts_query__read_fields(reader, array, serialized_element_size, read_element) \
+  ts_query__read_fields( \
+    reader, \
+    (Array *)(array), \
+    array_elem_size(array), \
+    serialized_element_size, \
+    read_element \
+  )
+
+static bool ts_query__slice_is_valid(Slice slice, uint32_t size) {
+  return slice.offset <= size && slice.length <= size - slice.offset;
+}
+
+static bool symbol_table_is_valid(const SymbolTable *self) {
+  if (self->slices.size > NONE) return false;
+  for (uint32_t i = 0; i < self->slices.size; i++) {
+    Slice slice = self->slices.contents[i];
+    if (
+      slice.offset >= self->characters.size ||
+      slice.length >= self->characters.size - slice.offset ||
+      self->characters.contents[slice.offset + slice.length] != 0
+    ) return false;
+  }
+  return true;
+}
+
+static bool ts_query__symbol_is_valid(const TSQuery *self, TSSymbol symbol) {
+  return symbol < self->language->symbol_count || symbol == ts_builtin_sym_error;
+}
+
+// Check that following the steps' alternatives, as the query cursor does when it
+// splits its states, always terminates. Each step is marked as unvisited (0),
+// on the current path (1), or finished (2) by an iterative depth-first search.
+static bool ts_query__alternatives_are_acyclic(const TSQuery *self) {
+  Array(uint8_t) marks = array_new();
+  Array(uint32_t) stack = array_new();
+  array_grow_by(&marks, self->steps.size);
+
+  bool result = true;
+  for (uint32_t i = 0; result && i < self->steps.size; i++) {
+    if (marks.contents[i]) continue;
+    array_push(&stack, i);
+    while (result && stack.size > 0) {
+      uint32_t step_index = *array_back(&stack);
+      if (marks.contents[step_index]) {
+        marks.contents[step_index] = 2;
+        (void)array_pop(&stack);
+        continue;
+      }
+
+      marks.contents[step_index] = 1;
+      const QueryStep *step = &self->steps.contents[step_index];
+      if (step->alternative_index == NONE) continue;
+      uint32_t successors[2] = {step->alternative_index, NONE};
+      if (step->is_pass_through && !step->is_dead_end) successors[1] = step_index + 1;
+      for (unsigned j = 0; j < 2; j++) {
+        uint32_t successor = successors[j];
+        if (successor == NONE) continue;
+        if (successor >= self->steps.size || marks.contents[successor] == 1) {
+          result = false;
+          break;
+        }
+        if (marks.contents[successor] == 0) array_push(&stack, successor);
+      }
+    }
+  }
+
+  array_delete(&marks);
+  array_delete(&stack);
+  return result;
+}
+
+// Check that every index stored in a deserialized query refers to an element of
+// the array that it indexes, and that every symbol and field id belongs to the
+// query's language, so that corrupted data can't cause out-of-bounds accesses.
+static bool ts_query__is_valid(const TSQuery *self) {
+  uint32_t capture_count = self->captures.slices.size;
+  uint32_t string_count = self->predicate_values.slices.size;
+  uint32_t field_count = self->language->field_count;
+
+  if (
+    !symbol_table_is_valid(&self->captures) ||
+    !symbol_table_is_valid(&self->predicate_values) ||
+    self->capture_quantifiers.size != self->patterns.size ||
+    self->steps.size == 0 ||
+    array_back(&self->steps)->depth != PATTERN_DONE_MARKER ||
+    self->negated_fields.size == 0 ||
+    *array_back(&self->negated_fields) != 0 ||
+    self->wildcard_root_pattern_count > self->pattern_map.size
+  ) return false;
+
+  for (uint32_t i = 0; i < self->capture_quantifiers.size; i++) {
+    const CaptureQuantifiers *capture_quantifiers = &self->capture_quantifiers.contents[i];
+    for (uint32_t j = 0; j < capture_quantifiers->size; j++) {
+      if (capture_quantifiers->contents[j] > TSQuantifierOneOrMore) return false;
+    }
+  }
+
+  for (uint32_t i = 0; i < self->steps.size; i++) {
+    const QueryStep *step = &self->steps.contents[i];
+    if (
+      !ts_query__symbol_is_valid(self, step->symbol) ||
+      !ts_query__symbol_is_valid(self, step->supertype_symbol) ||
+      step->field > field_count ||
+      step->negated_field_list_id >= self->negated_fields.size ||
+      (step->alternative_index != NONE && step->alternative_index >= self->steps.size)
+    ) return false;
+    for (unsigned j = 0; j < MAX_STEP_CAPTURE_COUNT; j++) {
+      uint16_t capture_id = step->capture_ids[j];
+      if (capture_id != NONE && capture_id >= capture_count) return false;
+    }
+  }
+
+  // When a pattern starts with a wildcard, its entry points to its second step, and
+  // the query cursor searches backward from there for the wildcard step, in order to
+  // capture the parent node. Check that some earlier step ends that search.
+  uint32_t first_wildcard_search_end = UINT32_MAX;
+  for (uint32_t i = 0; i < self->steps.size; i++) {
+    const QueryStep *step = &self->steps.contents[i];
+    if (!step->is_dead_end && !step->is_pass_through && step->depth == 0) {
+      first_wildcard_search_end = i;
+      break;
+    }
+  }
+
+  for (uint32_t i = 0; i < self->pattern_map.size; i++) {
+    const PatternEntry *entry = &self->pattern_map.contents[i];
+    if (
+      entry->step_index >= self->steps.size ||
+      entry->pattern_index >= self->patterns.size
+    ) return false;
+    if (
+      self->steps.contents[entry->step_index].depth == 1 &&
+      entry->step_index <= first_wildcard_search_end
+    ) return false;
+  }
+
+  for (uint32_t i = 0; i < self->patterns.size; i++) {
+    const QueryPattern *pattern = &self->patterns.contents[i];
+    if (
+      !ts_query__slice_is_valid(pattern->steps, self->steps.size) ||
+      !ts_query__slice_is_valid(pattern->predicate_steps, self->predicate_steps.size)
+    ) return false;
+  }
+
+  for (uint32_t i = 0; i < self->predicate_steps.size; i++) {
+    const TSQueryPredicateStep *step = &self->predicate_steps.contents[i];
+    switch (step->type) {
+      case TSQueryPredicateStepTypeDone:
+        break;
+      case TSQueryPredicateStepTypeCapture:
+        if (step->value_id >= capture_count) return false;
+        break;
+      case TSQueryPredicateStepTypeString:
+        if (step->value_id >= string_count) return false;
+        break;
+      default:
+        return false;
+    }
+  }
+
+  for (uint32_t i = 0; i < self->step_offsets.size; i++) {
+    if (self->step_offsets.contents[i].step_index >= self->steps.size) return false;
+  }
+
+  for (uint32_t i = 0; i < self->negated_fields.size; i++) {
+    if (self->negated_fields.contents[i] > field_count) return false;
+  }
+
+  for (uint32_t i = 0; i < self->repeat_symbols_with_rootless_patterns.size; i++) {
+    TSSymbol symbol = self->repeat_symbols_with_rootless_patterns.contents[i];
+    if (!ts_query__symbol_is_valid(self, symbol)) return false;
+  }
+
+  return ts_query__alternatives_are_acyclic(self);
+}
+
+char *ts_query_serialize(const TSQuery *self, uint32_t *length) {
+  QuerySerializationHeader header = {
+    .magic = QUERY_SERIALIZATION_MAGIC,
+    .version = QUERY_SERIALIZATION_VERSION,
+    .language_version = self->language->version,
+    .symbol_count = self->language->symbol_count,
+    .field_count = self->language->field_count,
+    .predicate_step_size = sizeof(TSQueryPredicateStep),
+    .wildcard_root_pattern_count = self->wildcard_root_pattern_count,
+  };
+
+  Array buffer = array_new();
+  ts_query__write(&buffer, &header, sizeof(header));
+  ts_query__write_array(&buffer, &self->captures.characters);
+  ts_query__write_array(&buffer, &self->captures.slices);
+  ts_query__write_array(&buffer, &self->predicate_values.characters);
+  ts_query__write_array(&buffer, &self->predicate_values.slices);
+  ts_query__write(&buffer, &self->capture_quantifiers.size, sizeof(uint32_t));
+  for (uint32_t i = 0; i < self->capture_quantifiers.size; i++) {
+    ts_query__write_array(&buffer, &self->capture_quantifiers.contents[i]);
+  }
+  ts_query__write_fields(&buffer, &self->steps, ts_query__write_step);
+  ts_query__write_fields(&buffer, &self->pattern_map, ts_query__write_pattern_entry);
+  ts_query__write_array(&buffer, &self->predicate_steps);
+  ts_query__write_fields(&buffer, &self->patterns, ts_query__write_pattern);
+  ts_query__write_fields(&buffer, &self->step_offsets, ts_query__write_step_offset);
+  ts_query__write_array(&buffer, &self->negated_fields);
+  ts_query__write_array(&buffer, &self->string_buffer);
+  ts_query__write_array(&buffer, &self->repeat_symbols_with_rootless_patterns);
+
+  *length = buffer.size;
+  return (char *)buffer.contents;
+}
+
+TSQuery *ts_query_deserialize(
+  const TSLanguage *language,
+  const char *data,
+  uint32_t length
+) {
+  QueryReader reader = {.data = data, .length = length, .offset = 0};
+  QuerySerializationHeader header;
+  if (
+    !language ||
+    !ts_query__read(&reader, &header, sizeof(header)) ||
+    header.magic != QUERY_SERIALIZATION_MAGIC ||
+    header.version != QUERY_SERIALIZATION_VERSION ||
+    header.language_version != language->version ||
+    header.symbol_count != language->symbol_count ||
+    header.field_count != language->field_count ||
+    header.predicate_step_size != sizeof(TSQueryPredicateStep)
+  ) {
+    return NULL;
+  }
+
+  TSQuery *self = ts_malloc(sizeof(TSQuery));
+  *self = (TSQuery) {
+    .steps = array_new(),
+    .pattern_map = array_new(),
+    .captures = symbol_table_new(),
+    .capture_quantifiers = array_new(),
+    .predicate_values = symbol_table_new(),
+    .predicate_steps = array_new(),
+    .patterns = array_new(),
+    .step_offsets = array_new(),
+    .string_buffer = array_new(),
+    .negated_fields = array_new(),
+    .repeat_symbols_with_rootless_patterns = array_new(),
+    .wildcard_root_pattern_count = header.wildcard_root_pattern_count,
+    .language = ts_language_copy(language),
+  };
+
+  uint32_t capture_quantifiers_count;
+  bool ok =
+    ts_query__read_array(&reader, &self->captures.characters) &&
+    ts_query__read_array(&reader, &self->captures.slices) &&
+    ts_query__read_array(&reader, &self->predicate_values.characters) &&
+    ts_query__read_array(&reader, &self->predicate_values.slices) &&
+    ts_query__read(&reader, &capture_quantifiers_count, sizeof(uint32_t)) &&
+    capture_quantifiers_count <= length - reader.offset;
+  for (uint32_t i = 0; ok && i < capture_quantifiers_count; i++) {
+    array_push(&self->capture_quantifiers, capture_quantifiers_new());
+    ok = ts_query__read_array(&reader, array_back(&self->capture_quantifiers));
+  }
+  ok = ok &&
+    ts_query__read_fields(&reader, &self->steps, QUERY_STEP_SERIALIZED_SIZE, ts_query__read_step) &&
+    ts_query__read_fields(
+      &reader,
+      &self->pattern_map,
+      PATTERN_ENTRY_SERIALIZED_SIZE,
+      ts_query__read_pattern_entry
+    ) &&
+    ts_query__read_array(&reader, &self->predicate_steps) &&
+    ts_query__read_fields(
+      &reader,
+      &self->patterns,
+      QUERY_PATTERN_SERIALIZED_SIZE,
+      ts_query__read_pattern
+    ) &&
+    ts_query__read_fields(
+      &reader,
+      &self->step_offsets,
+      STEP_OFFSET_SERIALIZED_SIZE,
+      ts_query__read_step_offset
+    ) &&
+    ts_query__read_array(&reader, &self->negated_fields) &&
+    ts_query__read_array(&reader, &self->string_buffer) &&
+    ts_query__read_array(&reader, &self->repeat_symbols_with_rootless_patterns) &&
+    reader.offset == length &&
+    ts_query__is_valid(self);
+
+  if (!ok) {
+    ts_query_delete(self);
+    return NULL;
+  }
+  return self;
+}
+
 uint32_t ts_query_pattern_count(const TSQuery *self) {
   return self->patterns.size;
 }
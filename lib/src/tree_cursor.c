@@ -466,6 +466,121 @@ void ts_tree_cursor_goto_descendant(
   } while (did_descend);
 }
 
+static inline bool ts_tree_cursor__entry_contains(
+  const TreeCursorEntry *entry,
+  Length goal,
+  bool use_point
+) {
+  Length end = length_add(entry->position, ts_subtree_size(*entry->subtree));
+  if (use_point) {
+    return point_lte(entry->position.extent, goal.extent) && point_lt(goal.extent, end.extent);
+  } else {
+    return entry->position.bytes <= goal.bytes && goal.bytes < end.bytes;
+  }
+}
+
+static inline void ts_tree_cursor_goto_descendant_for_byte_and_point(
+  TSTreeCursor *_self,
+  Length goal,
+  bool use_point
+) {
+  TreeCursor *self = (TreeCursor *)_self;
+
+  // Ascend to the lowest ancestor that contains the goal position, so that
+  // nearby moves only revisit a few levels of the tree.
+  while (
+    self->stack.size > 1 &&
+    !ts_tree_cursor__entry_contains(array_back(&self->stack), goal, use_point)
+  ) {
+    self->stack.size--;
+  }
+
+  // Descend to the deepest node that contains the goal position.
+  bool did_descend = true;
+  while (did_descend) {
+    did_descend = false;
+    bool visible;
+    TreeCursorEntry entry;
+    CursorChildIterator iterator = ts_tree_cursor_iterate_children(self);
+    while (ts_tree_cursor_child_iterator_next(&iterator, &entry, &visible)) {
+      if (ts_tree_cursor__entry_contains(&entry, goal, use_point)) {
+        array_push(&self->stack, entry);
+        did_descend = true;
+        break;
+      }
+
+      // The children are in order, so no later child can contain the goal.
+      bool is_after_goal = use_point
+        ? point_lt(goal.extent, entry.position.extent)
+        : goal.bytes < entry.position.bytes;
+      if (is_after_goal) break;
+    }
+  }
+
+  // The deepest node that was reached may be hidden.
+  while (!ts_tree_cursor_is_entry_visible(self, self->stack.size - 1)) {
+    self->stack.size--;
+  }
+}
+
+void ts_tree_cursor_goto_descendant_for_byte(TSTreeCursor *self, uint32_t goal_byte) {
+  ts_tree_cursor_goto_descendant_for_byte_and_point(self, (Length) {goal_byte, POINT_ZERO}, false);
+}
+
+void ts_tree_cursor_goto_descendant_for_point(TSTreeCursor *self, TSPoint goal_point) {
+  ts_tree_cursor_goto_descendant_for_byte_and_point(self, (Length) {0, goal_point}, true);
+}
+
+static inline bool ts_tree_cursor__push_next_child(
+  TreeCursor *self,
+  CursorChildIterator *iterator,
+  bool *visible
+) {
+  TreeCursorEntry entry;
+  while (ts_tree_cursor_child_iterator_next(iterator, &entry, visible)) {
+    if (*visible || ts_subtree_visible_child_count(*entry.subtree) > 0) {
+      array_push(&self->stack, entry);
+      return true;
+    }
+  }
+  return false;
+}
+
+bool ts_tree_cursor_goto_next_descendant(TSTreeCursor *_self) {
+  TreeCursor *self = (TreeCursor *)_self;
+  bool visible;
+
+  // Visit the current node's first child, if it has one. Otherwise, climb
+  // until an ancestor has a next sibling that contains a visible node.
+  CursorChildIterator iterator = ts_tree_cursor_iterate_children(self);
+  if (!ts_tree_cursor__push_next_child(self, &iterator, &visible)) {
+    for (;;) {
+      if (self->stack.size <= 1) return false;
+      TreeCursorEntry entry = array_pop(&self->stack);
+      Subtree parent = *array_back(&self->stack)->subtree;
+      iterator = (CursorChildIterator) {
+        .tree = self->tree,
+        .parent = parent,
+        .position = entry.position,
+        .child_index = entry.child_index,
+        .structural_child_index = entry.structural_child_index,
+        .descendant_index = entry.descendant_index,
+        .alias_sequence = ts_language_alias_sequence(self->tree->language, parent.ptr->production_id),
+      };
+      ts_tree_cursor_child_iterator_next(&iterator, &entry, &visible);
+      if (ts_tree_cursor__push_next_child(self, &iterator, &visible)) break;
+    }
+  }
+
+  // Hidden nodes are only pushed if they contain a visible node, so
+  // descending through them always reaches one.
+  while (!visible) {
+    iterator = ts_tree_cursor_iterate_children(self);
+    ts_tree_cursor__push_next_child(self, &iterator, &visible);
+  }
+  return true;
+}
+
 uint32_t ts_tree_cursor_current_descendant_index(const TSTreeCursor *_self) {
   const TreeCursor *self = (const TreeCursor *)_self;
   TreeCursorEntry *last_entry = array_back(&self->stack);
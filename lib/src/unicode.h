@@ -43,6 +43,37 @@ static inline uint32_t ts_decode_utf16(
   return i * 2;
 }
 
+static inline uint32_t ts_decode_utf16_be(
+  const uint8_t *string,
+  uint32_t length,
+  int32_t *code_point
+) {
+  if (length < 2) {
+    *code_point = TS_DECODE_ERROR;
+    return 1;
+  }
+  uint16_t unit = (uint16_t)(string[0] << 8 | string[1]);
+  *code_point = unit;
+  if (U16_IS_LEAD(unit) && length >= 4) {
+    uint16_t trail = (uint16_t)(string[2] << 8 | string[3]);
+    if (U16_IS_TRAIL(trail)) {
+      *code_point = U16_GET_SUPPLEMENTARY(unit, trail);
+      return 4;
+    }
+  }
+  return 2;
+}
+
+static inline uint32_t ts_decode_latin1(
+  const uint8_t *string,
+  uint32_t length,
+  int32_t *code_point
+) {
+  (void)length;
+  *code_point = string[0];
+  return 1;
+}
+
 #ifdef __cplusplus
 }
 #endif
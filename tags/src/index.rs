@@ -0,0 +1,613 @@
+//! A compact, sorted binary index of the tags in many files.
+//!
+//! A [`TagsIndexBuilder`] collects the tags for a set of files, tagging them on several
+//! threads if needed, and writes them out as an index. A [`TagsIndex`] answers lookups by
+//! name by binary searching that index through any [`Read`] + [`Seek`] source, reading only
+//! the records that it needs. The index is made of fixed-size little-endian records, so it
+//! can also be memory-mapped and read through an [`io::Cursor`].
+//!
+//! The index consists of a header followed by these sections:
+//!
+//! * The files, sorted by path, as string references.
+//! * The syntax types, sorted by name, as string references.
+//! * The tag names, sorted bytewise, as string references followed by the index and the
+//!   number of their tags.
+//! * The tags, sorted by name, then by file, then by position.
+//! * The string data that the other sections refer to.
+
+use std::{
+    collections::HashMap,
+    fs,
+    io::{self, Read, Seek, SeekFrom, Write},
+    num::NonZeroUsize,
+    ops::Range,
+    path::Path,
+    str,
+    sync::{
+        atomic::{AtomicUsize, Ordering},
+        Mutex,
+    },
+    thread,
+};
+
+use tree_sitter::Point;
+
+use crate::{Tag, TagsConfiguration, TagsContext};
+
+const MAGIC: &[u8; 8] = b"TSTAGIDX";
+const VERSION: u32 = 1;
+const HEADER_SIZE: u64 = 32;
+const STRING_REF_SIZE: u64 = 8;
+const NAME_RECORD_SIZE: u64 = 16;
+const TAG_RECORD_SIZE: u64 = 44;
+const DEFINITION_FLAG: u32 = 1;
+
+/// Collects the tags for a set of files, and writes them as a binary index.
+#[derive(Default)]
+pub struct TagsIndexBuilder {
+    file_ids: HashMap<String, usize>,
+    files: Vec<Option<(String, Vec<IndexEntry>)>>,
+    names: HashMap<Box<[u8]>, u32>,
+    syntax_types: HashMap<Box<[u8]>, u32>,
+}
+
+/// A binary tags index, written by a [`TagsIndexBuilder`].
+pub struct TagsIndex<R> {
+    reader: R,
+    header: Header,
+    syntax_types: Vec<String>,
+}
+
+/// A tag that was found in a [`TagsIndex`].
+#[derive(Debug, Clone, PartialEq, Eq)]
+pub struct IndexedTag {
+    pub path: String,
+    pub syntax_type: String,
+    pub is_definition: bool,
+    pub range: Range<usize>,
+    pub name_range: Range<usize>,
+    pub span: Range<Point>,
+}
+
+#[derive(Clone, Copy)]
+struct IndexEntry {
+    name: u32,
+    syntax_type: u32,
+    is_definition: bool,
+    range: [u32; 2],
+    name_range: [u32; 2],
+    span: [u32; 4],
+}
+
+#[derive(Clone, Copy)]
+struct Header {
+    file_count: u32,
+    syntax_type_count: u32,
+    name_count: u32,
+    tag_count: u32,
+    string_len: u32,
+}
+
+impl TagsIndexBuilder {
+    #[must_use]
+    pub fn new() -> Self {
+        Self::default()
+    }
+
+    /// Create a builder that contains all of the files in an existing index, so that some
+    /// of them can be replaced or removed, and the index rewritten.
+    pub fn from_index<R: Read + Seek>(index: &mut TagsIndex<R>) -> io::Result<Self> {
+        let header = index.header;
+        let mut sections = Vec::new();
+        index.reader.seek(SeekFrom::Start(HEADER_SIZE))?;
+        index
+            .reader
+            .by_ref()
+            .take(header.len() - HEADER_SIZE)
+            .read_to_end(&mut sections)?;
+        if sections.len() as u64 != header.len() - HEADER_SIZE {
+            return Err(invalid_data("truncated tags index"));
+        }
+
+        let mut words = sections
+            .chunks_exact(4)
+            .map(|chunk| u32::from_le_bytes(chunk.try_into().unwrap()));
+        let mut next_string_ref = || [words.next().unwrap(), words.next().unwrap()];
+        let file_refs = (0..header.file_count)
+            .map(|_| next_string_ref())
+            .collect::<Vec<_>>();
+        let syntax_type_refs = (0..header.syntax_type_count)
+            .map(|_| next_string_ref())
+            .collect::<Vec<_>>();
+        let name_records = (0..header.name_count)
+            .map(|_| [next_string_ref(), next_string_ref()])
+            .collect::<Vec<_>>();
+        let tag_records = (0..header.tag_count)
+            .map(|_| {
+                let mut record = [0; 11];
+                record.fill_with(|| words.next().unwrap());
+                record
+            })
+            .collect::<Vec<_>>();
+        let strings = &sections[sections.len() - header.string_len as usize..];
+        let string = |[offset, len]: [u32; 2]| {
+            strings
+                .get(offset as usize..offset as usize + len as usize)
+                .ok_or_else(|| invalid_data("invalid string in tags index"))
+        };
+
+        let mut builder = Self::new();
+        for string_ref in &file_refs {
+            let path = str::from_utf8(string(*string_ref)?)
+                .map_err(|_| invalid_data("invalid path in tags index"))?;
+            builder
+                .file_ids
+                .insert(path.to_string(), builder.files.len());
+            builder.files.push(Some((path.to_string(), Vec::new())));
+        }
+        for (id, string_ref) in syntax_type_refs.iter().enumerate() {
+            builder
+                .syntax_types
+                .insert(string(*string_ref)?.into(), id as u32);
+        }
+        for (id, [string_ref, [first_tag, tag_count]]) in name_records.iter().enumerate() {
+            builder.names.insert(string(*string_ref)?.into(), id as u32);
+            let tags = tag_records
+                .get(*first_tag as usize..*first_tag as usize + *tag_count as usize)
+                .ok_or_else(|| invalid_data("invalid name in tags index"))?;
+            for record in tags {
+                let entries = builder
+                    .files
+                    .get_mut(record[0] as usize)
+                    .and_then(Option::as_mut)
+                    .ok_or_else(|| invalid_data("invalid file in tags index"))?;
+                entries.1.push(IndexEntry {
+                    name: id as u32,
+                    syntax_type: record[1],
+                    is_definition: record[2] & DEFINITION_FLAG != 0,
+                    range: [record[3], record[4]],
+                    name_range: [record[5], record[6]],
+                    span: [record[7], record[8], record[9], record[10]],
+                });
+            }
+        }
+        Ok(builder)
+    }
+
+    /// Add the tags for a file, replacing any tags that were previously added for the same
+    /// path.
+    ///
+    /// The `tags` must have been generated from `source` using `config`.
+    pub fn add_file(
+        &mut self,
+        path: &str,
+        source: &[u8],
+        config: &TagsConfiguration,
+        tags: &[Tag],
+    ) -> io::Result<()> {
+        let mut entries = Vec::with_capacity(tags.len());
+        for tag in tags {
+            entries.push(IndexEntry {
+                name: intern(&mut self.names, &source[tag.name_range.clone()]),
+                syntax_type: intern(
+                    &mut self.syntax_types,
+                    config.syntax_type_name(tag.syntax_type_id).as_bytes(),
+                ),
+                is_definition: tag.is_definition,
+                range: [to_u32(tag.range.start)?, to_u32(tag.range.end)?],
+                name_range: [to_u32(tag.name_range.start)?, to_u32(tag.name_range.end)?],
+                span: [
+                    to_u32(tag.span.start.row)?,
+                    to_u32(tag.span.start.column)?,
+                    to_u32(tag.span.end.row)?,
+                    to_u32(tag.span.end.column)?,
+                ],
+            });
+        }
+
+        let file = Some((path.to_string(), entries));
+        if let Some(id) = self.file_ids.get(path) {
+            self.files[*id] = file;
+        } else {
+            self.file_ids.insert(path.to_string(), self.files.len());
+            self.files.push(file);
+        }
+        Ok(())
+    }
+
+    /// Read and tag a list of files on up to `thread_count` threads, and add their tags.
+    ///
+    /// Each thread uses its own [`TagsContext`]. Any existing tags for the same paths are
+    /// removed first, so files that fail to be read or tagged are left out of the index.
+    /// Their errors are returned along with their positions in `files`.
+    pub fn add_files<P: AsRef<Path> + Sync>(
+        &mut self,
+        files: &[(P, &TagsConfiguration)],
+        thread_count: NonZeroUsize,
+        cancellation_flag: Option<&AtomicUsize>,
+    ) -> Vec<(usize, io::Error)> {
+        for (path, _) in files {
+            self.remove_file(&path.as_ref().to_string_lossy());
+        }
+
+        let next_file = AtomicUsize::new(0);
+        let state = Mutex::new((self, Vec::new()));
+        let tag_files = || {
+            let mut context = TagsContext::new();
+            loop {
+                let index = next_file.fetch_add(1, Ordering::Relaxed);
+                let Some((path, config)) = files.get(index) else {
+                    break;
+                };
+                let result = fs::read(path).and_then(|source| {
+                    let tags = context
+                        .generate_tags(config, &source, cancellation_flag)
+                        .and_then(|(tags, _)| tags.collect::<Result<Vec<_>, _>>())
+                        .map_err(io::Error::other)?;
+                    Ok((source, tags))
+                });
+
+                let mut state = state.lock().unwrap();
+                let (builder, errors) = &mut *state;
+                if let Err(error) = result.and_then(|(source, tags)| {
+                    let path = path.as_ref().to_string_lossy();
+                    builder.add_file(&path, &source, config, &tags)
+                }) {
+                    errors.push((index, error));
+                }
+            }
+        };
+
+        let thread_count = thread_count.get().min(files.len());
+        if thread_count <= 1 {
+            tag_files();
+        } else {
+            thread::scope(|scope| {
+                for _ in 0..thread_count {
+                    scope.spawn(tag_files);
+                }
+            });
+        }
+
+        let mut errors = state.into_inner().unwrap().1;
+        errors.sort_unstable_by_key(|(index, _)| *index);
+        errors
+    }
+
+    /// Remove the tags for a file.
+    pub fn remove_file(&mut self, path: &str) {
+        if let Some(id) = self.file_ids.remove(path) {
+            self.files[id] = None;
+        }
+    }
+
+    /// Get the paths of the files in the index, in the order in which they were added.
+    pub fn paths(&self) -> impl Iterator<Item = &str> {
+        self.files.iter().flatten().map(|(path, _)| path.as_str())
+    }
+
+    /// Write the index.
+    ///
+    /// The index is written using many small writes, so the writer should be buffered.
+    pub fn write(&self, writer: &mut impl Write) -> io::Result<()> {
+        let mut files = self.files.iter().flatten().collect::<Vec<_>>();
+        files.sort_unstable_by(|a, b| a.0.cmp(&b.0));
+
+        // Number the names that are still in use, and the syntax types, in sorted order.
+        let mut name_used = vec![false; self.names.len()];
+        for (_, entries) in &files {
+            for entry in entries {
+                name_used[entry.name as usize] = true;
+            }
+        }
+        let mut names = self
+            .names
+            .iter()
+            .filter(|(_, id)| name_used[**id as usize])
+            .collect::<Vec<_>>();
+        names.sort_unstable();
+        let mut name_ids = vec![0; self.names.len()];
+        for (new_id, (_, id)) in names.iter().enumerate() {
+            name_ids[**id as usize] = new_id as u32;
+        }
+        let mut syntax_types = self.syntax_types.iter().collect::<Vec<_>>();
+        syntax_types.sort_unstable();
+        let mut syntax_type_ids = vec![0; self.syntax_types.len()];
+        for (new_id, (_, id)) in syntax_types.iter().enumerate() {
+            syntax_type_ids[**id as usize] = new_id as u32;
+        }
+
+        let mut tags = files
+            .iter()
+            .enumerate()
+            .flat_map(|(file, (_, entries))| entries.iter().map(move |entry| (file as u32, entry)))
+            .map(|(file, entry)| {
+                let mut record = [0; 11];
+                record[0] = file;
+                record[1] = syntax_type_ids[entry.syntax_type as usize];
+                record[2] = if entry.is_definition {
+                    DEFINITION_FLAG
+                } else {
+                    0
+                };
+                record[3..5].copy_from_slice(&entry.range);
+                record[5..7].copy_from_slice(&entry.name_range);
+                record[7..11].copy_from_slice(&entry.span);
+                (name_ids[entry.name as usize], record)
+            })
+            .collect::<Vec<_>>();
+        tags.sort_unstable_by_key(|(name, record)| (*name, record[0], record[5], record[3]));
+
+        let mut strings = Vec::<u8>::new();
+        let mut add_string = |string: &[u8]| -> io::Result<[u32; 2]> {
+            let string_ref = [to_u32(strings.len())?, to_u32(string.len())?];
+            strings.extend_from_slice(string);
+            Ok(string_ref)
+        };
+        let file_refs = files
+            .iter()
+            .map(|(path, _)| add_string(path.as_bytes()))
+            .collect::<io::Result<Vec<_>>>()?;
+        let syntax_type_refs = syntax_types
+            .iter()
+            .map(|(name, _)| add_string(name))
+            .collect::<io::Result<Vec<_>>>()?;
+        let name_refs = names
+            .iter()
+            .map(|(name, _)| add_string(name))
+            .collect::<io::Result<Vec<_>>>()?;
+
+        writer.write_all(MAGIC)?;
+        write_u32s(
+            writer,
+            &[
+                VERSION,
+                to_u32(file_refs.len())?,
+                to_u32(syntax_type_refs.len())?,
+                to_u32(name_refs.len())?,
+                to_u32(tags.len())?,
+                to_u32(strings.len())?,
+            ],
+        )?;
+        for string_ref in file_refs.iter().chain(&syntax_type_refs) {
+            write_u32s(writer, string_ref)?;
+        }
+        let mut first_tag = 0;
+        for (id, string_ref) in name_refs.iter().enumerate() {
+            let tag_count = tags[first_tag..]
+                .iter()
+                .take_while(|(name, _)| *name == id as u32)
+                .count();
+            write_u32s(writer, string_ref)?;
+            write_u32s(writer, &[first_tag as u32, tag_count as u32])?;
+            first_tag += tag_count;
+        }
+        for (_, record) in &tags {
+            write_u32s(writer, record)?;
+        }
+        writer.write_all(&strings)?;
+        writer.flush()
+    }
+}
+
+impl<R: Read + Seek> TagsIndex<R> {
+    /// Open an index, reading only its header and its list of syntax types.
+    pub fn new(mut reader: R) -> io::Result<Self> {
+        let mut magic = [0; 8];
+        reader.seek(SeekFrom::Start(0))?;
+        reader.read_exact(&mut magic)?;
+        let [version, file_count, syntax_type_count, name_count, tag_count, string_len] =
+            read_u32s(&mut reader)?;
+        if &magic != MAGIC || version != VERSION {
+            return Err(invalid_data("unsupported tags index format"));
+        }
+
+        let header = Header {
+            file_count,
+            syntax_type_count,
+            name_count,
+            tag_count,
+            string_len,
+        };
+        let mut index = Self {
+            reader,
+            header,
+            syntax_types: Vec::new(),
+        };
+        if index.reader.seek(SeekFrom::End(0))? < header.len() {
+            return Err(invalid_data("truncated tags index"));
+        }
+        index.syntax_types = (0..syntax_type_count)
+            .map(|i| {
+                let offset = header.syntax_types_offset() + u64::from(i) * STRING_REF_SIZE;
+                let string_ref = index.read_u32s_at(offset)?;
+                index.read_string(string_ref)
+            })
+            .collect::<io::Result<_>>()?;
+        Ok(index)
+    }
+
+    #[must_use]
+    pub const fn file_count(&self) -> usize {
+        self.header.file_count as usize
+    }
+
+    #[must_use]
+    pub const fn name_count(&self) -> usize {
+        self.header.name_count as usize
+    }
+
+    #[must_use]
+    pub const fn tag_count(&self) -> usize {
+        self.header.tag_count as usize
+    }
+
+    /// Get all of the tags with the given name, sorted by path and position.
+    pub fn tags(&mut self, name: &str) -> io::Result<Vec<IndexedTag>> {
+        let header = self.header;
+        let Some([first_tag, tag_count]) = self.find_name(name.as_bytes())? else {
+            return Ok(Vec::new());
+        };
+
+        let mut records = vec![0; tag_count as usize * TAG_RECORD_SIZE as usize];
+        self.reader.seek(SeekFrom::Start(
+            header.tags_offset() + u64::from(first_tag) * TAG_RECORD_SIZE,
+        ))?;
+        self.reader.read_exact(&mut records)?;
+
+        let mut result = Vec::with_capacity(tag_count as usize);
+        let mut path = (u32::MAX, String::new());
+        for record in records.chunks_exact(TAG_RECORD_SIZE as usize) {
+            let mut words = record
+                .chunks_exact(4)
+                .map(|chunk| u32::from_le_bytes(chunk.try_into().unwrap()) as usize);
+            let mut next = || words.next().unwrap();
+            let file = next() as u32;
+            if file != path.0 {
+                if file >= header.file_count {
+                    return Err(invalid_data("invalid file in tags index"));
+                }
+                let offset = header.files_offset() + u64::from(file) * STRING_REF_SIZE;
+                let string_ref = self.read_u32s_at(offset)?;
+                path = (file, self.read_string(string_ref)?);
+            }
+            let syntax_type = self
+                .syntax_types
+                .get(next())
+                .ok_or_else(|| invalid_data("invalid syntax type in tags index"))?;
+            result.push(IndexedTag {
+                path: path.1.clone(),
+                syntax_type: syntax_type.clone(),
+                is_definition: next() as u32 & DEFINITION_FLAG != 0,
+                range: next()..next(),
+                name_range: next()..next(),
+                span: Point::new(next(), next())..Point::new(next(), next()),
+            });
+        }
+        Ok(result)
+    }
+
+    /// Get the definitions with the given name, sorted by path and position.
+    pub fn definitions(&mut self, name: &str) -> io::Result<Vec<IndexedTag>> {
+        let mut tags = self.tags(name)?;
+        tags.retain(|tag| tag.is_definition);
+        Ok(tags)
+    }
+
+    /// Get the paths of all of the files in the index, in sorted order.
+    pub fn paths(&mut self) -> io::Result<Vec<String>> {
+        let header = self.header;
+        (0..header.file_count)
+            .map(|i| {
+                let offset = header.files_offset() + u64::from(i) * STRING_REF_SIZE;
+                let string_ref = self.read_u32s_at(offset)?;
+                self.read_string(string_ref)
+            })
+            .collect()
+    }
+
+    // Binary search the sorted names for the given name, returning the index and the
+    // number of its tags.
+    fn find_name(&mut self, name: &[u8]) -> io::Result<Option<[u32; 2]>> {
+        let header = self.header;
+        let mut low = 0;
+        let mut high = header.name_count;
+        let mut buffer = Vec::new();
+        while low < high {
+            let middle = low + (high - low) / 2;
+            let offset = header.names_offset() + u64::from(middle) * NAME_RECORD_SIZE;
+            let [string_offset, string_len, first_tag, tag_count] = self.read_u32s_at(offset)?;
+            self.read_bytes([string_offset, string_len], &mut buffer)?;
+            match buffer.as_slice().cmp(name) {
+                std::cmp::Ordering::Less => low = middle + 1,
+                std::cmp::Ordering::Greater => high = middle,
+                std::cmp::Ordering::Equal => return Ok(Some([first_tag, tag_count])),
+            }
+        }
+        Ok(None)
+    }
+
+    fn read_u32s_at<const N: usize>(&mut self, offset: u64) -> io::Result<[u32; N]> {
+        self.reader.seek(SeekFrom::Start(offset))?;
+        read_u32s(&mut self.reader)
+    }
+
+    fn read_bytes(&mut self, [offset, len]: [u32; 2], buffer: &mut Vec<u8>) -> io::Result<()> {
+        let header = self.header;
+        buffer.resize(len as usize, 0);
+        self.reader
+            .seek(SeekFrom::Start(header.strings_offset() + u64::from(offset)))?;
+        self.reader.read_exact(buffer)
+    }
+
+    fn read_string(&mut self, string_ref: [u32; 2]) -> io::Result<String> {
+        let mut buffer = Vec::new();
+        self.read_bytes(string_ref, &mut buffer)?;
+        String::from_utf8(buffer).map_err(|_| invalid_data("invalid string in tags index"))
+    }
+}
+
+impl Header {
+    const fn files_offset(&self) -> u64 {
+        HEADER_SIZE
+    }
+
+    const fn syntax_types_offset(&self) -> u64 {
+        self.files_offset() + self.file_count as u64 * STRING_REF_SIZE
+    }
+
+    const fn names_offset(&self) -> u64 {
+        self.syntax_types_offset() + self.syntax_type_count as u64 * STRING_REF_SIZE
+    }
+
+    const fn tags_offset(&self) -> u64 {
+        self.names_offset() + self.name_count as u64 * NAME_RECORD_SIZE
+    }
+
+    const fn strings_offset(&self) -> u64 {
+        self.tags_offset() + self.tag_count as u64 * TAG_RECORD_SIZE
+    }
+
+    const fn len(&self) -> u64 {
+        self.strings_offset() + self.string_len as u64
+    }
+}
+
+fn intern(strings: &mut HashMap<Box<[u8]>, u32>, string: &[u8]) -> u32 {
+    if let Some(id) = strings.get(string) {
+        return *id;
+    }
+    let id = strings.len() as u32;
+    strings.insert(string.into(), id);
+    id
+}
+
+fn to_u32(value: usize) -> io::Result<u32> {
+    u32::try_from(value).map_err(|_| {
+        io::Error::new(
+            io::ErrorKind::InvalidInput,
+            "tags index is limited to 4GB files and sections",
+        )
+    })
+}
+
+fn invalid_data(message: &str) -> io::Error {
+    io::Error::new(io::ErrorKind::InvalidData, message)
+}
+
+fn read_u32s<const N: usize>(reader: &mut impl Read) -> io::Result<[u32; N]> {
+    let mut result = [0; N];
+    for value in &mut result {
+        let mut bytes = [0; 4];
+        reader.read_exact(&mut bytes)?;
+        *value = u32::from_le_bytes(bytes);
+    }
+    Ok(result)
+}
+
+fn write_u32s(writer: &mut impl Write, values: &[u32]) -> io::Result<()> {
+    for value in values {
+        writer.write_all(&value.to_le_bytes())?;
+    }
+    Ok(())
+}
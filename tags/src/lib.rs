@@ -1,10 +1,11 @@
 #![doc = include_str!("../README.md")]
 
 pub mod c_lib;
+pub mod index;
 
 use std::{
     char,
-    collections::HashMap,
+    collections::{HashMap, HashSet},
     ffi::{CStr, CString},
     mem,
     ops::Range,
@@ -17,11 +18,13 @@ use memchr::memchr;
 use regex::Regex;
 use thiserror::Error;
 use tree_sitter::{
-    Language, LossyUtf8, Parser, Point, Query, QueryCursor, QueryError, QueryPredicateArg, Tree,
+    InputEdit, Language, LossyUtf8, Parser, Point, Query, QueryCursor, QueryError,
+    QueryPredicateArg, Tree,
 };
 
 const MAX_LINE_LEN: usize = 180;
 const CANCELLATION_CHECK_INTERVAL: usize = 100;
+const UTF16_CHECKPOINT_INTERVAL: usize = 256;
 
 /// Contains the data needed to compute tags for code written in a
 /// particular language.
@@ -41,6 +44,10 @@ pub struct TagsConfiguration {
     pattern_info: Vec<PatternInfo>,
 }
 
+// The syntax type name pointers refer to the configuration's own immutable strings.
+unsafe impl Send for TagsConfiguration {}
+unsafe impl Sync for TagsConfiguration {}
+
 #[derive(Debug)]
 pub struct NamedCapture {
     pub syntax_type_id: u32,
@@ -86,16 +93,11 @@ struct PatternInfo {
     doc_strip_regex: Option<Regex>,
 }
 
-#[derive(Debug)]
-struct LocalDef<'a> {
-    name: &'a [u8],
-}
-
 #[derive(Debug)]
 struct LocalScope<'a> {
     inherits: bool,
     range: Range<usize>,
-    local_defs: Vec<LocalDef<'a>>,
+    local_defs: HashSet<&'a [u8]>,
 }
 
 struct TagsIter<'a, I>
@@ -105,7 +107,7 @@ where
     matches: I,
     _tree: Tree,
     source: &'a [u8],
-    prev_line_info: Option<LineInfo>,
+    line_index: LineIndex,
     config: &'a TagsConfiguration,
     cancellation_flag: Option<&'a AtomicUsize>,
     iter_count: usize,
@@ -113,11 +115,29 @@ where
     scopes: Vec<LocalScope<'a>>,
 }
 
-struct LineInfo {
-    utf8_position: Point,
-    utf8_byte: usize,
-    utf16_column: usize,
+/// The properties of the lines that contain tags. Each line is examined once, when
+/// the first tag on it is found, so that the properties of later tags on the same line
+/// can be looked up without rescanning it.
+#[derive(Default)]
+struct LineIndex {
+    lines: Vec<LineIndexEntry>,
+    utf16_checkpoints: Vec<Utf16Checkpoint>,
+}
+
+/// A line that contains tags. The lines are sorted by row.
+struct LineIndexEntry {
+    row: usize,
+    start_byte: usize,
     line_range: Range<usize>,
+    /// The checkpoints in this line, or an empty range if the line is entirely ASCII,
+    /// in which case UTF-16 columns are the same as byte columns.
+    utf16_checkpoints: Range<usize>,
+}
+
+/// The UTF-16 column at a character boundary within a line.
+struct Utf16Checkpoint {
+    byte: usize,
+    utf16_column: usize,
 }
 
 impl TagsConfiguration {
@@ -279,38 +299,206 @@ impl TagsContext {
         source: &'a [u8],
         cancellation_flag: Option<&'a AtomicUsize>,
     ) -> Result<(impl Iterator<Item = Result<Tag, Error>> + 'a, bool), Error> {
+        let tree = self.parse(config, source, None, cancellation_flag)?;
+        let has_error = tree.root_node().has_error();
+        let tags = self.tags_in_range(config, tree, source, 0..usize::MAX, cancellation_flag);
+        Ok((tags, has_error))
+    }
+
+    /// Generate all of the tags for a file, returning its syntax tree along with them, so
+    /// that the tags can be updated after the file is edited using
+    /// [`TagsContext::update_tags`].
+    pub fn generate_tags_and_tree(
+        &mut self,
+        config: &TagsConfiguration,
+        source: &[u8],
+        cancellation_flag: Option<&AtomicUsize>,
+    ) -> Result<(Vec<Tag>, Tree), Error> {
+        let tree = self.parse(config, source, None, cancellation_flag)?;
+        let tags = self
+            .tags_in_range(
+                config,
+                tree.clone(),
+                source,
+                0..usize::MAX,
+                cancellation_flag,
+            )
+            .collect::<Result<_, _>>()?;
+        Ok((tags, tree))
+    }
+
+    /// Update the tags for a file after it has been edited.
+    ///
+    /// The `old_tree` and `old_tags` must have been generated for the file's previous
+    /// contents, and `edits` must describe how that text was changed into `source`. The
+    /// file is reparsed incrementally, and the tags query is only run over the ranges
+    /// that have changed, expanded to include the definitions that enclose them. The
+    /// remaining tags are reused, with their positions adjusted for the edits. Returns the
+    /// new tags and the new syntax tree.
+    ///
+    /// If the configuration has tags patterns that check whether a name is a local
+    /// variable, then an edit anywhere in a file can affect them, so every tag is
+    /// regenerated.
+    pub fn update_tags(
+        &mut self,
+        config: &TagsConfiguration,
+        source: &[u8],
+        old_tree: &Tree,
+        edits: &[InputEdit],
+        old_tags: &[Tag],
+        cancellation_flag: Option<&AtomicUsize>,
+    ) -> Result<(Vec<Tag>, Tree), Error> {
+        let mut edited_tree = old_tree.clone();
+        for edit in edits {
+            edited_tree.edit(edit);
+        }
+        let tree = self.parse(config, source, Some(&edited_tree), cancellation_flag)?;
+
+        if config.pattern_info[config.tags_pattern_index..]
+            .iter()
+            .any(|info| info.name_must_be_non_local)
+        {
+            let tags = self
+                .tags_in_range(
+                    config,
+                    tree.clone(),
+                    source,
+                    0..usize::MAX,
+                    cancellation_flag,
+                )
+                .collect::<Result<_, _>>()?;
+            return Ok((tags, tree));
+        }
+
+        // Move the old tags to their new positions, discarding the ones that overlap the
+        // edits, and keeping track of which ones are on lines that were edited.
+        let mut old_tags = old_tags
+            .iter()
+            .map(|tag| (tag.clone(), false))
+            .collect::<Vec<_>>();
+        let mut invalid_ranges = Vec::with_capacity(edits.len());
+        for edit in edits {
+            old_tags.retain_mut(|(tag, line_changed)| {
+                if tag.range.end < edit.start_byte {
+                    *line_changed |= tag.span.start.row == edit.start_position.row;
+                } else if tag.range.start > edit.old_end_byte {
+                    *line_changed |= tag.span.start.row == edit.old_end_position.row;
+                    tag.edit(edit);
+                } else {
+                    return false;
+                }
+                true
+            });
+            for range in &mut invalid_ranges {
+                *range = edit_range(range, edit);
+            }
+            // Include the bytes adjacent to the edit, so that every discarded tag
+            // intersects an invalid range.
+            invalid_ranges.push(edit.start_byte.saturating_sub(1)..edit.new_end_byte + 1);
+        }
+        invalid_ranges.extend(
+            edited_tree
+                .changed_ranges(&tree)
+                .map(|range| range.start_byte..range.end_byte),
+        );
+        merge_ranges(&mut invalid_ranges, source.len());
+
+        // A definition's docs can change when the comments before it are edited, so
+        // extend each range to the first definition that follows it.
+        if config.doc_capture_index.is_some() {
+            let mut definition_starts = old_tags
+                .iter()
+                .filter(|(tag, _)| tag.is_definition)
+                .map(|(tag, _)| tag.range.start)
+                .collect::<Vec<_>>();
+            definition_starts.sort_unstable();
+            for range in &mut invalid_ranges {
+                let i = definition_starts.partition_point(|start| *start < range.end);
+                if let Some(start) = definition_starts.get(i) {
+                    range.end = start + 1;
+                }
+            }
+            merge_ranges(&mut invalid_ranges, source.len());
+        }
+
+        // Regenerate the tags whose definitions intersect the invalid ranges, and combine
+        // them with the remaining old tags. If a name was tagged both ways, then the new
+        // tag replaces the old one.
+        let mut tags = Vec::new();
+        for range in &invalid_ranges {
+            for tag in self.tags_in_range(
+                config,
+                tree.clone(),
+                source,
+                range.clone(),
+                cancellation_flag,
+            ) {
+                let tag = tag?;
+                if intersects_any(&invalid_ranges, &tag.range) {
+                    tags.push(tag);
+                }
+            }
+        }
+        for (mut tag, line_changed) in old_tags {
+            if !intersects_any(&invalid_ranges, &tag.range) {
+                if line_changed {
+                    tag.update_line_info(source);
+                }
+                tags.push(tag);
+            }
+        }
+        tags.sort_by_key(|tag| (tag.name_range.end, tag.name_range.start));
+        tags.dedup_by_key(|tag| tag.name_range.clone());
+        Ok((tags, tree))
+    }
+
+    fn parse(
+        &mut self,
+        config: &TagsConfiguration,
+        source: &[u8],
+        old_tree: Option<&Tree>,
+        cancellation_flag: Option<&AtomicUsize>,
+    ) -> Result<Tree, Error> {
         self.parser
             .set_language(&config.language)
             .map_err(|_| Error::InvalidLanguage)?;
         self.parser.reset();
         unsafe { self.parser.set_cancellation_flag(cancellation_flag) };
-        let tree = self.parser.parse(source, None).ok_or(Error::Cancelled)?;
+        self.parser.parse(source, old_tree).ok_or(Error::Cancelled)
+    }
 
+    fn tags_in_range<'a>(
+        &'a mut self,
+        config: &'a TagsConfiguration,
+        tree: Tree,
+        source: &'a [u8],
+        byte_range: Range<usize>,
+        cancellation_flag: Option<&'a AtomicUsize>,
+    ) -> TagsIter<'a, impl Iterator<Item = tree_sitter::QueryMatch<'a, 'a>>> {
         // The `matches` iterator borrows the `Tree`, which prevents it from being
         // moved. But the tree is really just a pointer, so it's actually ok to
         // move it.
         let tree_ref = unsafe { mem::transmute::<_, &'static Tree>(&tree) };
-        let matches = self
-            .cursor
-            .matches(&config.query, tree_ref.root_node(), source);
-        Ok((
-            TagsIter {
-                _tree: tree,
-                matches,
-                source,
-                config,
-                cancellation_flag,
-                prev_line_info: None,
-                tag_queue: Vec::new(),
-                iter_count: 0,
-                scopes: vec![LocalScope {
-                    range: 0..source.len(),
-                    inherits: false,
-                    local_defs: Vec::new(),
-                }],
-            },
-            tree_ref.root_node().has_error(),
-        ))
+        let matches = self.cursor.set_byte_range(byte_range).matches(
+            &config.query,
+            tree_ref.root_node(),
+            source,
+        );
+        TagsIter {
+            _tree: tree,
+            matches,
+            source,
+            config,
+            cancellation_flag,
+            line_index: LineIndex::default(),
+            tag_queue: Vec::new(),
+            iter_count: 0,
+            scopes: vec![LocalScope {
+                range: 0..source.len(),
+                inherits: false,
+                local_defs: HashSet::new(),
+            }],
+        }
     }
 }
 
@@ -361,15 +549,13 @@ where
                             self.scopes.push(LocalScope {
                                 range,
                                 inherits: pattern_info.local_scope_inherits,
-                                local_defs: Vec::new(),
+                                local_defs: HashSet::new(),
                             });
                         } else if index == self.config.local_definition_capture_index {
                             if let Some(scope) = self.scopes.iter_mut().rev().find(|scope| {
                                 scope.range.start <= range.start && scope.range.end >= range.end
                             }) {
-                                scope.local_defs.push(LocalDef {
-                                    name: &self.source[range.clone()],
-                                });
+                                scope.local_defs.insert(&self.source[range.clone()]);
                             }
                         }
                     }
@@ -424,11 +610,7 @@ where
                                 if scope.range.start <= name_range.start
                                     && scope.range.end >= name_range.end
                                 {
-                                    if scope
-                                        .local_defs
-                                        .iter()
-                                        .any(|d| d.name == &self.source[name_range.clone()])
-                                    {
+                                    if scope.local_defs.contains(&self.source[name_range.clone()]) {
                                         is_local = true;
                                         break;
                                     }
@@ -486,45 +668,15 @@ where
                         let range = rng.start.min(name_range.start)..rng.end.max(name_range.end);
                         let span = name_node.start_position()..name_node.end_position();
 
-                        // Compute tag properties that depend on the text of the containing line. If
-                        // the previous tag occurred on the same line, then
-                        // reuse results from the previous tag.
-                        let mut prev_utf16_column = 0;
-                        let mut prev_utf8_byte = name_range.start - span.start.column;
-                        let line_info = self.prev_line_info.as_ref().and_then(|info| {
-                            if info.utf8_position.row == span.start.row {
-                                Some(info)
-                            } else {
-                                None
-                            }
-                        });
-                        let line_range = if let Some(line_info) = line_info {
-                            if line_info.utf8_position.column <= span.start.column {
-                                prev_utf8_byte = line_info.utf8_byte;
-                                prev_utf16_column = line_info.utf16_column;
-                            }
-                            line_info.line_range.clone()
-                        } else {
-                            self::line_range(
-                                self.source,
-                                name_range.start,
-                                span.start,
-                                MAX_LINE_LEN,
-                            )
-                        };
-
-                        let utf16_start_column = prev_utf16_column
-                            + utf16_len(&self.source[prev_utf8_byte..name_range.start]);
+                        // Compute tag properties that depend on the text of the containing line,
+                        // using the information that was saved for that line.
+                        let (line_range, utf16_start_column) =
+                            self.line_index
+                                .lookup(self.source, name_range.start, span.start);
                         let utf16_end_column =
                             utf16_start_column + utf16_len(&self.source[name_range.clone()]);
                         let utf16_column_range = utf16_start_column..utf16_end_column;
 
-                        self.prev_line_info = Some(LineInfo {
-                            utf8_position: span.end,
-                            utf8_byte: name_range.end,
-                            utf16_column: utf16_end_column,
-                            line_range: line_range.clone(),
-                        });
                         tag = Tag {
                             range,
                             name_range,
@@ -587,6 +739,160 @@ impl Tag {
     const fn is_ignored(&self) -> bool {
         self.range.start == usize::MAX
     }
+
+    /// Move the tag to account for an edit that ends before it.
+    fn edit(&mut self, edit: &InputEdit) {
+        self.range = edit_byte(self.range.start, edit)..edit_byte(self.range.end, edit);
+        self.name_range =
+            edit_byte(self.name_range.start, edit)..edit_byte(self.name_range.end, edit);
+        self.line_range =
+            edit_byte(self.line_range.start, edit)..edit_byte(self.line_range.end, edit);
+        self.span = edit_point(self.span.start, edit)..edit_point(self.span.end, edit);
+    }
+
+    /// Recompute the properties that depend on the text of the tag's line.
+    fn update_line_info(&mut self, source: &[u8]) {
+        let line_start_byte = self.name_range.start - self.span.start.column;
+        self.line_range = line_range(source, self.name_range.start, self.span.start, MAX_LINE_LEN);
+        let utf16_start_column = utf16_len(&source[line_start_byte..self.name_range.start]);
+        let utf16_end_column = utf16_start_column + utf16_len(&source[self.name_range.clone()]);
+        self.utf16_column_range = utf16_start_column..utf16_end_column;
+    }
+}
+
+/// Move a byte offset that follows an edit. The start of the edited line may precede
+/// the edit, so this saturates.
+const fn edit_byte(byte: usize, edit: &InputEdit) -> usize {
+    (byte + edit.new_end_byte).saturating_sub(edit.old_end_byte)
+}
+
+const fn edit_point(point: Point, edit: &InputEdit) -> Point {
+    if point.row == edit.old_end_position.row {
+        Point::new(
+            edit.new_end_position.row,
+            (point.column + edit.new_end_position.column)
+                .saturating_sub(edit.old_end_position.column),
+        )
+    } else {
+        Point::new(
+            point.row + edit.new_end_position.row - edit.old_end_position.row,
+            point.column,
+        )
+    }
+}
+
+/// Adjust a range for an edit, expanding it to include the edit if they overlap.
+const fn edit_range(range: &Range<usize>, edit: &InputEdit) -> Range<usize> {
+    let start = if range.start > edit.old_end_byte {
+        edit_byte(range.start, edit)
+    } else if range.start > edit.start_byte {
+        edit.start_byte
+    } else {
+        range.start
+    };
+    let end = if range.end > edit.old_end_byte {
+        edit_byte(range.end, edit)
+    } else if range.end >= edit.start_byte {
+        edit.new_end_byte
+    } else {
+        range.end
+    };
+    start..end
+}
+
+/// Sort a list of ranges, clamp them to the given length, and merge the ones that overlap.
+fn merge_ranges(ranges: &mut Vec<Range<usize>>, len: usize) {
+    ranges.sort_unstable_by_key(|range| range.start);
+    let mut merged: Vec<Range<usize>> = Vec::with_capacity(ranges.len());
+    for range in ranges.drain(..) {
+        let range = range.start.min(len)..range.end.min(len);
+        match merged.last_mut() {
+            Some(last) if range.start <= last.end => last.end = last.end.max(range.end),
+            _ => merged.push(range),
+        }
+    }
+    *ranges = merged;
+}
+
+/// Check if a range intersects any of a sorted list of disjoint ranges.
+fn intersects_any(ranges: &[Range<usize>], range: &Range<usize>) -> bool {
+    let i = ranges.partition_point(|r| r.end <= range.start);
+    ranges.get(i).is_some_and(|r| r.start < range.end)
+}
+
+impl LineIndex {
+    /// Get the trimmed range of the line containing the given position, and the
+    /// position's UTF-16 column. The line is examined if this is the first time that it
+    /// has been seen.
+    fn lookup(&mut self, source: &[u8], byte: usize, position: Point) -> (Range<usize>, usize) {
+        let index = match self
+            .lines
+            .binary_search_by_key(&position.row, |line| line.row)
+        {
+            Ok(index) => index,
+            Err(index) => {
+                let start_byte = byte - position.column;
+                let end_byte = memchr(b'\n', &source[start_byte..])
+                    .map_or(source.len(), |len| start_byte + len);
+                let checkpoints_start = self.utf16_checkpoints.len();
+                if !source[start_byte..end_byte].is_ascii() {
+                    self.add_utf16_checkpoints(source, start_byte, end_byte);
+                }
+                let entry = LineIndexEntry {
+                    row: position.row,
+                    start_byte,
+                    line_range: line_range(source, byte, position, MAX_LINE_LEN),
+                    utf16_checkpoints: checkpoints_start..self.utf16_checkpoints.len(),
+                };
+                self.lines.insert(index, entry);
+                index
+            }
+        };
+
+        let line = &self.lines[index];
+        let checkpoints = &self.utf16_checkpoints[line.utf16_checkpoints.clone()];
+        let i = checkpoints.partition_point(|checkpoint| checkpoint.byte <= byte);
+        let utf16_column = match i.checked_sub(1).map(|i| &checkpoints[i]) {
+            Some(checkpoint) => checkpoint.utf16_column + utf16_len(&source[checkpoint.byte..byte]),
+            None => byte - line.start_byte,
+        };
+        (line.line_range.clone(), utf16_column)
+    }
+
+    /// Record the UTF-16 column at regular intervals along a line, so that the column of
+    /// any byte in the line can be found by scanning a short distance from a checkpoint.
+    fn add_utf16_checkpoints(&mut self, source: &[u8], start_byte: usize, end_byte: usize) {
+        let mut byte = start_byte;
+        let mut utf16_column = 0;
+        let mut next_checkpoint = start_byte;
+        while byte < end_byte {
+            // Invalid UTF-8 sequences count as single replacement characters.
+            let (valid, invalid_len) = match str::from_utf8(&source[byte..end_byte]) {
+                Ok(valid) => (valid, 0),
+                Err(error) => {
+                    let Some(error_len) = error.error_len() else {
+                        break;
+                    };
+                    let valid = &source[byte..byte + error.valid_up_to()];
+                    (unsafe { str::from_utf8_unchecked(valid) }, error_len)
+                }
+            };
+            for (offset, c) in valid.char_indices() {
+                if byte + offset >= next_checkpoint {
+                    self.utf16_checkpoints.push(Utf16Checkpoint {
+                        byte: byte + offset,
+                        utf16_column,
+                    });
+                    next_checkpoint = byte + offset + UTF16_CHECKPOINT_INTERVAL;
+                }
+                utf16_column += c.len_utf16();
+            }
+            byte += valid.len() + invalid_len;
+            if invalid_len > 0 {
+                utf16_column += 1;
+            }
+        }
+    }
 }
 
 fn line_range(
@@ -655,4 +961,36 @@ mod tests {
         assert_eq!(r, 12..15);
         assert_eq!(str::from_utf8(&text[r]).unwrap_or(""), "bar");
     }
+
+    #[test]
+    fn test_line_index() {
+        let line = "  // ❤️ α 𝄞 ".repeat(100);
+        let mut text = format!("abc\n{line}\n  x\n").into_bytes();
+        text.extend_from_slice(b"\xff\xfe \xe2\x9d x \xf0\x9d\x84\x9e y\n");
+
+        let mut index = LineIndex::default();
+        let mut line_start = 0;
+        for (row, line) in text.split(|b| *b == b'\n').enumerate() {
+            // Look up the positions in reverse order, to avoid relying on the order in
+            // which the lines' contents are examined.
+            for column in (0..=line.len()).rev() {
+                let byte = line_start + column;
+                let position = Point::new(row, column);
+                // Tags always start at character boundaries.
+                if matches!(str::from_utf8(&line[..column]), Err(e) if e.error_len().is_none()) {
+                    continue;
+                }
+                assert_eq!(
+                    index.lookup(&text, byte, position),
+                    (
+                        line_range(&text, byte, position, MAX_LINE_LEN),
+                        utf16_len(&line[..column])
+                    ),
+                    "row {row}, column {column}",
+                );
+            }
+            line_start += line.len() + 1;
+        }
+        assert_eq!(index.lines.len(), 5);
+    }
 }
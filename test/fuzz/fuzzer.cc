@@ -1,12 +1,105 @@
+#include <algorithm>
 #include <cassert>
+#include <cstdio>
+#include <cstdlib>
 #include <fstream>
+#include <string>
 #include "tree_sitter/api.h"
 
 extern "C" const TSLanguage *TS_LANG();
 
 static TSQuery *lang_query;
 
+// When this is set, the fuzzer searches for inputs that are expensive to parse or to
+// query, and saves the worst ones that it finds in this directory.
+static const char *cost_output_dir;
+
+// libFuzzer treats these counters as additional coverage, so an input whose cost falls
+// into a bucket that no other input has reached is kept in the corpus and mutated
+// further. This steers the fuzzer towards ever more expensive inputs. The counters are
+// only read by libFuzzer, so they need external linkage and the `used` attribute to
+// keep the compiler from discarding them and the stores to them.
+__attribute__((used, section("__libfuzzer_extra_counters")))
+uint8_t parse_cost_counters[128];
+__attribute__((used, section("__libfuzzer_extra_counters")))
+uint8_t query_cost_counters[128];
+
+static uint64_t max_parse_cost;
+static uint64_t max_query_cost;
+
+// Split the costs into four buckets per power of two.
+static unsigned cost_bucket(uint64_t cost) {
+  if (cost < 4) return cost;
+  unsigned log2 = 63 - __builtin_clzll(cost);
+  unsigned result = log2 * 4 + ((cost >> (log2 - 2)) & 3);
+  return result < 128 ? result : 127;
+}
+
+static void count_parse_operation(void *payload, TSLogType type, const char *message) {
+  if (type == TSLogTypeParse) {
+    ++*static_cast<uint64_t *>(payload);
+  }
+}
+
+// Each attempt uses a new cursor, because a cursor keeps the capture lists that it
+// allocated under a higher limit.
+static bool query_exceeds_match_limit(TSNode root_node, uint32_t limit) {
+  TSQueryCursor *cursor = ts_query_cursor_new();
+  ts_query_cursor_set_match_limit(cursor, limit);
+  ts_query_cursor_exec(cursor, lang_query, root_node);
+  TSQueryMatch match;
+  while (ts_query_cursor_next_match(cursor, &match)) {
+  }
+  bool result = ts_query_cursor_did_exceed_match_limit(cursor);
+  ts_query_cursor_delete(cursor);
+  return result;
+}
+
+// The cursor doesn't expose its states, so find the largest number of matches that
+// were in progress at once by finding the smallest match limit that isn't exceeded.
+// The limit is doubled until it isn't exceeded, and then binary searched.
+static uint64_t count_peak_query_states(TSNode root_node) {
+  uint32_t high = 1;
+  while (high < UINT16_MAX && query_exceeds_match_limit(root_node, high)) {
+    high = std::min<uint32_t>(high * 2, UINT16_MAX);
+  }
+  uint32_t low = high / 2;
+  while (high - low > 1) {
+    uint32_t mid = low + (high - low) / 2;
+    if (query_exceeds_match_limit(root_node, mid)) {
+      low = mid;
+    } else {
+      high = mid;
+    }
+  }
+  return high;
+}
+
+// Save the input along with a cost ceiling that is 50% above the cost that was measured,
+// in the format expected by the `test_pathological_inputs` test.
+static void save_costly_input(
+  const char *metric,
+  uint64_t cost,
+  uint64_t parse_operations,
+  uint64_t query_states,
+  const uint8_t *data,
+  size_t size
+) {
+  auto path = std::string(cost_output_dir) + "/" + metric + "-" + std::to_string(cost);
+  auto input_file = std::ofstream(path, std::ios::binary);
+  input_file.write(reinterpret_cast<const char *>(data), size);
+
+  auto ceiling_file = std::ofstream(path + ".json");
+  ceiling_file << "{\n  \"max_parse_operations\": " << parse_operations * 3 / 2;
+  if (lang_query != nullptr) {
+    ceiling_file << ",\n  \"max_query_states\": " << query_states * 3 / 2;
+  }
+  ceiling_file << "\n}\n";
+}
+
 extern "C" int LLVMFuzzerInitialize(int *argc, char ***argv) {
+  cost_output_dir = getenv("TREE_SITTER_FUZZ_COST_DIR");
+
   if(TS_LANG_QUERY_FILENAME[0]) {
     // The query filename is relative to the fuzzing binary. Convert it
     // to an absolute path first
@@ -44,6 +137,11 @@ extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
   bool language_ok = ts_parser_set_language(parser, TS_LANG());
   assert(language_ok);
 
+  uint64_t parse_operations = 0;
+  if (cost_output_dir) {
+    ts_parser_set_logger(parser, {&parse_operations, count_parse_operation});
+  }
+
   TSTree *tree = ts_parser_parse_string(parser, NULL, str, size);
   TSNode root_node = ts_tree_root_node(tree);
 
@@ -72,6 +170,28 @@ extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
     }
   }
 
+  if (cost_output_dir) {
+    // Measure the parsing cost per byte, in sixteenths of an operation, so that
+    // the fuzzer can't increase it just by making the input longer.
+    uint64_t parse_cost = parse_operations * 16 / (size + 1);
+    parse_cost_counters[cost_bucket(parse_cost)] = 1;
+
+    uint64_t query_states = 0;
+    if (lang_query != nullptr) {
+      query_states = count_peak_query_states(root_node);
+      query_cost_counters[cost_bucket(query_states)] = 1;
+    }
+
+    if (parse_cost > max_parse_cost) {
+      max_parse_cost = parse_cost;
+      save_costly_input("parse", parse_cost, parse_operations, query_states, data, size);
+    }
+    if (query_states > max_query_cost) {
+      max_query_cost = query_states;
+      save_costly_input("query", query_states, parse_operations, query_states, data, size);
+    }
+  }
+
   ts_tree_delete(tree);
   ts_parser_delete(parser);
 
@@ -1,42 +1,269 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <fstream>
 #include <string>
-#include <cstdlib>
-#include <tree_sitter/api.h>
+#include <vector>
+#include "tree_sitter/api.h"
+
+extern "C" const TSLanguage *TS_LANG();
+
+// Every allocation made through the library's allocator is prefixed with a header
+// that records its size, so that frees can be subtracted from the running total.
+static const size_t HEADER_SIZE = 16;
+
+static size_t allocation_count;
+static size_t allocated_bytes;
+static size_t peak_allocated_bytes;
+
+static void *record_allocation(void *block, size_t size) {
+  if (!block) {
+    fprintf(stderr, "Failed to allocate %zu bytes\n", size);
+    abort();
+  }
+  *static_cast<size_t *>(block) = size;
+  allocation_count++;
+  allocated_bytes += size;
+  peak_allocated_bytes = std::max(peak_allocated_bytes, allocated_bytes);
+  return static_cast<char *>(block) + HEADER_SIZE;
+}
+
+static void counting_free(void *pointer) {
+  if (!pointer) return;
+  void *block = static_cast<char *>(pointer) - HEADER_SIZE;
+  allocated_bytes -= *static_cast<size_t *>(block);
+  free(block);
+}
+
+static void *counting_malloc(size_t size) {
+  return record_allocation(malloc(HEADER_SIZE + size), size);
+}
 
-extern "C" {
-#include "javascript/src/parser.c"
-#include "javascript/src/scanner.c"
+static void *counting_calloc(size_t count, size_t size) {
+  size_t total = count * size;
+  if (size != 0 && total / size != count) return nullptr;
+  return record_allocation(calloc(1, HEADER_SIZE + total), total);
+}
+
+static void *counting_realloc(void *pointer, size_t size) {
+  if (!pointer) return counting_malloc(size);
+  void *block = static_cast<char *>(pointer) - HEADER_SIZE;
+  allocated_bytes -= *static_cast<size_t *>(block);
+  return record_allocation(realloc(block, HEADER_SIZE + size), size);
+}
+
+static TSPoint point_at(const std::string &source, size_t offset) {
+  TSPoint point = {0, 0};
+  for (size_t i = 0; i < offset; i++) {
+    if (source[i] == '\n') {
+      point.row++;
+      point.column = 0;
+    } else {
+      point.column++;
+    }
+  }
+  return point;
+}
+
+struct Edit {
+  size_t position;
+  size_t deleted_length;
+  std::string inserted_text;
+};
+
+// Read the edits that `script/benchmark -w` replays for an example, from the
+// plain trace that it writes next to the JSON one. For each edit, the trace has
+// a line with its position, deleted length and inserted length in bytes,
+// followed by the inserted bytes and a newline.
+static std::vector<Edit> read_edit_trace(const std::string &trace_path) {
+  std::ifstream trace_file(trace_path, std::ios::binary);
+  if (!trace_file.good()) {
+    fprintf(stderr, "Invalid trace path %s\n", trace_path.c_str());
+    exit(1);
+  }
+
+  std::vector<Edit> edits;
+  std::string line;
+  while (std::getline(trace_file, line)) {
+    Edit edit;
+    size_t inserted_length;
+    char extra;
+    int field_count = sscanf(
+      line.c_str(),
+      "%zu %zu %zu%c",
+      &edit.position,
+      &edit.deleted_length,
+      &inserted_length,
+      &extra
+    );
+    if (field_count == 3) {
+      edit.inserted_text.resize(inserted_length);
+      trace_file.read(&edit.inserted_text[0], inserted_length);
+    }
+    if (field_count != 3 || !trace_file || trace_file.get() != '\n') {
+      fprintf(stderr, "Invalid edit %zu in %s\n", edits.size(), trace_path.c_str());
+      exit(1);
+    }
+    edits.push_back(std::move(edit));
+  }
+  return edits;
 }
 
-#define LANGUAGE tree_sitter_javascript
-#define SOURCE_PATH "javascript/examples/jquery.js"
+struct Measurement {
+  size_t source_bytes;
+  size_t parse_allocations;
+  size_t peak_bytes;
+  size_t tree_bytes;
+  size_t edit_count;
+  size_t history_bytes;
+};
+
+static Measurement measure(const std::string &source_code, const std::vector<Edit> &edits) {
+  Measurement result = {};
+  result.source_bytes = source_code.size();
+  result.edit_count = edits.size();
+
+  size_t baseline = allocated_bytes;
+  size_t initial_allocation_count = allocation_count;
+  peak_allocated_bytes = allocated_bytes;
 
-int main() {
   TSParser *parser = ts_parser_new();
-  if (!ts_parser_set_language(parser, LANGUAGE())) {
+  if (!ts_parser_set_language(parser, TS_LANG())) {
     fprintf(stderr, "Invalid language\n");
     exit(1);
   }
 
-  const char *source_path = GRAMMARS_DIR SOURCE_PATH;
+  TSTree *tree = ts_parser_parse_string(parser, NULL, source_code.data(), source_code.size());
+  result.parse_allocations = allocation_count - initial_allocation_count;
+  result.peak_bytes = peak_allocated_bytes - baseline;
+
+  // Keep every version of the tree alive, as an editor's undo history or a tree
+  // cache would, so that the growth reflects the subtrees that aren't shared.
+  std::vector<TSTree *> history;
+  std::string source = source_code;
+  TSTree *old_tree = tree;
+  for (const Edit &edit : edits) {
+    if (edit.position + edit.deleted_length > source.size()) {
+      fprintf(stderr, "Edit at %zu is out of bounds\n", edit.position);
+      exit(1);
+    }
+    size_t new_end = edit.position + edit.inserted_text.size();
+    TSInputEdit input_edit = {
+      static_cast<uint32_t>(edit.position),
+      static_cast<uint32_t>(edit.position + edit.deleted_length),
+      static_cast<uint32_t>(new_end),
+      point_at(source, edit.position),
+      point_at(source, edit.position + edit.deleted_length),
+      {0, 0},
+    };
+    source.replace(edit.position, edit.deleted_length, edit.inserted_text);
+    input_edit.new_end_point = point_at(source, new_end);
+
+    TSTree *edited_tree = ts_tree_copy(old_tree);
+    ts_tree_edit(edited_tree, &input_edit);
+    TSTree *new_tree = ts_parser_parse_string(parser, edited_tree, source.data(), source.size());
+    ts_tree_delete(edited_tree);
+    history.push_back(new_tree);
+    old_tree = new_tree;
+  }
+
+  // Free the parser's buffers first, so that only the trees are left.
+  ts_parser_delete(parser);
+  size_t all_trees_bytes = allocated_bytes;
+  for (TSTree *edited_tree : history) ts_tree_delete(edited_tree);
+  size_t original_tree_bytes = allocated_bytes;
+  ts_tree_delete(tree);
+
+  result.tree_bytes = original_tree_bytes - allocated_bytes;
+  result.history_bytes = all_trees_bytes - original_tree_bytes;
+
+  if (allocated_bytes != baseline) {
+    fprintf(stderr, "Leaked %zu bytes\n", allocated_bytes - baseline);
+    exit(1);
+  }
+
+  return result;
+}
+
+static std::string file_name(const std::string &path) {
+  size_t separator = path.find_last_of('/');
+  return separator == std::string::npos ? path : path.substr(separator + 1);
+}
 
-  printf("Parsing %s\n", source_path);
+static std::string format_bytes(double bytes) {
+  static const char *UNITS[] = {"B", "KB", "MB", "GB"};
+  size_t unit = 0;
+  while (bytes >= 1024 && unit < 3) {
+    bytes /= 1024;
+    unit++;
+  }
+  char buffer[32];
+  snprintf(buffer, sizeof(buffer), "%.1f %s", bytes, UNITS[unit]);
+  return buffer;
+}
 
-  std::ifstream source_file(source_path);
-  if (!source_file.good()) {
-    fprintf(stderr, "Invalid source path %s\n", source_path);
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    fprintf(stderr, "Usage: %s example-file...\n", argv[0]);
     exit(1);
   }
 
-  std::string source_code(
-    (std::istreambuf_iterator<char>(source_file)),
-    std::istreambuf_iterator<char>()
-  );
+  ts_set_allocator(counting_malloc, counting_calloc, counting_realloc, counting_free);
+
+  const char *edit_trace_dir = getenv("TREE_SITTER_HEAP_EDIT_TRACE_DIR");
+
+  size_t max_path_length = 0;
+  for (int i = 1; i < argc; i++) {
+    max_path_length = std::max(max_path_length, strlen(argv[i]));
+  }
+
+  for (int i = 1; i < argc; i++) {
+    const char *source_path = argv[i];
+    std::ifstream source_file(source_path, std::ios::binary);
+    if (!source_file.good()) {
+      fprintf(stderr, "Invalid source path %s\n", source_path);
+      exit(1);
+    }
+
+    std::string source_code(
+      (std::istreambuf_iterator<char>(source_file)),
+      std::istreambuf_iterator<char>()
+    );
+    if (source_code.empty()) continue;
+
+    // Replay the same edits as the parsing benchmark, when it has written them.
+    std::string trace_path;
+    if (edit_trace_dir) {
+      trace_path = std::string(edit_trace_dir) + "/" + file_name(source_path) + ".edits";
+    }
+    std::vector<Edit> edits;
+    if (!trace_path.empty() && std::ifstream(trace_path).good()) {
+      edits = read_edit_trace(trace_path);
+    }
+
+    Measurement m = measure(source_code, edits);
+    double bytes = m.source_bytes;
+    printf(
+      "  %-*s  %10s  allocations: %8zu  peak: %7.2f B/B  tree: %7.2f B/B",
+      static_cast<int>(max_path_length),
+      source_path,
+      format_bytes(bytes).c_str(),
+      m.parse_allocations,
+      m.peak_bytes / bytes,
+      m.tree_bytes / bytes
+    );
+    if (m.edit_count > 0) {
+      printf(
+        "  %zu edits: %10s/edit, %5.2f%% of the tree",
+        m.edit_count,
+        format_bytes(static_cast<double>(m.history_bytes) / m.edit_count).c_str(),
+        100.0 * m.history_bytes / m.edit_count / m.tree_bytes
+      );
+    }
+    printf("\n");
+  }
 
-  TSTree *tree = ts_parser_parse_string(
-    parser,
-    NULL,
-    source_code.c_str(),
-    source_code.size()
-  );
+  return 0;
 }